@@ -10,11 +10,15 @@
 #endif
 
 #include <stdlib.h>
+#include <algorithm>
 #include <fstream>
 #include <numeric>
 #include "../../application/command_line_options.h"
 #include "../../csv/format.h"
 #include "../../csv/options.h"
+#include "../../csv/impl/block_reader.h"
+#include "../../csv/impl/gather.h"
+#include "../../csv/impl/mapped_file.h"
 #include "../../string/string.h"
 
 using namespace comma;
@@ -62,6 +66,7 @@ namespace {
         std::cerr << "    --count=[<N>]; output no more than N records" << std::endl;
         std::cerr << "    --read-all,--force-read; do not use the seek form of the algorithm, read entire records at once; " << ( verbose ? "see below" : "run --help --verbose for details" ) << std::endl;
         std::cerr << "    --flush; flush after every output record; less efficient, use it if you need to process records in real time to avoid buffering" << std::endl;
+        std::cerr << "    --mmap; read records from memory-mapped files (and stdin, if it is a regular file) without copying them; overrides seeking" << std::endl;
         std::cerr << "    --verbose,-v: chat more" << std::endl;
         std::cerr << std::endl;
         if ( !verbose ) {
@@ -204,53 +209,77 @@ namespace {
     class seeker
     {
         public:
-            seeker( const std::vector< field > & fields, const comma::csv::options & csv, unsigned int skip, long int count_max, bool flush, bool force_read )
+            seeker( const std::vector< field > & fields, const comma::csv::options & csv, unsigned int skip, long int count_max, bool flush, bool force_read, bool mmap )
                 : fields_( fields )
                 , orecord_size_( std::accumulate( fields.begin(), fields.end(), (size_t)0, seeker::add_size ) )
                 , obuf_( orecord_size_ )
-                , ibuf_( 0 )
                 , irecord_size_( csv.format().size() )
                 , skip_( skip )
                 , count_( 0 )
                 , count_max_( count_max )
                 , flush_( flush )
                 , force_read_( force_read )
-                {}
+                , mmap_( mmap )
+                {
+                    for( const auto& f: fields ) { gather_.add( f.input_offset, f.size ); }
+                }
 
             int process( const std::vector< std::string > & files );
 
         private:
             int read_fields( std::ifstream & ifs, const std::string & fname );
             int read_all( std::istream & is );
+            int read_mapped( const std::string & fname );
+            bool cut( const char* records, std::size_t size );
 
             const std::vector< field > & fields_;
             size_t orecord_size_;
             std::vector< char > obuf_;
-            std::vector< char > ibuf_;
+            comma::csv::impl::gather gather_;
+            std::vector< char > gathered_;
             size_t irecord_size_;
             unsigned int skip_;
             long int count_;
             long int count_max_;
             bool flush_;
             bool force_read_;
+            bool mmap_;
 
             static size_t add_size( size_t i, const field & f ){ return i + f.size; }
     };
 
-    int seeker::read_all( std::istream & is )
+    bool seeker::cut( const char* records, std::size_t size ) // return false, if done
     {
-        if ( count_max_ >= 0 && count_ >= count_max_ ) { return 0; }
-        ibuf_.resize( irecord_size_ );
-        while( is.good() && !is.eof() )
+        std::size_t begin = std::min( std::size_t( skip_ ), size );
+        skip_ -= begin;
+        std::size_t end = count_max_ < 0 ? size : std::min( size, begin + std::size_t( count_max_ - count_ ) );
+        if( end > begin )
         {
-            is.read( &ibuf_[0], irecord_size_ );
-            if( is.gcount() == 0 ) { continue; }
-            if( is.gcount() < int( irecord_size_ ) ) { std::cerr << "csv-bin-cut: expected " << irecord_size_ << " bytes, got only " << is.gcount() << std::endl; exit( 1 ); }
-            if ( skip_ ) { --skip_; continue; }
-            for( unsigned int i = 0; i < fields_.size(); ++i ) { std::cout.write( &ibuf_[0] + fields_[i].input_offset, fields_[i].size ); }
-            if( flush_ ) { std::cout.flush(); }
-            if ( count_max_ >= 0 && ++count_ >= count_max_ ) { return 0; }
+            gathered_.resize( ( end - begin ) * orecord_size_ );
+            gather_.apply( records + begin * irecord_size_, irecord_size_, end - begin, &gathered_[0] );
+            if( flush_ ) { for( std::size_t i = 0; i < end - begin; ++i ) { std::cout.write( &gathered_[0] + i * orecord_size_, orecord_size_ ); std::cout.flush(); } }
+            else { std::cout.write( &gathered_[0], gathered_.size() ); }
+            count_ += end - begin;
         }
+        return !( count_max_ >= 0 && count_ >= count_max_ );
+    }
+
+    int seeker::read_mapped( const std::string & fname )
+    {
+        comma::csv::impl::mapped_file file( fname );
+        if ( file.size() % irecord_size_ != 0 ) { std::cerr << "csv-bin-cut: size of file '" << fname << "' is not a multiple of the record size" << std::endl; exit( 1 ); }
+        file.sequential();
+        std::size_t size = file.size() / irecord_size_;
+        std::size_t batch = std::max( std::size_t( 1 ), std::size_t( 65536 ) / irecord_size_ ); // as block_reader, to keep output buffer small
+        for( std::size_t i = 0; i < size && cut( file.data() + i * irecord_size_, std::min( batch, size - i ) ); i += batch );
+        return 0;
+    }
+
+    int seeker::read_all( std::istream & is )
+    {
+        if ( count_max_ >= 0 && count_ >= count_max_ ) { return 0; }
+        comma::csv::impl::block_reader reader( is, irecord_size_, 0, mmap_ );
+        while( reader.read() > 0 ) { if( !cut( reader.record( 0 ), reader.size() ) ) { return 0; } }
         return 0;
     }
 
@@ -317,6 +346,11 @@ namespace {
             }
             else
             {
+                if( mmap_ )
+                {
+                    read_mapped( *ifile );
+                    continue;
+                }
                 std::ifstream ifs( &( *ifile )[0], std::ifstream::binary );
                 if ( !ifs.is_open() ) { std::cerr << "csv-bin-cut: cannot open '" << *ifile << "' for reading" << std::endl; exit( 1 ); }
                 int rv = ( force_read_ ? read_all( ifs ) : read_fields( ifs, *ifile ) );
@@ -339,7 +373,7 @@ int main( int ac, char** av )
         command_line_options options( ac, av, usage );
         comma::csv::options csv( options );
         csv.full_xpath = false;
-        std::vector< std::string > files = options.unnamed( "--help,-h,--verbose,-v,--flush,--read-all,--force-read", "--fields,-f,--output-fields,--output,-o,--binary,-b,--skip,--count" );
+        std::vector< std::string > files = options.unnamed( "--help,-h,--verbose,-v,--flush,--mmap,--read-all,--force-read", "--fields,-f,--output-fields,--output,-o,--binary,-b,--skip,--count" );
         if( !csv.binary() )
         {
             if( files.size() == 1 && files[0] != "-" ) // deprecated, left for backward compatibility
@@ -354,7 +388,7 @@ int main( int ac, char** av )
         long int count_max = options.value< long int >( "--count", -1 );
         bool flush = options.exists( "--flush" );
         bool force_read = options.exists( "--read-all,--force-read" );
-        seeker seek( fields, csv, skip, count_max, flush, force_read );
+        seeker seek( fields, csv, skip, count_max, flush, force_read, csv.mmap );
         return seek.process( files );
     }
     catch( std::exception& ex ) { std::cerr << "csv-bin-cut: " << ex.what() << std::endl; }
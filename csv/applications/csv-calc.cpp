@@ -9,11 +9,18 @@
 #include <io.h>
 #endif
 
+#include <algorithm>
+#include <condition_variable>
 #include <deque>
+#include <exception>
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <unordered_set>
 #include <boost/bind/bind.hpp>
 #include <boost/function.hpp>
@@ -25,7 +32,10 @@
 #include "../../base/exception.h"
 #include "../../base/none.h"
 #include "../../csv/format.h"
+#include "../../csv/impl/ascii_cast.h"
+#include "../../csv/impl/block_reader.h"
 #include "../../csv/options.h"
+#include "../../math/quantile_sketch.h"
 #include "../../string/string.h"
 
 static void bash_completion( unsigned const ac, char const * const * av )
@@ -39,6 +49,10 @@ static void bash_completion( unsigned const ac, char const * const * av )
         " --output-format"
         " --format"
         " --binary -b"
+        " --threads"
+        " --tumbling"
+        " --window"
+        " --window-size"
         " --verbose -v";
     std::cout << arguments << std::endl;
     exit( 0 );
@@ -67,6 +81,7 @@ static void usage( bool verbose )
     std::cerr << "        <n> is the desired percentile (e.g. 0.9)" << std::endl;
     std::cerr << "        <method> is one of 'nearest' or 'interpolate' (default: nearest)" << std::endl;
     std::cerr << "        see --help --verbose for more details" << std::endl;
+    std::cerr << "        percentile of time values is supported; interpolation is done in microseconds" << std::endl;
     std::cerr << "    radius: diameter / 2" << std::endl;
     std::cerr << "    size: number of values" << std::endl;
     std::cerr << "    skew[=sample]: skew" << std::endl;
@@ -80,6 +95,9 @@ static void usage( bool verbose )
     std::cerr << "<options>" << std::endl;
     std::cerr << "    --append: append statistics to each input line" << std::endl;
     std::cerr << "    --append-once,--append-to-first: append statistics to first input line for each block and/or each id" << std::endl;
+    std::cerr << "    --approximate: approximate percentiles in bounded memory per id and block, using a mergeable quantile sketch;" << std::endl;
+    std::cerr << "                   percentiles are exact while the number of values is below sketch size, and always one of input values" << std::endl;
+    std::cerr << "        --sketch-size=<size>: default: 200; rank error is roughly 1.7/<size> of the number of values" << std::endl;
     std::cerr << "    --delimiter,-d <delimiter> : default ','" << std::endl;
     std::cerr << "    --fields,-f: field names for which the extents should be computed, default: all fields" << std::endl;
     std::cerr << "                 if 'block' field present, calculate block-wise" << std::endl;
@@ -90,7 +108,17 @@ static void usage( bool verbose )
     std::cerr << "    --output-format: print output format for this operation and then exit (note: requires input-format)" << std::endl;
     std::cerr << "    --format: in ascii mode: format hint string containing the types of the csv data, default: double or time" << std::endl;
     std::cerr << "    --binary,-b: in binary mode: format string of the csv data types" << std::endl;
+    std::cerr << "    --threads=<n>: default: 1; aggregate in <n> threads, ids partitioned between threads; 0: number of cores" << std::endl;
+    std::cerr << "                   output is the same as in a single thread; useful when there are many ids" << std::endl;
     std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
+    std::cerr << "    --window=<seconds>: sliding window: for each record, append statistics over the records of the same id" << std::endl;
+    std::cerr << "                        with time field t in ( t - <seconds>, t ]; input is expected to be sorted by t for each id" << std::endl;
+    std::cerr << "                        supported operations: min, max, centre, diameter, radius, sum, mean, var, stddev, size" << std::endl;
+    std::cerr << "                        statistics are output as doubles (size as ui); windows are cleared on each new block" << std::endl;
+    std::cerr << "    --window-size=<n>: sliding window of the last <n> records of the same id; can be used with --window" << std::endl;
+    std::cerr << "                       field t is not required, if --window-size is used without --window" << std::endl;
+    std::cerr << "    --tumbling: with --window: non-overlapping windows of <seconds> aligned to 19700101T000000" << std::endl;
+    std::cerr << "                statistics are calculated and output for each window as for blocks; all operations supported" << std::endl;
     std::cerr << comma::csv::format::usage() << std::endl;
     if( verbose )
     {
@@ -119,6 +147,9 @@ static void usage( bool verbose )
     std::cerr << "    seq 1 1000 | csv-calc percentile=0.1,percentile=0.9" << std::endl;
     std::cerr << "    seq 1 1000 | csv-calc percentile=0.9:interpolate --verbose" << std::endl;
     std::cerr << std::endl;
+    std::cerr << "    mean and max of the last 10 seconds for each id" << std::endl;
+    std::cerr << "        cat data.csv | csv-calc mean,max --fields=t,a,id --window=10" << std::endl;
+    std::cerr << std::endl;
     std::cerr << "    {(seq 1 500 | csv-paste \"-\" \"value=0\") ; (seq 1 100 | csv-paste \"-\" \"value=1\") ; (seq 501 1000 | csv-paste \"-\" \"value=0\")} | csv-calc --fields=a,block percentile=0.9" << std::endl;
     std::cerr << std::endl;
     std::cerr << "    {(seq 1 500 | csv-paste \"-\" \"value=0\") ; (seq 1 100 | csv-paste \"-\" \"value=1\") ; (seq 501 1000 | csv-paste \"-\" \"value=0\")} | csv-calc --fields=a,id percentile=0.9" << std::endl;
@@ -130,22 +161,22 @@ static void usage( bool verbose )
 class Values
 {
     public:
-        Values( const comma::csv::options& csv, const comma::csv::format& input_format )
+        Values( const comma::csv::options& csv, const comma::csv::format& input_format, bool has_time = false )
             : csv_( csv )
             , input_format_( input_format )
             , block_( 0 )
             , id_( 0 )
         {
-            init_indices_();
+            init_indices_( has_time );
             init_format_();
         }
 
-        Values( const comma::csv::options& csv, const std::string& hint )
+        Values( const comma::csv::options& csv, const std::string& hint, bool has_time = false )
             : csv_( csv )
             , block_( 0 )
             , id_( 0 )
         {
-            init_indices_();
+            init_indices_( has_time );
             std::vector< std::string > v = comma::split( hint, csv.delimiter );
             for( unsigned int i = 0; i < v.size(); ++i )
             {
@@ -165,6 +196,7 @@ class Values
             }
             if( block_index_ ) { block_ = block_from_bin_( buf + block_element_.offset ); }
             if( id_index_ ) { id_ = id_from_bin_( buf + id_element_.offset ); }
+            if( t_index_ ) { t_ = t_element_.type == comma::csv::format::long_time ? comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::long_time >::from_bin( buf + t_element_.offset ) : comma::csv::format::traits< boost::posix_time::ptime >::from_bin( buf + t_element_.offset ); }
         }
 
         void set( const std::string& line ) // quick and dirty, probably very slow
@@ -174,13 +206,15 @@ class Values
             for( unsigned int i = 0; i < indices_.size(); ++i ) { w[i] = v[indices_[i]]; }
             const std::string& s = format_.csv_to_bin( w );
             ::memcpy( &buffer_[0], &s[0], buffer_.size() );
-            if( block_index_ ) { block_ = boost::lexical_cast< unsigned int >( v[ *block_index_ ] ); }
-            if( id_index_ ) { id_ = boost::lexical_cast< unsigned int >( v[ *id_index_ ] ); }
+            if( block_index_ ) { from_ascii_( block_, v[ *block_index_ ] ); }
+            if( id_index_ ) { from_ascii_( id_, v[ *id_index_ ] ); }
+            if( t_index_ ) { from_ascii_( t_, v[ *t_index_ ] ); }
         }
 
         const comma::csv::format& format() const { return format_; }
         unsigned int block() const { return block_; }
         unsigned int id() const { return id_; }
+        const boost::posix_time::ptime& t() const { return t_; }
         const char* buffer() const { return &buffer_[0]; }
 
     private:
@@ -193,21 +227,26 @@ class Values
         std::vector< char > buffer_;
         boost::optional< unsigned int > block_index_{ comma::silent_none< unsigned int >() };
         boost::optional< unsigned int > id_index_{ comma::silent_none< unsigned int >() };
+        boost::optional< unsigned int > t_index_{ comma::silent_none< unsigned int >() };
         comma::csv::format::element block_element_;
         comma::csv::format::element id_element_;
+        comma::csv::format::element t_element_;
         unsigned int block_;
         unsigned int id_;
+        boost::posix_time::ptime t_;
         std::function< comma::uint32( const char* ) > block_from_bin_;
         std::function< comma::uint32( const char* ) > id_from_bin_;
         template < typename T > static comma::uint32 from_bin_( const char* buf ) { return comma::csv::format::traits< T >::from_bin( buf ); }
+        template < typename T > static void from_ascii_( T& t, const std::string& s ) { comma::csv::impl::ascii_cast< T >::from( t, &s[0], &s[0] + s.size() ); }
 
-        void init_indices_()
+        void init_indices_( bool has_time )
         {
             std::vector< std::string > v = comma::split( csv_.fields, ',' );
             for( unsigned int i = 0; i < v.size(); ++i )
             {
                 if( v[i] == "block" ) { block_index_ = i; }
                 else if( v[i] == "id" ) { id_index_ = i; }
+                else if( v[i] == "t" && has_time ) { t_index_ = i; }
                 else if( v[i] != "" ) { indices_.push_back( i ); }
             }
         }
@@ -219,6 +258,7 @@ class Values
                 {
                     if( block_index_ && *block_index_ == i ) { continue; }
                     if( id_index_ && *id_index_ == i ) { continue; }
+                    if( t_index_ && *t_index_ == i ) { continue; }
                     indices_.push_back( i );
                 }
             }
@@ -233,6 +273,11 @@ class Values
                 input_elements_.push_back( input_format_.offset( indices_[i] ) );
             }
             buffer_.resize( format_.size() );
+            if( t_index_ )
+            {
+                t_element_ = input_format_.offset( *t_index_ );
+                if( t_element_.type != comma::csv::format::time && t_element_.type != comma::csv::format::long_time ) { COMMA_THROW( comma::exception, "expected time for t, got format " << input_format_.string() ); }
+            }
             if( block_index_ )
             {
                 block_element_ = input_format_.offset( *block_index_ );
@@ -273,16 +318,16 @@ class Values
 class ascii_input
 {
     public:
-        ascii_input( const comma::csv::options& csv, const boost::optional< comma::csv::format >& format ) : csv_( csv )
+        ascii_input( const comma::csv::options& csv, const boost::optional< comma::csv::format >& format, bool has_time = false ) : csv_( csv ), has_time_( has_time )
         {
-            if( format ) { values_.reset( new Values( csv, *format ) ); }
+            if( format ) { values_.reset( new Values( csv, *format, has_time ) ); }
         }
 
         const Values* read()
         {
             std::getline( std::cin, line_ );
             if( line_ == "" ) { return NULL; }
-            if( !values_ ) { values_.reset( new Values( csv_, line_ ) ); }
+            if( !values_ ) { values_.reset( new Values( csv_, line_, has_time_ ) ); }
             values_->set( line_ );
             return values_.get();
         }
@@ -291,6 +336,7 @@ class ascii_input
         
     private:
         comma::csv::options csv_;
+        bool has_time_;
         boost::scoped_ptr< Values > values_;
         std::string line_;
 };
@@ -298,50 +344,25 @@ class ascii_input
 class binary_input
 {
     public:
-        binary_input( const comma::csv::options& csv )
-            : csv_( csv )
-            , values_( csv, csv.format() )
-            , buffer_( csv.format().size() > 65536 ? csv.format().size() : 65536 / csv.format().size() * csv.format().size() )
-            , cur_( &buffer_[0] )
-            , end_( &buffer_[0] + buffer_.size() )
-            , offset_( 0 )
-        {
-        }
+        binary_input( const comma::csv::options& csv, bool has_time = false ) : values_( csv, csv.format(), has_time ), reader_( std::cin, csv.format().size(), 0, csv.mmap ), index_( 0 ) {}
 
         const Values* read()
         {
-            while( true )
+            if( ++index_ >= reader_.size() ) // all records of the batch consumed
             {
-                //std::cin.read( &buffer_[0], csv_.format().size() );
-                //if( std::cin.gcount() == 0 ) { return NULL; }
-                //if( std::cin.gcount() != int( csv_.format().size() ) ) { COMMA_THROW( comma::exception, "expected " << csv_.format().size() << " bytes; got " << std::cin.gcount() ); }
-                //values_.set( &buffer_[0] );
-                //return &values_;
-                if( offset_ >= csv_.format().size() )
-                {
-                    values_.set( cur_ );
-                    line_ = std::string( cur_, csv_.format().size() );
-                    cur_ += csv_.format().size();
-                    offset_ -= csv_.format().size();
-                    if( cur_ == end_ ) { cur_ = &buffer_[0]; offset_ = 0; }
-                    return &values_;
-                }
-                int count = ::read( 0, cur_ + offset_, end_ - cur_ - offset_ );
-                if( count <= 0 ) { return NULL; }
-                offset_ += count;
+                if( reader_.read() == 0 ) { return NULL; }
+                index_ = 0;
             }
+            values_.set( reader_.record( index_ ) );
+            return &values_;
         }
-        
-        const std::string& line() const { return line_; }
+
+        std::string line() const { return std::string( reader_.record( index_ ), reader_.record_size() ); }
 
     private:
-        comma::csv::options csv_;
         Values values_;
-        std::vector< char > buffer_;
-        char* cur_;
-        const char* end_;
-        unsigned int offset_;
-        std::string line_;
+        comma::csv::impl::block_reader reader_;
+        std::size_t index_;
 };
 
 namespace impl {
@@ -536,6 +557,18 @@ namespace Operations
             std::size_t count_;
     };
 
+    static boost::optional< unsigned int > approximate; // sketch size for approximate percentiles
+
+    template < typename T > struct Interpolation
+    {
+        static T between( T lhs, T rhs, double fraction ) { double v1 = lhs; double v2 = rhs; return static_cast< T >( v1 + ( v2 - v1 ) * fraction ); }
+    };
+
+    template <> struct Interpolation< boost::posix_time::ptime >
+    {
+        static boost::posix_time::ptime between( boost::posix_time::ptime lhs, boost::posix_time::ptime rhs, double fraction ) { return lhs + boost::posix_time::microseconds( comma::int64( ( rhs - lhs ).total_microseconds() * fraction ) ); }
+    };
+
     template < typename T, comma::csv::format::types_enum F = comma::csv::format::type_to_enum< T >::value >
     class Percentile : public base
     {
@@ -544,13 +577,18 @@ namespace Operations
 
             Percentile() : percentile_( 0.0 ), method_( nearest ) {}
 
-            void push( const char* buf ) { values_.insert( comma::csv::format::traits< T, F >::from_bin( buf ) ); }
+            void push( const char* buf )
+            {
+                if( sketch_ ) { sketch_->push( comma::csv::format::traits< T, F >::from_bin( buf ) ); }
+                else { values_.push_back( comma::csv::format::traits< T, F >::from_bin( buf ) ); }
+            }
 
             void set_options( const std::vector< std::string >& options )
             {
                 if( options.empty() ) { std::cerr << comma::verbose.app_name() << ": percentile operation requires a percentile" << std::endl; exit( 1 ); }
                 percentile_ = boost::lexical_cast< double >( options[0] );
                 if( percentile_ < 0.0 || percentile_ > 1.0 ) { std::cerr << comma::verbose.app_name() << ": percentile value should be between 0 and 1, got " << percentile_ << std::endl; exit( 1 ); }
+                if( approximate ) { sketch_ = comma::math::quantile_sketch< T >( *approximate ); }
                 if( options.size() < 2 ) { return; }
                 if( options[1] == "nearest" ) { method_ = nearest; }
                 else if( options[1] == "interpolate" ) { method_ = interpolate; }
@@ -559,11 +597,10 @@ namespace Operations
 
             void calculate( char* buf )
             {
-                if( values_.empty() ) { return; }
-                std::size_t count = values_.size();
+                std::size_t count = sketch_ ? sketch_->count() : values_.size();
+                if( count == 0 ) { return; }
                 comma::verbose << "calculating " << percentile_*100 << "th percentile using ";
-                T value = comma::csv::format::traits< T, F >::zero();
-                typename std::multiset< T >::iterator it = values_.begin();
+                T value = T();
                 switch( method_ )
                 {
                     std::size_t rank;
@@ -574,8 +611,7 @@ namespace Operations
                         comma::verbose << "see https://en.wikipedia.org/wiki/Percentile#The_Nearest_Rank_method" << std::endl;
                         rank = ( percentile_ == 0.0 ? 1 : std::ceil( count * percentile_ ));
                         comma::verbose << "n = " << rank << std::endl;
-                        std::advance( it, rank - 1 );
-                        value = *it;
+                        value = at_rank_( rank );
                         break;
 
                     case interpolate:
@@ -588,46 +624,45 @@ namespace Operations
                         if( x <= 1.0 )
                         {
                             comma::verbose << "; below 1 - choosing smallest value" << std::endl;
-                            value = *it;
+                            value = at_rank_( 1 );
                         }
                         else if( x >= count )
                         {
                             comma::verbose << "; above N - choosing largest value" << std::endl;
-                            value = *( values_.rbegin() );
+                            value = at_rank_( count );
                         }
                         else
                         {
                             rank = x;
                             double remainder = x - rank;
                             comma::verbose << "; k = " << rank << "; d = " << remainder << std::endl;
-                            std::advance( it, rank - 1 );
-                            double v1 = *it;
-                            double v2 = *++it;
-                            value = v1 + ( v2 - v1 ) * remainder;
+                            T v1 = at_rank_( rank );
+                            T v2 = sketch_ ? sketch_->at_rank( rank + 1 ) : *std::min_element( values_.begin() + rank, values_.end() ); // values after rank-th are not less than it
+                            value = Interpolation< T >::between( v1, v2, remainder );
                             comma::verbose << "v1 = " << v1 << "; v2 = " << v2 << "; result = " << value << std::endl;
                         }
                         break;
                 }
-                comma::csv::format::traits< T, F >::to_bin( static_cast< T >( value ), buf );
+                comma::csv::format::traits< T, F >::to_bin( value, buf );
             }
 
             base* clone() const { return new Percentile< T, F >( *this ); }
             
-            void reset() { values_.clear(); }
+            void reset() { values_.clear(); if( sketch_ ) { sketch_->clear(); } }
 
         private:
-            std::multiset< T > values_;
+            std::vector< T > values_;
+            boost::optional< comma::math::quantile_sketch< T > > sketch_;
             double percentile_;
             Method method_;
-    };
 
-    template < comma::csv::format::types_enum F >
-    class Percentile< boost::posix_time::ptime, F > : public base
-    {
-        void reset() { COMMA_THROW( comma::exception, "percentile not implemented for time, todo" ); }
-        void push( const char* ) { COMMA_THROW( comma::exception, "percentile not implemented for time, todo" ); }
-        void calculate( char* ) { COMMA_THROW( comma::exception, "percentile not implemented for time, todo" ); }
-        base* clone() const { COMMA_THROW( comma::exception, "percentile not implemented for time, todo" ); }
+            T at_rank_( std::size_t rank ) // rank is 1-based
+            {
+                if( sketch_ ) { return sketch_->at_rank( rank ); }
+                auto it = values_.begin() + ( rank - 1 );
+                std::nth_element( values_.begin(), it, values_.end() );
+                return *it;
+            }
     };
 
     template < typename T, comma::csv::format::types_enum F > class Stddev;
@@ -1195,6 +1230,255 @@ class operations_battery_farm_t // all this pain is because operations polymorhi
 
 static operations_battery_farm_t operations_battery_farm;
         
+namespace columnar { // all this pain is because per-value virtual calls and per-id maps of operations are too slow on large inputs
+
+/// flat open-addressing map of id to dense slot number; slots are given out in order of appearance
+class slots
+{
+    public:
+        slots() { clear(); }
+
+        std::pair< comma::uint32, bool > insert( comma::uint32 id )
+        {
+            if( !ids_.empty() && id == last_ ) { return std::make_pair( last_slot_, false ); }
+            std::size_t mask = values_.size() - 1;
+            std::size_t i = hash_( id );
+            for( ; values_[i] != 0; i = ( i + 1 ) & mask )
+            {
+                if( keys_[i] == id ) { last_ = id; last_slot_ = values_[i] - 1; return std::make_pair( last_slot_, false ); }
+            }
+            keys_[i] = id;
+            values_[i] = ids_.size() + 1;
+            ids_.push_back( id );
+            last_ = id;
+            last_slot_ = ids_.size() - 1;
+            if( ids_.size() * 2 > values_.size() ) { grow_(); }
+            return std::make_pair( last_slot_, true );
+        }
+
+        std::size_t size() const { return ids_.size(); }
+
+        void clear() { keys_.assign( 16, 0 ); values_.assign( 16, 0 ); shift_ = 60; ids_.clear(); }
+
+    private:
+        std::vector< comma::uint32 > keys_;
+        std::vector< comma::uint32 > values_; // slot + 1; 0: empty
+        std::vector< comma::uint32 > ids_;
+        unsigned int shift_;
+        comma::uint32 last_{0};
+        comma::uint32 last_slot_{0};
+
+        std::size_t hash_( comma::uint32 id ) const { return ( comma::uint64( id ) * 0x9e3779b97f4a7c15ull ) >> shift_; } // fibonacci hashing
+
+        void grow_()
+        {
+            keys_.assign( keys_.size() * 2, 0 );
+            values_.assign( values_.size() * 2, 0 );
+            --shift_;
+            std::size_t mask = values_.size() - 1;
+            for( std::size_t s = 0; s < ids_.size(); ++s )
+            {
+                std::size_t i = hash_( ids_[s] );
+                while( values_[i] != 0 ) { i = ( i + 1 ) & mask; }
+                keys_[i] = ids_[s];
+                values_[i] = s + 1;
+            }
+        }
+};
+
+/// aggregation of min, max, centre, diameter, radius, sum, mean, var, stddev, and size on double fields
+///
+/// records are decoded into a batch of columns, one per field, and each column is reduced
+/// in a tight loop over the batch into per-id state kept as arrays indexed by slot
+///
+/// the arithmetic and the order of reductions are exactly the same as in the Operations classes,
+/// thus the output is byte-identical to the output of the general implementation
+class engine
+{
+    public:
+        static bool supports( const std::vector< Operations::operation_parameters >& operations, const comma::csv::format& format )
+        {
+            if( format.count() == 0 ) { return false; }
+            for( std::size_t i = 0; i < format.count(); ++i ) { if( format.offset( i ).type != comma::csv::format::double_t ) { return false; } }
+            for( const auto& o: operations )
+            {
+                switch( o.type )
+                {
+                    case Operations::Enum::min: case Operations::Enum::max: case Operations::Enum::centre: case Operations::Enum::diameter: case Operations::Enum::radius:
+                    case Operations::Enum::sum: case Operations::Enum::mean: case Operations::Enum::variance: case Operations::Enum::stddev: case Operations::Enum::size:
+                        break;
+                    default:
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        engine( const std::vector< Operations::operation_parameters >& operations, const comma::csv::format& format )
+            : operations_( operations )
+            , size_( format.count() )
+            , columns_( size_ * batch_size )
+            , batch_slots_( batch_size )
+            , batch_counts_( batch_size )
+            , batch_( 0 )
+            , state_( size_ )
+        {
+            for( const auto& o: operations_ )
+            {
+                comma::csv::format f;
+                for( unsigned int i = 0; i < size_; ++i ) { f += comma::csv::format::to_format( o.type == Operations::Enum::size ? comma::csv::format::uint32 : comma::csv::format::double_t ); }
+                output_formats_.push_back( f );
+                sample_.push_back( !o.options.empty() && o.options[0] == "sample" );
+                switch( o.type )
+                {
+                    case Operations::Enum::min: case Operations::Enum::max: case Operations::Enum::centre: case Operations::Enum::diameter: case Operations::Enum::radius: min_max_ = true; break;
+                    case Operations::Enum::sum: sum_ = true; break;
+                    case Operations::Enum::mean: mean_ = true; break;
+                    case Operations::Enum::variance: case Operations::Enum::stddev: moments_ = true; break;
+                    default: break;
+                }
+            }
+        }
+
+        void push( const Values& v ) { push( v.id(), v.buffer() ); }
+
+        void push( comma::uint32 id, const char* buf )
+        {
+            std::pair< comma::uint32, bool > s = slots_.insert( id );
+            if( s.second ) { order_[id] = s.first; resize_( slots_.size() ); }
+            batch_slots_[ batch_ ] = s.first;
+            for( unsigned int i = 0; i < size_; ++i ) { columns_[ i * batch_size + batch_ ] = comma::csv::format::traits< double >::from_bin( buf + i * sizeof( double ) ); }
+            if( ++batch_ == batch_size ) { flush_(); }
+        }
+
+        void calculate( const comma::csv::options& csv, results_map_t& results )
+        {
+            flush_();
+            std::vector< char > buffer;
+            for( const auto& o: order_ ) // same order of ids as in operations_map_t
+            {
+                std::size_t s = o.second;
+                std::string r;
+                for( std::size_t i = 0; i < operations_.size(); ++i )
+                {
+                    buffer.resize( output_formats_[i].size() );
+                    for( unsigned int j = 0; j < size_; ++j )
+                    {
+                        const column_state& c = state_[j];
+                        char* p = &buffer[0] + output_formats_[i].offset( j ).offset;
+                        std::size_t n = sample_[i] ? count_[s] - 1 : count_[s];
+                        switch( operations_[i].type )
+                        {
+                            case Operations::Enum::min: put_( c.min[s], p ); break;
+                            case Operations::Enum::max: put_( c.max[s], p ); break;
+                            case Operations::Enum::centre: put_( c.min[s] + ( c.max[s] - c.min[s] ) / 2, p ); break;
+                            case Operations::Enum::diameter: put_( c.max[s] - c.min[s], p ); break;
+                            case Operations::Enum::radius: put_( ( c.max[s] - c.min[s] ) / 2, p ); break;
+                            case Operations::Enum::sum: put_( c.sum[s], p ); break;
+                            case Operations::Enum::mean: put_( c.mean[s], p ); break;
+                            case Operations::Enum::variance: put_( c.m2[s] / n, p ); break;
+                            case Operations::Enum::stddev: put_( static_cast< double >( std::sqrt( static_cast< long double >( c.m2[s] / n ) ) ), p ); break;
+                            case Operations::Enum::size: comma::csv::format::traits< comma::uint32 >::to_bin( count_[s], p ); break;
+                            default: break;
+                        }
+                    }
+                    if( csv.binary() ) { r.append( &buffer[0], buffer.size() ); continue; }
+                    if( i > 0 ) { r += csv.delimiter; }
+                    r.append( output_formats_[i].bin_to_csv( &buffer[0], csv.delimiter, csv.precision ) );
+                }
+                results[ o.first ] = r;
+            }
+            slots_.clear();
+            order_.clear();
+            count_.clear();
+        }
+
+    private:
+        enum { batch_size = 4096 };
+        struct column_state { std::vector< double > min, max, sum, mean, first, m1, m2; }; // arrays by slot
+        std::vector< Operations::operation_parameters > operations_;
+        std::vector< comma::csv::format > output_formats_;
+        std::vector< bool > sample_;
+        unsigned int size_;
+        bool min_max_{false};
+        bool sum_{false};
+        bool mean_{false};
+        bool moments_{false};
+        slots slots_;
+        boost::unordered_map< comma::uint32, comma::uint32 > order_;
+        std::vector< double > columns_; // batch of values, column by column
+        std::vector< comma::uint32 > batch_slots_;
+        std::vector< std::size_t > batch_counts_; // value count of record's slot including the record
+        std::size_t batch_;
+        std::vector< std::size_t > count_; // by slot
+        std::vector< column_state > state_; // by field
+
+        static void put_( double d, char* buf ) { comma::csv::format::traits< double >::to_bin( d, buf ); }
+
+        void resize_( std::size_t size )
+        {
+            if( count_.size() >= size ) { return; }
+            count_.resize( size, 0 );
+            for( auto& c: state_ )
+            {
+                if( min_max_ ) { c.min.resize( size ); c.max.resize( size ); }
+                if( sum_ ) { c.sum.resize( size ); }
+                if( mean_ ) { c.mean.resize( size ); }
+                if( moments_ ) { c.first.resize( size ); c.m1.resize( size ); c.m2.resize( size ); }
+            }
+        }
+
+        void flush_()
+        {
+            const comma::uint32* slot = &batch_slots_[0];
+            std::size_t* n = &batch_counts_[0];
+            for( std::size_t r = 0; r < batch_; ++r ) { n[r] = ++count_[ slot[r] ]; }
+            for( unsigned int i = 0; i < size_; ++i )
+            {
+                const double* t = &columns_[ i * batch_size ];
+                column_state& c = state_[i];
+                if( min_max_ )
+                {
+                    double* min = &c.min[0];
+                    double* max = &c.max[0];
+                    for( std::size_t r = 0; r < batch_; ++r )
+                    {
+                        if( n[r] == 1 || t[r] < min[ slot[r] ] ) { min[ slot[r] ] = t[r]; }
+                        if( n[r] == 1 || t[r] > max[ slot[r] ] ) { max[ slot[r] ] = t[r]; }
+                    }
+                }
+                if( sum_ )
+                {
+                    double* sum = &c.sum[0];
+                    for( std::size_t r = 0; r < batch_; ++r ) { sum[ slot[r] ] = n[r] == 1 ? t[r] : sum[ slot[r] ] + t[r]; }
+                }
+                if( mean_ )
+                {
+                    double* mean = &c.mean[0];
+                    for( std::size_t r = 0; r < batch_; ++r ) { mean[ slot[r] ] = n[r] == 1 ? t[r] : mean[ slot[r] ] + ( t[r] - mean[ slot[r] ] ) / n[r]; }
+                }
+                if( moments_ ) // see Operations::Moment
+                {
+                    double* first = &c.first[0];
+                    double* m1 = &c.m1[0];
+                    double* m2 = &c.m2[0];
+                    for( std::size_t r = 0; r < batch_; ++r )
+                    {
+                        comma::uint32 s = slot[r];
+                        if( n[r] == 1 ) { first[s] = t[r]; m1[s] = 0; m2[s] = 0; }
+                        double diff = t[r] - first[s];
+                        double d = diff - m1[s];
+                        m2[s] = m2[s] + d * d * ( n[r] - 1 ) / n[r];
+                        m1[s] = m1[s] + ( diff - m1[s] ) / n[r];
+                    }
+                }
+            }
+            batch_ = 0;
+        }
+};
+
+} // namespace columnar {
+
 static void output( const comma::csv::options& csv, results_map_t& results, boost::optional< comma::uint32 > block, bool has_block, bool has_id )
 {
     for( results_map_t::iterator it = results.begin(); it != results.end(); ++it )
@@ -1232,7 +1516,7 @@ static void append_and_output( const comma::csv::options& csv, inputs_t& inputs,
     ids.clear();
 }
 
-static void calculate( const comma::csv::options& csv, operations_map_t& operations, results_map_t& results )
+static void calculate( const comma::csv::options& csv, operations_map_t& operations, results_map_t& results, operations_battery_farm_t& farm = operations_battery_farm )
 {
     for( operations_map_t::iterator it = operations.begin(); it != operations.end(); ++it )
     {
@@ -1259,16 +1543,412 @@ static void calculate( const comma::csv::options& csv, operations_map_t& operati
         results[ it->first ] = r;
     }
     operations.clear();
-    operations_battery_farm.reset();
+    farm.reset();
 }
 
+namespace parallel {
+
+/// aggregation of a partition of ids in its own thread
+///
+/// records are passed to the thread in batches through a bounded queue; results are
+/// calculated in the thread as well, since with many ids it is a large part of the work
+class worker
+{
+    public:
+        worker( const std::vector< Operations::operation_parameters >& operations, const comma::csv::format& format, const comma::csv::options& csv )
+            : operations_( operations )
+            , format_( format )
+            , csv_( csv )
+            , size_( format.size() )
+            , calculated_( true )
+            , done_( false )
+        {
+            if( columnar::engine::supports( operations, format ) ) { engine_.reset( new columnar::engine( operations, format ) ); }
+            thread_ = std::thread( &worker::run_, this );
+        }
+
+        ~worker()
+        {
+            { std::lock_guard< std::mutex > lock( mutex_ ); done_ = true; }
+            ready_.notify_all();
+            thread_.join();
+        }
+
+        void push( comma::uint32 id, const char* buf )
+        {
+            batch_.ids.push_back( id );
+            batch_.records.insert( batch_.records.end(), buf, buf + size_ );
+            if( batch_.ids.size() == batch_size ) { post_( false ); }
+        }
+
+        /// start calculating results for records pushed so far
+        void calculate() { post_( true ); }
+
+        /// wait for results
+        results_map_t& results()
+        {
+            std::unique_lock< std::mutex > lock( mutex_ );
+            calculated_condition_.wait( lock, [&]() { return calculated_; } );
+            if( error_ ) { std::rethrow_exception( error_ ); }
+            return results_;
+        }
+
+    private:
+        enum { batch_size = 4096, queue_size = 16 };
+        struct batch
+        {
+            std::vector< comma::uint32 > ids;
+            std::vector< char > records;
+            bool calculate{false};
+        };
+        std::vector< Operations::operation_parameters > operations_;
+        comma::csv::format format_;
+        comma::csv::options csv_;
+        std::size_t size_;
+        boost::scoped_ptr< columnar::engine > engine_;
+        operations_battery_farm_t farm_;
+        operations_map_t operations_map_;
+        results_map_t results_;
+        batch batch_;
+        std::deque< batch > queue_;
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        std::condition_variable space_;
+        std::condition_variable calculated_condition_;
+        bool calculated_;
+        bool done_;
+        std::exception_ptr error_;
+        std::thread thread_;
+
+        void post_( bool calculate )
+        {
+            batch_.calculate = calculate;
+            {
+                std::unique_lock< std::mutex > lock( mutex_ );
+                space_.wait( lock, [&]() { return queue_.size() < queue_size; } );
+                if( calculate ) { calculated_ = false; }
+                queue_.push_back( std::move( batch_ ) );
+            }
+            ready_.notify_one();
+            batch_ = batch();
+        }
+
+        void run_()
+        {
+            while( true )
+            {
+                batch b;
+                {
+                    std::unique_lock< std::mutex > lock( mutex_ );
+                    ready_.wait( lock, [&]() { return done_ || !queue_.empty(); } );
+                    if( queue_.empty() ) { return; }
+                    b = std::move( queue_.front() );
+                    queue_.pop_front();
+                }
+                space_.notify_one();
+                try
+                {
+                    if( !error_ ) { push_( b ); }
+                    if( b.calculate && !error_ ) { if( engine_ ) { engine_->calculate( csv_, results_ ); } else { ::calculate( csv_, operations_map_, results_, farm_ ); } }
+                }
+                catch( ... ) { error_ = std::current_exception(); }
+                if( !b.calculate ) { continue; }
+                { std::lock_guard< std::mutex > lock( mutex_ ); calculated_ = true; }
+                calculated_condition_.notify_all();
+            }
+        }
+
+        void push_( const batch& b )
+        {
+            for( std::size_t i = 0; i < b.ids.size(); ++i )
+            {
+                const char* buf = &b.records[0] + i * size_;
+                if( engine_ ) { engine_->push( b.ids[i], buf ); continue; }
+                operations_map_t::iterator it = operations_map_.find( b.ids[i] );
+                if( it == operations_map_.end() ) { it = operations_map_.insert( std::make_pair( b.ids[i], &farm_.make( operations_, format_ ) ) ).first; }
+                for( std::size_t j = 0; j < it->second->size(); ++j ) { ( *it->second )[j]->push( buf ); }
+            }
+        }
+};
+
+/// aggregation partitioned by id between worker threads
+///
+/// since all the values of an id go to the same worker, each result is calculated
+/// exactly as in a single thread; results are output in the same order as in a single thread
+class calculator
+{
+    public:
+        calculator( unsigned int threads, const std::vector< Operations::operation_parameters >& operations, const comma::csv::format& format, const comma::csv::options& csv )
+        {
+            for( unsigned int i = 0; i < threads; ++i ) { workers_.emplace_back( new worker( operations, format, csv ) ); }
+        }
+
+        void push( comma::uint32 id, const char* buf )
+        {
+            if( slots_.insert( id ).second ) { order_[id] = 0; }
+            workers_[ partition_( id ) ]->push( id, buf );
+        }
+
+        void calculate( results_map_t& results )
+        {
+            for( auto& w: workers_ ) { w->calculate(); }
+            std::vector< results_map_t* > r;
+            for( auto& w: workers_ ) { r.push_back( &w->results() ); }
+            for( const auto& o: order_ ) { results[ o.first ].swap( ( *r[ partition_( o.first ) ] )[ o.first ] ); }
+            for( auto p: r ) { p->clear(); }
+            slots_.clear();
+            order_.clear();
+        }
+
+    private:
+        std::vector< std::unique_ptr< worker > > workers_;
+        columnar::slots slots_;
+        boost::unordered_map< comma::uint32, comma::uint32 > order_; // same order of ids as in operations_map_t
+
+        std::size_t partition_( comma::uint32 id ) const { return ( ( comma::uint64( id ) * 0x9e3779b97f4a7c15ull ) >> 32 ) % workers_.size(); }
+};
+
+} // namespace parallel {
+
+namespace window {
+
+/// queue with aggregate of its elements in O(1) amortised time for associative combine, without subtraction
+///
+/// new elements are pushed on the back stack, keeping the running aggregate of it; when an element
+/// needs to be popped and the front stack is empty, all the elements are moved to the front stack,
+/// each keeping the aggregate of itself and all the elements after it
+template < typename S >
+class two_stacks
+{
+    public:
+        void push( const S& s ) { back_aggregate_ = back_.empty() ? s : S::combine( back_aggregate_, s ); back_.push_back( s ); }
+
+        void pop()
+        {
+            if( front_.empty() )
+            {
+                for( auto it = back_.rbegin(); it != back_.rend(); ++it ) { front_.push_back( front_.empty() ? *it : S::combine( *it, front_.back() ) ); }
+                back_.clear();
+            }
+            front_.pop_back();
+        }
+
+        S aggregate() const
+        {
+            if( front_.empty() ) { return back_aggregate_; }
+            return back_.empty() ? front_.back() : S::combine( front_.back(), back_aggregate_ );
+        }
+
+        void clear() { front_.clear(); back_.clear(); }
+
+    private:
+        std::vector< S > front_;
+        std::vector< S > back_;
+        S back_aggregate_;
+};
+
+/// sum and central moments of values, combined as in Chan et al, 1979
+struct moments
+{
+    double count{0};
+    double sum{0};
+    double mean{0};
+    double m2{0};
+
+    moments() {}
+    moments( double t ) : count( 1 ), sum( t ), mean( t ) {}
+
+    static moments combine( const moments& lhs, const moments& rhs )
+    {
+        moments m;
+        m.count = lhs.count + rhs.count;
+        m.sum = lhs.sum + rhs.sum;
+        double delta = rhs.mean - lhs.mean;
+        m.mean = lhs.mean + delta * rhs.count / m.count;
+        m.m2 = lhs.m2 + rhs.m2 + delta * delta * lhs.count * rhs.count / m.count;
+        return m;
+    }
+};
+
+/// monotonic deque: front is the extremum of the values in the window
+template < typename Less >
+class extremum
+{
+    public:
+        void push( comma::uint64 index, double t )
+        {
+            while( !values_.empty() && !Less()( values_.back().second, t ) ) { values_.pop_back(); }
+            values_.push_back( std::make_pair( index, t ) );
+        }
+
+        void pop( comma::uint64 begin ) { if( values_.front().first < begin ) { values_.pop_front(); } } // begin: index of first value remaining in window
+
+        double operator()() const { return values_.front().second; }
+
+        void clear() { values_.clear(); }
+
+    private:
+        std::deque< std::pair< comma::uint64, double > > values_;
+};
+
+/// aggregation over sliding window of the last records or the last seconds for each id
+///
+/// supported operations: min, max, centre, diameter, radius, sum, mean, var, stddev, size;
+/// values are aggregated as doubles; each record costs O(1) amortised time
+class calculator
+{
+    public:
+        calculator( const std::vector< Operations::operation_parameters >& operations
+                  , const comma::csv::format& format
+                  , const boost::optional< boost::posix_time::time_duration >& duration
+                  , const boost::optional< std::size_t >& size )
+            : operations_( operations )
+            , size_( size )
+            , duration_( duration )
+        {
+            if( duration_ && duration_->total_microseconds() <= 0 ) { COMMA_THROW( comma::exception, "window: expected duration of at least 1 microsecond, got " << *duration_ ); }
+            for( std::size_t i = 0; i < format.count(); ++i )
+            {
+                elements_.push_back( format.offset( i ) );
+                switch( elements_.back().type )
+                {
+                    case comma::csv::format::time:
+                    case comma::csv::format::long_time:
+                    case comma::csv::format::fixed_string:
+                        COMMA_THROW( comma::exception, "window: expected numeric fields, got format " << format.string() );
+                    default:
+                        break;
+                }
+            }
+            for( const auto& o: operations_ )
+            {
+                switch( o.type )
+                {
+                    case Operations::Enum::min: case Operations::Enum::max: case Operations::Enum::centre: case Operations::Enum::diameter: case Operations::Enum::radius:
+                    case Operations::Enum::sum: case Operations::Enum::mean: case Operations::Enum::variance: case Operations::Enum::stddev:
+                        for( std::size_t i = 0; i < elements_.size(); ++i ) { output_format_ += "d"; }
+                        break;
+                    case Operations::Enum::size:
+                        for( std::size_t i = 0; i < elements_.size(); ++i ) { output_format_ += "ui"; }
+                        break;
+                    default:
+                        COMMA_THROW( comma::exception, "window: operation not supported; supported operations: min, max, centre, diameter, radius, sum, mean, var, stddev, size" );
+                }
+                sample_.push_back( !o.options.empty() && o.options[0] == "sample" );
+            }
+            buffer_.resize( output_format_.size() );
+        }
+
+        const comma::csv::format& output_format() const { return output_format_; }
+
+        /// push record and return binary output for it
+        const char* push( comma::uint32 id, const boost::posix_time::ptime& t, const char* buf )
+        {
+            window& w = windows_[id];
+            if( w.fields.empty() ) { w.fields.resize( elements_.size() ); }
+            for( std::size_t i = 0; i < elements_.size(); ++i )
+            {
+                double d = value_( elements_[i], buf );
+                w.fields[i].min.push( w.end, d );
+                w.fields[i].max.push( w.end, d );
+                w.fields[i].sums.push( moments( d ) );
+            }
+            ++w.end;
+            if( duration_ ) { w.times.push_back( t ); }
+            while( ( size_ && w.end - w.begin > *size_ ) || ( duration_ && !w.times.empty() && w.times.front() + *duration_ <= t ) )
+            {
+                ++w.begin;
+                if( duration_ ) { w.times.pop_front(); }
+                for( auto& f: w.fields ) { f.min.pop( w.begin ); f.max.pop( w.begin ); f.sums.pop(); }
+            }
+            calculate_( w );
+            return &buffer_[0];
+        }
+
+        void clear() { windows_.clear(); }
+
+    private:
+        struct field
+        {
+            extremum< std::less< double > > min;
+            extremum< std::greater< double > > max;
+            two_stacks< window::moments > sums;
+        };
+        struct window
+        {
+            comma::uint64 begin{0}; // index of first record in window
+            comma::uint64 end{0}; // index past last record in window
+            std::deque< boost::posix_time::ptime > times;
+            std::vector< field > fields;
+        };
+        std::vector< Operations::operation_parameters > operations_;
+        boost::optional< std::size_t > size_;
+        boost::optional< boost::posix_time::time_duration > duration_;
+        std::vector< comma::csv::format::element > elements_;
+        comma::csv::format output_format_;
+        std::vector< bool > sample_;
+        std::vector< char > buffer_;
+        std::unordered_map< comma::uint32, window > windows_;
+
+        static double value_( const comma::csv::format::element& e, const char* buf )
+        {
+            switch( e.type )
+            {
+                case comma::csv::format::char_t: return comma::csv::format::traits< char >::from_bin( buf );
+                case comma::csv::format::int8: return comma::csv::format::traits< char, comma::csv::format::int8 >::from_bin( buf );
+                case comma::csv::format::uint8: return comma::csv::format::traits< unsigned char >::from_bin( buf );
+                case comma::csv::format::int16: return comma::csv::format::traits< comma::int16 >::from_bin( buf );
+                case comma::csv::format::uint16: return comma::csv::format::traits< comma::uint16 >::from_bin( buf );
+                case comma::csv::format::int32: return comma::csv::format::traits< comma::int32 >::from_bin( buf );
+                case comma::csv::format::uint32: return comma::csv::format::traits< comma::uint32 >::from_bin( buf );
+                case comma::csv::format::int64: return comma::csv::format::traits< comma::int64 >::from_bin( buf );
+                case comma::csv::format::uint64: return comma::csv::format::traits< comma::uint64 >::from_bin( buf );
+                case comma::csv::format::float_t: return comma::csv::format::traits< float >::from_bin( buf );
+                case comma::csv::format::double_t: return comma::csv::format::traits< double >::from_bin( buf );
+                default: COMMA_THROW( comma::exception, "window: expected numeric type, got " << comma::csv::format::to_format( e.type ) );
+            }
+        }
+
+        void calculate_( const window& w )
+        {
+            char* p = &buffer_[0];
+            comma::uint32 count = w.end - w.begin;
+            for( std::size_t i = 0; i < operations_.size(); ++i )
+            {
+                for( const auto& f: w.fields )
+                {
+                    if( operations_[i].type == Operations::Enum::size ) { comma::csv::format::traits< comma::uint32 >::to_bin( count, p ); p += sizeof( comma::uint32 ); continue; }
+                    double d = 0;
+                    double n = sample_[i] ? count - 1. : count;
+                    switch( operations_[i].type )
+                    {
+                        case Operations::Enum::min: d = f.min(); break;
+                        case Operations::Enum::max: d = f.max(); break;
+                        case Operations::Enum::centre: d = f.min() + ( f.max() - f.min() ) / 2; break;
+                        case Operations::Enum::diameter: d = f.max() - f.min(); break;
+                        case Operations::Enum::radius: d = ( f.max() - f.min() ) / 2; break;
+                        case Operations::Enum::sum: d = f.sums.aggregate().sum; break;
+                        case Operations::Enum::mean: d = f.sums.aggregate().mean; break;
+                        case Operations::Enum::variance: d = f.sums.aggregate().m2 / n; break;
+                        case Operations::Enum::stddev: d = std::sqrt( f.sums.aggregate().m2 / n ); break;
+                        default: break;
+                    }
+                    comma::csv::format::traits< double >::to_bin( d, p );
+                    p += sizeof( double );
+                }
+            }
+        }
+};
+
+} // namespace window {
+
 int main( int ac, char** av )
 {
     try
     {
         comma::command_line_options options( ac, av, usage );
         if( options.exists( "--bash-completion" ) ) bash_completion( ac, av );
-        std::vector< std::string > unnamed = options.unnamed( "--append,--append-once,--append-to-first,--flush,--output-fields,--output-format", "--binary,-b,--delimiter,-d,--format,--fields,-f,--output-fields" );
+        std::vector< std::string > unnamed = options.unnamed( "--append,--append-once,--append-to-first,--approximate,--tumbling,--flush,--mmap,--output-fields,--output-format", "--sketch-size,--threads,--window,--window-size,--binary,-b,--delimiter,-d,--format,--fields,-f,--output-fields" );
         comma::csv::options csv( options );
         csv.full_xpath = false;
         std::cout.precision( csv.precision );
@@ -1277,6 +1957,7 @@ int main( int ac, char** av )
         #endif
         if( !csv.flush && csv.binary() ) { std::cin.tie( NULL ); std::ios_base::sync_with_stdio( false ); } // todo? quick and dirty, redesign binary_input instead?
         if( unnamed.empty() ) { std::cerr << comma::verbose.app_name() << ": please specify operations" << std::endl; exit( 1 ); }
+        if( options.exists( "--approximate" ) ) { Operations::approximate = options.value< unsigned int >( "--sketch-size", 200 ); }
         std::vector< std::string > v = comma::split( unnamed[0], ',' );
         std::vector< Operations::operation_parameters > operations_parameters( v.size() );
         for( std::size_t i = 0; i < v.size(); ++i )
@@ -1290,8 +1971,20 @@ int main( int ac, char** av )
         else if( options.exists( "--format" ) ) { format = comma::csv::format( options.value< std::string >( "--format" ) ); }
         boost::scoped_ptr< ascii_input > ascii;
         boost::scoped_ptr< binary_input > binary;
-        if( csv.binary() ) { binary.reset( new binary_input( csv ) ); }
-        else { ascii.reset( new ascii_input( csv, format ) ); }
+        boost::optional< double > window_seconds = options.optional< double >( "--window" );
+        boost::optional< std::size_t > window_size = options.optional< std::size_t >( "--window-size" );
+        bool tumbling = options.exists( "--tumbling" );
+        bool has_time = window_seconds || window_size;
+        if( tumbling && ( !window_seconds || window_size ) ) { std::cerr << comma::verbose.app_name() << ": --tumbling requires --window and does not support --window-size" << std::endl; return 1; }
+        if( ( window_seconds && *window_seconds <= 0 ) || ( window_size && *window_size == 0 ) ) { std::cerr << comma::verbose.app_name() << ": expected positive window, got 0" << std::endl; return 1; }
+        boost::optional< boost::posix_time::time_duration > window_duration;
+        if( window_seconds ) { window_duration = boost::posix_time::microseconds( comma::int64( *window_seconds * 1000000 ) ); }
+        if( window_duration && window_duration->total_microseconds() == 0 ) { std::cerr << comma::verbose.app_name() << ": expected --window of at least 1 microsecond, got " << *window_seconds << " seconds" << std::endl; return 1; }
+        if( window_seconds && !csv.has_field( "t" ) ) { std::cerr << comma::verbose.app_name() << ": --window requires field t" << std::endl; return 1; }
+        if( has_time && options.exists( "--threads" ) ) { std::cerr << comma::verbose.app_name() << ": --window, --window-size: --threads not supported" << std::endl; return 1; }
+        bool sliding = has_time && !tumbling;
+        if( csv.binary() ) { binary.reset( new binary_input( csv, has_time ) ); }
+        else { ascii.reset( new ascii_input( csv, format, has_time ) ); }
         operations_map_t operations;
         results_map_t results;
         inputs_t inputs;
@@ -1300,7 +1993,7 @@ int main( int ac, char** av )
         bool has_block = csv.has_field( "block" );
         bool has_id = csv.has_field( "id" );
         bool append_once = options.exists( "--append-once,--append-to-first" );
-        bool append = options.exists( "--append" ) || append_once;
+        bool append = options.exists( "--append" ) || append_once || sliding;
         if( options.exists( "--output-fields" ) )
         {
             std::vector < std::string > fields = comma::split(csv.fields, ',');
@@ -1312,7 +2005,7 @@ int main( int ac, char** av )
                 std::replace(v[op].begin(), v[op].end(), ':', '_');
                 for( std::size_t f = 0; f < fields.size(); f++ )
                 {
-                    if( fields[f] == "" || fields[f] == "id" || fields[f] == "block" ) { continue; }
+                    if( fields[f] == "" || fields[f] == "id" || fields[f] == "block" || ( fields[f] == "t" && has_time ) ) { continue; }
                     output_fields.push_back( fields[f] + "/" + v[op] );
                 }
             }
@@ -1324,7 +2017,8 @@ int main( int ac, char** av )
         if( options.exists( "--output-format" ) )
         {
             if ( !format ) { std::cerr << comma::verbose.app_name() << ": option --output-format requires input format to be specified, please use --format or --binary" << std::endl; return 1; }
-            auto ops = operations_battery_farm.make( operations_parameters, Values( csv, *format ).format() );
+            if( sliding ) { std::cout << window::calculator( operations_parameters, Values( csv, *format, has_time ).format(), window_duration, window_size ).output_format().string() << std::endl; return 0; }
+            auto ops = operations_battery_farm.make( operations_parameters, Values( csv, *format, has_time ).format() );
             std::cout << ops[0]->output_format().string();
             for( std::size_t i = 1; i < ops.size(); ++i ) { std::cout << ',' << ops[i]->output_format().string(); }
             if( has_id && !append ) { std::cout << ",ui"; }
@@ -1332,29 +2026,85 @@ int main( int ac, char** av )
             std::cout << std::endl;
             return 0;
         }
+        if( sliding )
+        {
+            boost::scoped_ptr< window::calculator > calculator;
+            while( std::cin.good() && !std::cin.eof() )
+            {
+                const Values* v = csv.binary() ? binary->read() : ascii->read();
+                if( v == NULL ) { if( csv.binary() ) { break; } else { continue; } } // quick and dirty: skip empty lines in ascii
+                if( !calculator ) { calculator.reset( new window::calculator( operations_parameters, v->format(), window_duration, window_size ) ); }
+                if( has_block )
+                {
+                    if( block && *block != v->block() ) { calculator->clear(); }
+                    block = v->block();
+                }
+                const char* r = calculator->push( v->id(), v->t(), v->buffer() );
+                if( csv.binary() )
+                {
+                    const std::string& line = binary->line();
+                    std::cout.write( &line[0], line.size() );
+                    std::cout.write( r, calculator->output_format().size() );
+                    if( csv.flush ) { std::cout.flush(); }
+                }
+                else
+                {
+                    std::cout << ascii->line() << csv.delimiter << calculator->output_format().bin_to_csv( r, csv.delimiter, csv.precision ) << std::endl;
+                }
+            }
+            return 0;
+        }
+        comma::int64 tumbling_window = 0;
+        bool has_tumbling_window = false;
+        boost::scoped_ptr< columnar::engine > engine;
+        boost::scoped_ptr< parallel::calculator > calculator;
+        unsigned int threads = options.value< unsigned int >( "--threads", 1 );
+        if( threads == 0 ) { threads = std::max( std::thread::hardware_concurrency(), 1u ); }
+        auto calculate_all = [&]()
+        {
+            if( calculator ) { calculator->calculate( results ); }
+            else if( engine ) { engine->calculate( csv, results ); }
+            else { calculate( csv, operations, results ); }
+        };
+        bool first = true;
         while( std::cin.good() && !std::cin.eof() )
         {
             const Values* v = csv.binary() ? binary->read() : ascii->read();
             if( v == NULL ) { if( csv.binary() ) { break; } else { continue; } } // quick and dirty: skip empty lines in ascii
-            if( has_block )
+            if( first )
             {
-                if( block && *block != v->block() ) 
-                {
-                    calculate( csv, operations, results );
-                    if ( append ) { append_and_output( csv, inputs, results, ids ); } else { output( csv, results, block, has_block, has_id ); }
-                }
-                block = v->block();
+                if( threads > 1 ) { calculator.reset( new parallel::calculator( threads, operations_parameters, v->format(), csv ) ); }
+                else if( columnar::engine::supports( operations_parameters, v->format() ) ) { engine.reset( new columnar::engine( operations_parameters, v->format() ) ); }
+                first = false;
             }
-            operations_map_t::iterator it = operations.find( v->id() );
-            if( it == operations.end() ) { it = operations.insert( std::make_pair( v->id(), &operations_battery_farm.make( operations_parameters, v->format() ) ) ).first; }
+            bool end_of_block = has_block && block && *block != v->block();
+            if( tumbling )
+            {
+                comma::int64 microseconds = ( v->t() - boost::posix_time::from_time_t( 0 ) ).total_microseconds();
+                comma::int64 duration = window_duration->total_microseconds();
+                comma::int64 w = microseconds / duration - ( microseconds % duration < 0 ? 1 : 0 );
+                end_of_block = end_of_block || ( has_tumbling_window && tumbling_window != w );
+                tumbling_window = w;
+                has_tumbling_window = true;
+            }
+            if( end_of_block )
+            {
+                calculate_all();
+                if ( append ) { append_and_output( csv, inputs, results, ids ); } else { output( csv, results, block, has_block, has_id ); }
+            }
+            if( has_block ) { block = v->block(); }
             if( append )
             {
                 if( !append_once || ids.find( v->id() ) == ids.end() ) { inputs.push_back( std::make_pair( v->id(), csv.binary() ? binary->line() : ascii->line() ) ); }
                 ids.insert( v->id() ); // quick and dirty
             }
+            if( calculator ) { calculator->push( v->id(), v->buffer() ); continue; }
+            if( engine ) { engine->push( *v ); continue; }
+            operations_map_t::iterator it = operations.find( v->id() );
+            if( it == operations.end() ) { it = operations.insert( std::make_pair( v->id(), &operations_battery_farm.make( operations_parameters, v->format() ) ) ).first; }
             for( std::size_t i = 0; i < it->second->size(); ++i ) { ( *it->second )[i]->push( v->buffer() ); }
         }
-        calculate( csv, operations, results );
+        calculate_all();
         if ( append ) { append_and_output( csv, inputs, results, ids ); }
         else { output( csv, results, block, has_block, has_id ); }
         return 0;
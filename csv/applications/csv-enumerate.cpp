@@ -35,6 +35,7 @@
 #include "../../base/types.h"
 #include "../../csv/stream.h"
 #include "../../csv/impl/unstructured.h"
+#include "../../io/select.h"
 #include "../../string/string.h"
 
 static void usage( bool verbose )
@@ -47,8 +48,14 @@ usage: cat data.csv | csv-enumerate <options>
 todo: support floating point values as input keys
 
 options
+    --buffer=<records>; binary output only: buffer up to given number of output records
+                        and write them in one go, which is much faster for small records;
+                        buffered records get written when input is idle, see --flush-period
     --fields,-f=<fields>; fields of interest, actual field names do not matter
                           e.g: --fields ,,,a,,b,,,c
+    --flush-period=<seconds>; with --buffer: write buffered records at latest given time
+                              after the first of them got buffered, even if input keeps coming
+                              or input is idle; default: write as soon as input is idle
     --format=<binary format>; if input is ascii and deducing data types may be ambiguous,
                               define field types explicitly, value as in --binary
     --output-map,--map: do not output input records, only an unsorted list of keys
@@ -88,6 +95,10 @@ int main( int ac, char** av )
         comma::command_line_options options( ac, av, usage );
         bool output_map = options.exists( "--output-map,--map" );
         comma::csv::options csv( options );
+        unsigned int buffer = options.value( "--buffer", 0 );
+        auto flush_period = options.optional< double >( "--flush-period" );
+        COMMA_ASSERT_BRIEF( buffer == 0 || csv.binary(), "--buffer: supported only for binary input and output" );
+        COMMA_ASSERT_BRIEF( !flush_period || buffer > 0, "--flush-period: please specify --buffer" );
         bool has_non_empty_field = false;
         for( const auto& f: comma::split( csv.fields, ',' ) ) { if( !f.empty() ) { has_non_empty_field = true; break; } }
         COMMA_ASSERT_BRIEF( has_non_empty_field, "please specify at least one key in fields" );
@@ -133,8 +144,18 @@ int main( int ac, char** av )
         #ifdef WIN32
         if( istream.is_binary() ) { _setmode( _fileno( stdout ), _O_BINARY ); }
         #endif
+        comma::io::select select;
+        if( buffer > 0 && !output_map )
+        {
+            ostream.binary().buffer( buffer, flush_period ? boost::posix_time::time_duration( boost::posix_time::microseconds( comma::int64( *flush_period * 1000000 ) ) ) : boost::posix_time::pos_infin );
+            select.read().add( comma::io::stdin_fd );
+        }
         while( istream.ready() || std::cin.good() )
         {
+            if( buffer > 0 && !output_map && ostream.binary().buffered() > 0 && !istream.ready() ) // do not hold buffered records on quiet input
+            {
+                if( ( flush_period ? select.wait( ostream.binary().due() ) : select.check() ) == 0 ) { ostream.flush(); }
+            }
             const input_t* p = istream.read();
             if( !p ) { break; }
             map_t::iterator it = map.find( *p );
@@ -41,6 +41,7 @@
 #include "../../application/command_line_options.h"
 #include "../../base/exception.h"
 #include "../../csv/format.h"
+#include "../../csv/impl/block_reader.h"
 #include "../../string/string.h"
 
 using namespace comma;
@@ -50,7 +51,8 @@ static void usage()
     std::cerr << std::endl;
     std::cerr << "Usage: cat blah.bin | csv-from-bin <format> --precision <precision> > blah.csv" << std::endl;
     std::cerr << std::endl;
-    std::cerr << "--precision: set precision (number of mantissa digits) for floating point types" << std::endl;
+    std::cerr << "--precision: set precision (number of mantissa digits) for floating point types; 0: shortest representation that reads back exactly" << std::endl;
+    std::cerr << "--mmap: if stdin is a regular file (e.g. csv-from-bin t,3d --mmap < blah.bin), read records from its memory mapping" << std::endl;
     std::cerr << csv::format::usage() << std::endl;
     std::cerr << std::endl;
     std::cerr << std::endl;
@@ -70,6 +72,15 @@ int main( int ac, char** av )
         boost::optional< unsigned int > precision;
         if( options.exists( "--precision" ) ) { precision = options.value< unsigned int >( "--precision" ); }
         comma::csv::format format( av[1] );
+        if( options.exists( "--mmap" ) )
+        {
+            comma::csv::impl::block_reader reader( std::cin, format.size(), 0, true );
+            if( reader.mapped() )
+            {
+                while( reader.read() > 0 ) { for( std::size_t i = 0; i < reader.size(); ++i ) { std::cout << format.bin_to_csv( reader.record( i ), delimiter, precision ) << '\n'; } } // a file, not a live stream, thus no need to flush each line
+                return 0;
+            }
+        }
         std::vector< char > w( format.size() ); //char buf[ format.size() ]; // stupid windows
         char* buf = &w[0];
         while( std::cin.good() && !std::cin.eof() )
@@ -3,10 +3,16 @@
 
 /// @author vsevolod vlaskine
 
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <deque>
+#include <fstream>
 #include <functional>
 #include <iostream>
-#include <map>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <type_traits>
@@ -14,15 +20,16 @@
 #include <vector>
 #include <boost/date_time/posix_time/ptime.hpp>
 #include <boost/functional/hash.hpp>
+#include <boost/iterator/indirect_iterator.hpp>
 #include <boost/optional.hpp>
 #include "../../application/command_line_options.h"
 #include "../../application/signal_flag.h"
 #include "../../base/exception.h"
 #include "../../base/types.h"
+#include "../../containers/multidimensional/map.h"
 #include "../../csv/stream.h"
 #include "../../csv/traits.h"
 #include "../../io/stream.h"
-#include "../../math/compare.h"
 #include "../../name_value/parser.h"
 #include "../../string/string.h"
 #include "../../visiting/traits.h"
@@ -46,10 +53,20 @@ static void usage( bool more )
     std::cerr << "    --first-matching: output only the first matching record (a bit of hack for now, but we needed it)" << std::endl;
     std::cerr << "    --flag-matching: output all records, with 1 appended to matching records and 0 appended to not-matching records" << std::endl;
     std::cerr << "    --matching: output only matching records from stdin" << std::endl;
-    std::cerr << "    --nearest: if --radius specified, output only nearest record" << std::endl;
+    std::cerr << "    --nearest: if --radius specified, output only nearest record; on equal distance, the one with the smallest keys" << std::endl;
     std::cerr << "    --not-matching: not matching records as read from stdin, no join performed" << std::endl;
+    std::cerr << "    --partitions=<n>: grace hash join for filters that do not fit in memory: if filter exceeds --memory-limit," << std::endl;
+    std::cerr << "                      spill filter and stdin records to <n> temporary files each by hash of keys and join" << std::endl;
+    std::cerr << "                      them partition by partition; choose <n> so that a filter partition fits in memory" << std::endl;
+    std::cerr << "                      attention: if spilled, output is grouped by partition, i.e. not in the order of stdin" << std::endl;
+    std::cerr << "        --memory-limit=<bytes>: memory budget for the filter; default: 0, i.e. always partition" << std::endl;
+    std::cerr << "        --temporary-directory,--tmp-dir=<dir>: directory for temporary files; default: $TMPDIR or /tmp" << std::endl;
     std::cerr << "    --output-swap,--swap-output,--swap; output filter records first with the stdin record appended, a convenience option" << std::endl;
     std::cerr << "    --radius,--epsilon=<value>; compare keys in given radius; the keys will be interpreted as floating point numbers" << std::endl;
+    std::cerr << "                                if there are 2 to 4 keys, they are treated as a point and compared by euclidean distance" << std::endl;
+    std::cerr << "                                filter is indexed in a uniform grid with cell size of <value>" << std::endl;
+    std::cerr << "    --sorted: sort-merge join: stdin and filter are sorted in ascending order of keys; both are streamed," << std::endl;
+    std::cerr << "              only filter records with the current key are kept in memory; fail if input is not sorted" << std::endl;
     std::cerr << "    --strict: fail, if id on stdin is not found, or there are multiple filter keys on --unique, etc" << std::endl;
     std::cerr << "    --unique,--unique-matches: expect only unique matches, exit with error otherwise" << std::endl;
     std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
@@ -121,6 +138,12 @@ static void usage( bool more )
         std::cerr << "        <input:3>" << std::endl;
         std::cerr << "        <input:3>" << std::endl;
         std::cerr << std::endl;
+        std::cerr << "    sort-merge join of large sorted files" << std::endl;
+        std::cerr << "        seq 0 2 1000000 | csv-join --fields=id <( seq 0 3 1000000 )';fields=id' --sorted --matching" << std::endl;
+        std::cerr << std::endl;
+        std::cerr << "    grace hash join with filter larger than 100MB" << std::endl;
+        std::cerr << "        cat input.csv | csv-join --fields=id 'filter.csv;fields=id' --partitions=16 --memory-limit=100000000" << std::endl;
+        std::cerr << std::endl;
         std::cerr << "    --drop-id (same would work in binary as well)" << std::endl;
         std::cerr << "        > echo 0,1,2,3 | csv-join --fields ,x,,y <( echo 1,A,B,3 )';fields=x,,,y'" << std::endl;
         std::cerr << "        0,1,2,3,1,A,B,3" << std::endl;
@@ -180,13 +203,6 @@ struct input
         return true;
     }
 
-    bool operator<( const input& rhs ) const
-    {
-        if( keys.empty() ) { COMMA_THROW( comma::exception, "if --radius given, expected exactly one key, got none" ); }
-        if( keys.size() > 1 ) { COMMA_THROW( comma::exception, "if --radius given, expected one key, got: " << keys.size() ); }
-        return comma::math::less( keys[0], rhs.keys[0] ); //, *radius );
-    }
-
     struct hash : public std::function< input( std::size_t ) >
     {
         std::size_t operator()( input const& p ) const
@@ -198,7 +214,39 @@ struct input
     };
 
     typedef std::unordered_map< input, std::vector< std::string >, hash > unordered_map;
-    typedef std::map< input, std::vector< std::string > > map;
+};
+
+/// filter records indexed in a uniform grid with cell size of radius for --radius and --nearest on 1 to 4 keys
+class spatial_map
+{
+    public:
+        typedef input< double > key_type;
+        typedef std::pair< key_type, std::vector< std::string > > value_type;
+        typedef boost::indirect_iterator< std::vector< value_type* >::const_iterator > iterator;
+        typedef iterator const_iterator;
+
+        /// return filter records with the given keys, insert if not present
+        std::vector< std::string >& operator[]( const key_type& key );
+
+        /// return records within radius of key in ascending order of keys or only the nearest one; valid until the next call
+        std::pair< iterator, iterator > find( const key_type& key, bool nearest );
+
+        void erase( iterator, iterator ) { COMMA_THROW( comma::exception, "erase: not supported for --radius" ); }
+
+        void clear() { values_.clear(); ids_.clear(); found_.clear(); if( grid_ ) { grid_->clear(); } }
+
+        std::size_t size() const { return values_.size(); }
+
+    private:
+        typedef comma::containers::multidimensional::map< double, std::vector< std::size_t >, 4 > grid_t;
+        std::unique_ptr< grid_t > grid_;
+        std::deque< value_type > values_;
+        std::unordered_map< key_type, std::size_t, key_type::hash > ids_;
+        std::vector< value_type* > found_;
+        unsigned int dimensions_{0};
+        grid_t::point_type point_( const key_type& key ) const;
+        static bool less_( const value_type* lhs, const value_type* rhs ) { return std::lexicographical_compare( lhs->first.keys.begin(), lhs->first.keys.end(), rhs->first.keys.begin(), rhs->first.keys.end() ); }
+        static double squared_distance_( const key_type& lhs, const key_type& rhs ) { double d = 0; for( std::size_t i = 0; i < lhs.keys.size(); ++i ) { d += ( lhs.keys[i] - rhs.keys[i] ) * ( lhs.keys[i] - rhs.keys[i] ); } return d; }
 };
 
 template < typename K, bool Strict = true > struct traits
@@ -215,58 +263,11 @@ template < typename K, bool Strict = true > struct traits
     }
 };
 
-template < typename K > struct type_traits
-{
-    template < typename Map >
-    static typename std::pair< typename Map::iterator, typename Map::iterator > bounds( Map& m, const input< K >& k ) // quick and dirty
-    {
-        input< K > l = k; // quick and dirty; lame
-        input< K > u = k;
-        l.keys[0] -= *radius;
-        u.keys[0] += *radius;
-        return std::make_pair( m.lower_bound( l ), m.upper_bound( u ) );
-    }
-    
-    template < typename Map >
-    static typename Map::iterator nearest( Map& m, const input< K >& k ) // quick and dirty
-    { 
-        auto b = type_traits< K >::bounds( m, k );
-        typename Map::iterator min = b.first;
-        for( typename Map::iterator it = b.first; it != b.second; ++it )
-        {
-            if( std::abs( min->first.keys[0] - k.keys[0] ) > std::abs( it->first.keys[0] - k.keys[0] ) ) { min = it; }
-        }
-        return min;
-    }
-};
-
-template <> struct type_traits< std::string > // quick and dirty
-{
-    template < typename Map >
-    static std::pair< typename Map::iterator, typename Map::iterator > bounds( Map& m, const input< std::string >& k ) { COMMA_THROW( comma::exception, "never here" ); }    
-    template < typename Map > static typename Map::iterator nearest( Map& m, const input< std::string >& ) { COMMA_THROW( comma::exception, "never here" ); }
-};
-
-template <> struct type_traits< boost::posix_time::ptime > // quick and dirty
-{
-    template < typename Map >
-    static typename std::pair< typename Map::iterator, typename Map::iterator > bounds( Map& m, const input< boost::posix_time::ptime >& k ) { COMMA_THROW( comma::exception, "never here" ); }
-    template < typename Map >
-    static typename Map::iterator nearest( Map& m, const input< boost::posix_time::ptime >& ) { COMMA_THROW( comma::exception, "never here" ); }
-};
-
 template < typename K > struct traits< K, false >
 {
-    typedef typename input< K >::map map;
-    typedef std::pair< typename map::iterator, typename map::iterator > pair; //typedef std::pair< typename map::const_iterator, typename map::const_iterator > pair;
-    static pair find( map& m, const input< K >& k, bool nearest )
-    {
-        if( !nearest ) { return type_traits< K >::bounds( m, k ); }
-        auto n = type_traits< K >::nearest( m, k );
-        if( n == m.end() ) { return std::make_pair( n, n ); }
-        auto end = n;
-        return std::make_pair( n, ++end );
-    }
+    typedef spatial_map map;
+    typedef std::pair< typename map::iterator, typename map::iterator > pair;
+    static pair find( map& m, const input< K >& k, bool nearest ) { return m.find( k, nearest ); }
 };
 
 namespace comma { namespace visiting {
@@ -289,6 +290,59 @@ template < typename T > struct traits< input< T > >
 
 } } // namespace comma { namespace visiting {
 
+spatial_map::grid_t::point_type spatial_map::point_( const key_type& key ) const
+{
+    grid_t::point_type p{{ 0, 0, 0, 0 }};
+    for( unsigned int i = 0; i < dimensions_; ++i ) { p[i] = key.keys[i]; }
+    return p;
+}
+
+std::vector< std::string >& spatial_map::operator[]( const key_type& key )
+{
+    if( !grid_ )
+    {
+        if( key.keys.empty() || key.keys.size() > 4 ) { COMMA_THROW( comma::exception, "if --radius given, expected 1 to 4 keys, got: " << key.keys.size() ); }
+        if( *radius < 0 ) { COMMA_THROW( comma::exception, "expected non-negative radius, got: " << *radius ); }
+        dimensions_ = key.keys.size();
+        double resolution = *radius > 0 ? *radius : 1;
+        grid_.reset( new grid_t( grid_t::point_type{{ resolution, resolution, resolution, resolution }} ) );
+    }
+    auto it = ids_.find( key );
+    if( it != ids_.end() ) { return values_[ it->second ].second; }
+    for( unsigned int i = 0; i < dimensions_; ++i ) { if( !( std::abs( key.keys[i] / grid_->resolution()[i] ) < 2e9 ) ) { COMMA_THROW( comma::exception, "key " << key.keys[i] << " is too large for radius " << *radius << " or not a number" ); } }
+    ids_[ key ] = values_.size();
+    ( *grid_->touch_at( point_( key ) ) ).second.push_back( values_.size() );
+    values_.push_back( value_type( key, std::vector< std::string >() ) );
+    return values_.back().second;
+}
+
+std::pair< spatial_map::iterator, spatial_map::iterator > spatial_map::find( const key_type& key, bool nearest )
+{
+    found_.clear();
+    if( values_.empty() ) { return std::make_pair( iterator( found_.begin() ), iterator( found_.end() ) ); }
+    double squared_radius = *radius * *radius;
+    auto index = grid_->index_of( point_( key ) );
+    unsigned int size = 1;
+    for( unsigned int i = 0; i < dimensions_; ++i ) { size *= 3; }
+    for( unsigned int n = 0; n < size; ++n ) // visit the cell of the key and its neighbours
+    {
+        auto i = index;
+        for( unsigned int d = 0, m = n; d < dimensions_; ++d, m /= 3 ) { i[d] += int( m % 3 ) - 1; }
+        auto it = grid_->find( i );
+        if( it == grid_->end() ) { continue; }
+        for( auto id: it->second ) { if( squared_distance_( values_[id].first, key ) <= squared_radius ) { found_.push_back( &values_[id] ); } }
+    }
+    std::sort( found_.begin(), found_.end(), less_ );
+    if( nearest && !found_.empty() )
+    {
+        value_type* min = found_[0];
+        double min_distance = squared_distance_( min->first, key );
+        for( auto v: found_ ) { double d = squared_distance_( v->first, key ); if( d < min_distance ) { min = v; min_distance = d; } }
+        found_.assign( 1, min );
+    }
+    return std::make_pair( iterator( found_.begin() ), iterator( found_.end() ) );
+}
+
 template < typename T > static std::string keys_as_string( const input< T >& i ) // quick and dirty
 {
     std::ostringstream oss;
@@ -363,6 +417,257 @@ template < typename K, bool Strict = true > struct join_impl_ // quick and dirty
         return last;
     }
 
+    static bool output_unmatched( comma::csv::input_stream< input< K > >& stream, const input< K >& p, std::size_t& discarded )
+    {
+        if( not_matching )
+        {
+            if( stream.is_binary() ) { std::cout.write( stream.binary().last(), stdin_csv.format().size() ); }
+            else { std::cout << comma::join( stream.ascii().last(), stdin_csv.delimiter ) << std::endl; }
+            return true;
+        }
+        if ( flag_matching )
+        {
+            if( stream.is_binary() ) { 
+                std::cout.write( stream.binary().last(), stdin_csv.format().size() ); 
+                char match = 0; std::cout.write( &match, 1 );
+            }
+            else { std::cout << comma::join( stream.ascii().last(), stdin_csv.delimiter ) << stdin_csv.delimiter << 0 << std::endl; }
+            return true;
+        }
+        if( !strict ) { ++discarded; return true; }
+        std::string s;
+        comma::csv::options c;
+        c.full_xpath = false;
+        c.fields = "keys";
+        std::cerr << "csv-join: match not found for key(s): " << comma::csv::ascii< input< K > >( c, default_input ).put( p, s ) << ", block: " << block << std::endl;
+        return false;
+    }
+
+    static bool output_matched( comma::csv::input_stream< input< K > >& stream, const input< K >& key, const std::vector< std::string >& values, K* state = nullptr )
+    {
+        if( unique && values.size() > 1 )
+        {
+            if( strict ) { std::cerr << "csv-join: with --unique option, expected unique entries, got more than one filter entry on the key: " << keys_as_string( key ) << std::endl; return false; }
+            if( verbose ) { std::cerr << "csv-join: got --unique option, but more than one filter entry on the key: " << keys_as_string( key ) << "; only the first entry will be output; use --strict to make it fatal error" << std::endl; }
+        }
+        if( state && values.size() > 1 ) { std::cerr << "csv-join: finite state machine, expected unique entries, got more than one state transition entry on the key: " << keys_as_string( key ) << std::endl; return false; }
+        if( stream.is_binary() )
+        {
+            for( std::size_t i = 0; i < ( first_matching || unique ? 1 : values.size() ); ++i )
+            {
+                if( !swap_output ) { std::cout.write( stream.binary().last(), stdin_csv.format().size() ); }
+                if( state ) { *state = key.next_state; }
+                if( flag_matching ) { char match = 1; std::cout.write( &match, 1 ); break; }
+                if( matching ) { break; }
+                std::cout.write( &( values[i][0] ), values[i].size() );
+                if( swap_output ) { std::cout.write( stream.binary().last(), stdin_csv.format().size() ); }
+                std::cout.flush();
+            }
+            std::cout.flush();
+        }
+        else
+        {
+            for( std::size_t i = 0; i < ( first_matching || unique ? 1 : values.size() ); ++i )
+            {
+                if( !swap_output ) { std::cout << comma::join( stream.ascii().last(), stdin_csv.delimiter ); }
+                if( state ) { *state = key.next_state; }
+                if( flag_matching ) { std::cout << stdin_csv.delimiter << 1 << std::endl; break; }
+                if( matching ) { std::cout << std::endl; break; }
+                if( !swap_output ) { std::cout << stdin_csv.delimiter; }
+                std::cout << ( filter_csv.binary()
+                             ? filter_csv.format().bin_to_csv( &values[i][0], stdin_csv.delimiter )
+                             : values[i] );
+                if( swap_output ) { std::cout << stdin_csv.delimiter << comma::join( stream.ascii().last(), stdin_csv.delimiter ); }
+                std::cout << std::endl;
+            }
+        }
+        return true;
+    }
+
+    /// join records of stream with filter_map; return false on error
+    static bool probe( comma::csv::input_stream< input< K > >& stream, std::size_t& discarded )
+    {
+        for( const input< K >* p = stream.read(); p; p = stream.read() )
+        {
+            typename traits< K, Strict >::pair pair = traits< K, Strict >::find( filter_map, *p, false );
+            if( pair.first == pair.second ) { if( output_unmatched( stream, *p, discarded ) ) { continue; } return false; }
+            if( not_matching ) { continue; }
+            for( typename traits< K, Strict >::map::const_iterator it = pair.first; it != pair.second; ++it )
+            {
+                if( !output_matched( stream, it->first, it->second ) ) { return false; }
+                if( first_matching ) { break; }
+            }
+            if( first_matching ) { filter_map.erase( pair.first, pair.second ); }
+        }
+        return true;
+    }
+
+    static int compare( const input< K >& lhs, const input< K >& rhs )
+    {
+        for( std::size_t i = 0; i < lhs.keys.size(); ++i )
+        {
+            if( lhs.keys[i] < rhs.keys[i] ) { return -1; }
+            if( rhs.keys[i] < lhs.keys[i] ) { return 1; }
+        }
+        return 0;
+    }
+
+    static int run_sorted( comma::csv::input_stream< input< K > >& stdin_stream )
+    {
+        comma::csv::input_stream< input< K > > filter_stream( **filter_transport, filter_csv, default_input );
+        const input< K >* f = filter_stream.read();
+        input< K > key; // key of the current group of filter records
+        std::vector< std::string > values; // current group of filter records
+        bool has_values = false;
+        bool consumed = false; // on --first-matching, a group matches only once
+        boost::optional< input< K > > previous;
+        std::size_t discarded = 0;
+        while( stdin_stream.ready() || std::cin.good() )
+        {
+            const input< K >* p = stdin_stream.read();
+            if( !p ) { break; }
+            if( previous && compare( *p, *previous ) < 0 ) { std::cerr << "csv-join: --sorted: expected stdin sorted in ascending order, got key(s) out of order: " << keys_as_string( *p ) << std::endl; return 1; }
+            previous = *p;
+            while( f && ( !has_values || compare( key, *p ) < 0 ) )
+            {
+                key = *f;
+                values.clear();
+                for( ; f && compare( *f, key ) == 0; f = filter_stream.read() ) { values.push_back( filter_stream.is_binary() ? make_output( filter_stream.binary().last() ) : make_output( filter_stream.ascii().last() ) ); }
+                if( f && compare( *f, key ) < 0 ) { std::cerr << "csv-join: --sorted: expected filter sorted in ascending order, got key(s) out of order: " << keys_as_string( *f ) << std::endl; return 1; }
+                has_values = true;
+                consumed = false;
+            }
+            if( !has_values || consumed || compare( key, *p ) != 0 ) { if( output_unmatched( stdin_stream, *p, discarded ) ) { continue; } return 1; }
+            if( not_matching ) { continue; }
+            if( !output_matched( stdin_stream, key, values ) ) { return 1; }
+            consumed = first_matching;
+        }
+        if( verbose ) { std::cerr << "csv-join: discarded " << discarded << " " << ( discarded == 1 ? "entry" : "entries" ) << " with no matches" << std::endl; }
+        return 0;
+    }
+
+    class spill_file
+    {
+        public:
+            spill_file( const std::string& directory )
+            {
+                std::string name = directory + "/csv-join.XXXXXX";
+                int fd = ::mkstemp( &name[0] );
+                if( fd < 0 ) { COMMA_THROW( comma::exception, "failed to create temporary file in " << directory << ": " << ::strerror( errno ) ); }
+                ::close( fd );
+                filename_ = name;
+                ofs_.open( filename_, std::ios::binary | std::ios::trunc );
+                if( !ofs_.is_open() ) { COMMA_THROW( comma::exception, "failed to open " << filename_ ); }
+            }
+
+            ~spill_file() { ofs_.close(); ifs_.close(); ::remove( filename_.c_str() ); }
+
+            void write( const std::string& record ) { ofs_.write( &record[0], record.size() ); }
+
+            /// done writing, return stream for reading
+            std::istream& close()
+            {
+                ofs_.close();
+                if( ofs_.fail() ) { COMMA_THROW( comma::exception, "failed to write " << filename_ << "; disk full?" ); }
+                ifs_.open( filename_, std::ios::binary );
+                if( !ifs_.is_open() ) { COMMA_THROW( comma::exception, "failed to open " << filename_ ); }
+                return ifs_;
+            }
+
+        private:
+            std::string filename_;
+            std::ofstream ofs_;
+            std::ifstream ifs_;
+    };
+
+    static std::string record( const comma::csv::input_stream< input< K > >& stream, const comma::csv::options& csv )
+    {
+        return stream.is_binary() ? std::string( stream.binary().last(), csv.format().size() ) : comma::join( stream.ascii().last(), csv.delimiter ) + '\n';
+    }
+
+    /// filter records of a partition stored once, with keys mapped to indices of records
+    struct partition
+    {
+        std::vector< std::pair< unsigned int, std::string > > records; // raw filter records with their partition
+        std::unordered_map< input< K >, std::vector< std::size_t >, typename input< K >::hash > indices;
+
+        void add( const input< K >& key, unsigned int k, std::string&& r ) { indices[key].push_back( records.size() ); records.emplace_back( k, std::move( r ) ); }
+
+        void clear() { std::vector< std::pair< unsigned int, std::string > >().swap( records ); indices.clear(); }
+    };
+
+    /// output for raw filter record as make_output() does for filter records read from stream
+    static std::string output( const std::string& r )
+    {
+        if( filter_csv.binary() ) { return make_output( &r[0] ); }
+        std::string line( r, 0, r.size() - 1 );
+        return filter_id_fields_flags.empty() && filter_csv.delimiter == stdin_csv.delimiter ? line : make_output( comma::split( line, filter_csv.delimiter ) );
+    }
+
+    /// join records of stream with partition; return false on error
+    static bool probe( comma::csv::input_stream< input< K > >& stream, partition& filter, std::size_t& discarded )
+    {
+        std::vector< std::string > values;
+        for( const input< K >* p = stream.read(); p; p = stream.read() )
+        {
+            auto it = filter.indices.find( *p );
+            if( it == filter.indices.end() ) { if( output_unmatched( stream, *p, discarded ) ) { continue; } return false; }
+            if( not_matching ) { continue; }
+            values.clear();
+            for( std::size_t i = 0; i < ( first_matching ? 1 : it->second.size() ); ++i ) { values.push_back( output( filter.records[ it->second[i] ].second ) ); }
+            if( !output_matched( stream, it->first, values ) ) { return false; }
+            if( first_matching ) { filter.indices.erase( it ); }
+        }
+        return true;
+    }
+
+    static int run_partitioned( comma::csv::input_stream< input< K > >& stdin_stream, unsigned int size, std::size_t memory_limit, const std::string& directory )
+    {
+        comma::csv::input_stream< input< K > > filter_stream( **filter_transport, filter_csv, default_input );
+        partition filter; // filter records loaded in memory
+        std::vector< std::unique_ptr< spill_file > > filter_partitions;
+        std::size_t used = 0;
+        std::size_t discarded = 0;
+        typename input< K >::hash hash;
+        for( const input< K >* f = filter_stream.read(); f; f = filter_stream.read() )
+        {
+            unsigned int k = hash( *f ) % size;
+            if( !filter_partitions.empty() ) { filter_partitions[k]->write( record( filter_stream, filter_csv ) ); continue; }
+            filter.add( *f, k, record( filter_stream, filter_csv ) );
+            used += filter.records.back().second.size() + sizeof( std::pair< unsigned int, std::string > ) + sizeof( std::size_t ) + sizeof( input< K > ) + sizeof( K ) * f->keys.size() + 64; // roughly
+            if( used <= memory_limit ) { continue; }
+            if( verbose ) { std::cerr << "csv-join: filter exceeded memory limit of " << memory_limit << " bytes; spilling to " << size << " partitions in " << directory << std::endl; }
+            for( unsigned int i = 0; i < size; ++i ) { filter_partitions.emplace_back( new spill_file( directory ) ); }
+            for( const auto& r: filter.records ) { filter_partitions[ r.first ]->write( r.second ); }
+            filter.clear();
+        }
+        if( filter_partitions.empty() )
+        {
+            if( verbose ) { std::cerr << "csv-join: filter fits in memory; hash map size: " << filter.indices.size() << std::endl; }
+            if( !probe( stdin_stream, filter, discarded ) ) { return 1; }
+            if( verbose ) { std::cerr << "csv-join: discarded " << discarded << " " << ( discarded == 1 ? "entry" : "entries" ) << " with no matches" << std::endl; }
+            return 0;
+        }
+        std::vector< std::unique_ptr< spill_file > > stdin_partitions;
+        for( unsigned int i = 0; i < size; ++i ) { stdin_partitions.emplace_back( new spill_file( directory ) ); }
+        for( const input< K >* p = stdin_stream.read(); p; p = stdin_stream.read() ) { stdin_partitions[ hash( *p ) % size ]->write( record( stdin_stream, stdin_csv ) ); }
+        for( unsigned int i = 0; i < size; ++i )
+        {
+            filter.clear();
+            {
+                comma::csv::input_stream< input< K > > stream( filter_partitions[i]->close(), filter_csv, default_input );
+                for( const input< K >* f = stream.read(); f; f = stream.read() ) { filter.add( *f, i, record( stream, filter_csv ) ); }
+            }
+            filter_partitions[i].reset();
+            if( verbose ) { std::cerr << "csv-join: partition " << i << ": hash map size: " << filter.indices.size() << std::endl; }
+            comma::csv::input_stream< input< K > > stream( stdin_partitions[i]->close(), stdin_csv, default_input );
+            if( !probe( stream, filter, discarded ) ) { return 1; }
+            stdin_partitions[i].reset();
+        }
+        if( verbose ) { std::cerr << "csv-join: discarded " << discarded << " " << ( discarded == 1 ? "entry" : "entries" ) << " with no matches" << std::endl; }
+        return 0;
+    }
+
     static int run( const comma::command_line_options& options )
     {
         bool block_less = options.exists( "--block-less" );
@@ -379,6 +684,15 @@ template < typename K, bool Strict = true > struct join_impl_ // quick and dirty
         }
         if( ( got_state || got_next_state ) && filter_id_fields_discard ) { std::cerr << "csv-join: --drop-id and 'state' or 'next_field' are mutually exclusive" << std::endl; return 1; }
         bool is_state_machine = got_state && got_next_state;
+        bool sorted = options.exists( "--sorted" );
+        auto partitions = options.optional< unsigned int >( "--partitions" );
+        if( sorted || partitions )
+        {
+            std::string option = sorted ? "--sorted" : "--partitions";
+            if( is_state_machine ) { std::cerr << "csv-join: " << option << ": finite state machine not supported" << std::endl; return 1; }
+            if( std::find( v.begin(), v.end(), "block" ) != v.end() || std::find( w.begin(), w.end(), "block" ) != w.end() ) { std::cerr << "csv-join: " << option << ": block field not supported" << std::endl; return 1; }
+            if( partitions && *partitions == 0 ) { std::cerr << "csv-join: expected positive number of partitions, got 0" << std::endl; return 1; }
+        }
         std::size_t default_input_keys_count = 0;
         bool no_stdin_key_fields = true;
         bool no_filter_key_fields = true;
@@ -432,6 +746,12 @@ template < typename K, bool Strict = true > struct join_impl_ // quick and dirty
         comma::csv::input_stream< input< K > > stdin_stream( std::cin, stdin_csv, default_input );
         filter_transport.reset( new comma::io::istream( filter_csv.filename, filter_csv.binary() ? comma::io::mode::binary : comma::io::mode::ascii ) );
         if( filter_transport->fd() == comma::io::invalid_file_descriptor ) { std::cerr << "csv-join: failed to open \"" << filter_csv.filename << "\"" << std::endl; return 1; }
+        if( sorted ) { return run_sorted( stdin_stream ); }
+        if( partitions )
+        {
+            const char* tmpdir = ::getenv( "TMPDIR" );
+            return run_partitioned( stdin_stream, *partitions, options.value< std::size_t >( "--memory-limit", 0 ), options.value< std::string >( "--temporary-directory,--tmp-dir", tmpdir ? tmpdir : "/tmp" ) );
+        }
         std::size_t discarded = 0;
         auto last = read_filter_block();
         #ifdef WIN32
@@ -464,70 +784,11 @@ template < typename K, bool Strict = true > struct join_impl_ // quick and dirty
             {
                 pair = traits< K, Strict >::find( filter_map, *p, nearest );
             }
-            if( pair.first == filter_map.end() ) // if( it == filter_map.end() || it->second.empty() )
-            {
-                if( not_matching )
-                {
-                    if( stdin_stream.is_binary() ) { std::cout.write( stdin_stream.binary().last(), stdin_csv.format().size() ); }
-                    else { std::cout << comma::join( stdin_stream.ascii().last(), stdin_csv.delimiter ) << std::endl; }
-                    continue;
-                }
-                if ( flag_matching )
-                {
-                    if( stdin_stream.is_binary() ) { 
-                        std::cout.write( stdin_stream.binary().last(), stdin_csv.format().size() ); 
-                        char match = 0; std::cout.write( &match, 1 );
-                    }
-                    else { std::cout << comma::join( stdin_stream.ascii().last(), stdin_csv.delimiter ) << stdin_csv.delimiter << 0 << std::endl; }
-                    continue;
-                }
-                if( !strict ) { ++discarded; continue; }
-                std::string s;
-                comma::csv::options c;
-                c.full_xpath = false;
-                c.fields = "keys";
-                std::cerr << "csv-join: match not found for key(s): " << comma::csv::ascii< input< K > >( c, default_input ).put( *p, s ) << ", block: " << block << std::endl;
-                return 1;
-            }
+            if( pair.first == pair.second ) { if( output_unmatched( stdin_stream, *p, discarded ) ) { continue; } return 1; }
             if( not_matching ) { continue; }
             for( typename traits< K, Strict >::map::const_iterator it = pair.first; it != pair.second; ++it )
             {
-                if( unique && it->second.size() > 1 )
-                {
-                    if( strict ) { std::cerr << "csv-join: with --unique option, expected unique entries, got more than one filter entry on the key: " << keys_as_string( it->first ) << std::endl; return 1; }
-                    if( verbose ) { std::cerr << "csv-join: got --unique option, but more than one filter entry on the key: " << keys_as_string( it->first ) << "; only the first entry will be output; use --strict to make it fatal error" << std::endl; }
-                }
-                if( is_state_machine && it->second.size() > 1 ) { std::cerr << "csv-join: finite state machine, expected unique entries, got more than one state transition entry on the key: " << keys_as_string( it->first ) << std::endl; return 1; }
-                if( stdin_stream.is_binary() )
-                {
-                    for( std::size_t i = 0; i < ( first_matching || unique ? 1 : it->second.size() ); ++i )
-                    {
-                        if( !swap_output ) { std::cout.write( stdin_stream.binary().last(), stdin_csv.format().size() ); }
-                        if( is_state_machine ) { state = it->first.next_state; }
-                        if( flag_matching ) { char match = 1; std::cout.write( &match, 1 ); break; }
-                        if( matching ) { break; }
-                        std::cout.write( &( it->second[i][0] ), it->second[i].size() );
-                        if( swap_output ) { std::cout.write( stdin_stream.binary().last(), stdin_csv.format().size() ); }
-                        std::cout.flush();
-                    }
-                    std::cout.flush();
-                }
-                else
-                {
-                    for( std::size_t i = 0; i < ( first_matching || unique ? 1 : it->second.size() ); ++i )
-                    {
-                        if( !swap_output ) { std::cout << comma::join( stdin_stream.ascii().last(), stdin_csv.delimiter ); }
-                        if( is_state_machine ) { state = it->first.next_state; }
-                        if( flag_matching ) { std::cout << stdin_csv.delimiter << 1 << std::endl; break; }
-                        if( matching ) { std::cout << std::endl; break; }
-                        if( !swap_output ) { std::cout << stdin_csv.delimiter; }
-                        std::cout << ( filter_csv.binary()
-                                     ? filter_csv.format().bin_to_csv( &it->second[i][0], stdin_csv.delimiter )
-                                     : it->second[i] );
-                        if( swap_output ) { std::cout << stdin_csv.delimiter << comma::join( stdin_stream.ascii().last(), stdin_csv.delimiter ); }
-                        std::cout << std::endl;
-                    }
-                }
+                if( !output_matched( stdin_stream, it->first, it->second, is_state_machine ? &state : nullptr ) ) { return 1; }
                 if( first_matching ) { break; }
             }
             if( first_matching ) { filter_map.erase( pair.first, pair.second ); }
@@ -561,8 +822,9 @@ int main( int ac, char** av )
         options.assert_mutually_exclusive( "--radius,--epsilon,--first-matching" );
         options.assert_mutually_exclusive( "--radius,--epsilon,--string,-s,--double,--time" );
         options.assert_mutually_exclusive( "--matching,--not-matching", "--drop-id-fields,--drop-id" );
+        options.assert_mutually_exclusive( "--sorted,--partitions,--radius,--epsilon,--block-less" );
         stdin_csv = comma::csv::options( options );
-        std::vector< std::string > unnamed = options.unnamed( "--verbose,-v,--block-less,--first-matching,--matching,--not-matching,--string,-s,--time,--double,--strict,--swap-output,--swap,--output-swap,--nearest,--drop-id-fields,--drop-id", "-.*" );
+        std::vector< std::string > unnamed = options.unnamed( "--verbose,-v,--block-less,--sorted,--first-matching,--matching,--not-matching,--string,-s,--time,--double,--strict,--swap-output,--swap,--output-swap,--nearest,--drop-id-fields,--drop-id", "-.*" );
         if( unnamed.empty() ) { std::cerr << "csv-join: please specify the second source" << std::endl; return 1; }
         if( unnamed.size() > 1 ) { std::cerr << "csv-join: expected one file or stream to join, got " << comma::join( unnamed, ' ' ) << std::endl; return 1; }
         comma::name_value::parser parser( "filename", ';', '=', false );
@@ -65,6 +65,7 @@ static void bash_completion( unsigned const ac, char const* const* av )
         " --no-flush "
         " --paused-at-start --paused"
         " --resolution"
+        " --precise --spin"
         " --from --to"
         ;
     std::cout << completion_options << std::endl;
@@ -110,7 +111,13 @@ options
                            played without delay; the rationale is that microsleep used in csv-play
                            (boost::this_thread::sleep()) is essentially imprecise and may create
                            unnecessary delays in the data
-                           default 0.01
+                           default 0.01; with --precise: 0.0001
+    --precise: use precise scheduler (linux only): sleep until absolute deadlines on monotonic clock
+               (clock_nanosleep), then busy-wait for the last --spin seconds; records due within
+               --resolution after a release are released together without waiting; all the sources
+               are played on the same timeline; at exit, jitter statistics are output to stderr,
+               unless --quiet
+    --spin=<seconds>: with --precise, busy-wait that long before each deadline; default 0.0002
     --from <timestamp> : play back data starting at <timestamp> ( iso format )
     --to <timestamp> : play back data up to <timestamp> ( iso format )
 )" << std::endl;
@@ -298,12 +305,13 @@ int main( int argc, char** argv )
         if( options.exists( "--bash-completion" ) ) bash_completion( argc, argv );
         options.assert_mutually_exclusive( "--speed,--slow,--slowdown" );
         double speed = options.value( "--speed", 1.0 / options.value< double >( "--slow,--slowdown", 1.0 ) );
-        double resolution = options.value< double >( "--resolution", 0.01 );
+        comma::csv::impl::play::precise_t precise( options.exists( "--precise" ), boost::posix_time::microseconds( static_cast< long >( options.value< double >( "--spin", 0.0002 ) * 1000000 ) ) );
+        double resolution = options.value< double >( "--resolution", precise.enabled ? 0.0001 : 0.01 );
         std::string from = options.value< std::string>( "--from", "" );
         std::string to = options.value< std::string>( "--to", "" );
         bool quiet =  options.exists( "--quiet" );
         bool flush =  !options.exists( "--no-flush" );
-        std::vector< std::string > configstrings = options.unnamed( "--verbose,-v,--interactive,-i,--paused,--paused-at-start,--quiet,--flush,--no-flush","--pause-at,--slow,--slowdown,--speed,--resolution,--binary,--fields,--clients,--from,--to" );
+        std::vector< std::string > configstrings = options.unnamed( "--verbose,-v,--interactive,-i,--paused,--paused-at-start,--quiet,--flush,--no-flush,--precise","--pause-at,--slow,--slowdown,--speed,--resolution,--spin,--binary,--fields,--clients,--from,--to" );
         if( configstrings.empty() ) { configstrings.push_back( "-;-" ); }
         comma::csv::options csv( argc, argv );
         csv.full_xpath = false;
@@ -315,7 +323,7 @@ int main( int argc, char** argv )
         if( !from.empty() ) { fromtime = boost::posix_time::from_iso_string( from ); }
         boost::posix_time::ptime totime;
         if( !to.empty() ) { totime = boost::posix_time::from_iso_string( to ); }
-        multiplay.reset( new comma::csv::applications::play::Multiplay( source_configs, speed, quiet, boost::posix_time::microseconds( static_cast< unsigned int >( resolution * 1000000 )), fromtime, totime, flush ));
+        multiplay.reset( new comma::csv::applications::play::Multiplay( source_configs, speed, quiet, boost::posix_time::microseconds( static_cast< unsigned int >( resolution * 1000000 )), fromtime, totime, flush, precise ));
         if( options.exists( "--paused,--paused-at-start" )) { playback.pause(); }
         boost::optional< std::string > pause_at_option = options.optional< std::string >( "--pause-at" );
         boost::optional< boost::posix_time::ptime > pause_at_timestamp = boost::make_optional< boost::posix_time::ptime >( false, boost::posix_time::not_a_date_time );
@@ -333,6 +341,7 @@ int main( int argc, char** argv )
             playback.has_read_once();
         }
         multiplay->close();
+        if( precise.enabled && !quiet ) { multiplay->jitter().write( std::cerr ); }
         multiplay.reset();
         if( shutdown_flag ) { std::cerr << "csv-play: interrupted by signal" << std::endl; return -1; }
         return 0;
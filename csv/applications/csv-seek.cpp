@@ -2,15 +2,18 @@
 
 /// @author Aspen Eyers
 
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 #include <fstream>
 #include "../../application/command_line_options.h"
 #include "../../csv/traits.h"
 #include "../../name_value/parser.h"
+#include "../../string/split.h"
 #include "../../visiting/traits.h"
 #include "../../csv/stream.h"
 #include "../../csv/traits.h"
+#include "../../csv/impl/mapped_file.h"
 
 
 static void usage( bool verbose = false )
@@ -23,6 +26,13 @@ options
 
     --size,-s=<size>:      [todo] data is packets of fixed size, otherwise data is expected
                            line-wise. Alternatively use --binary
+fields
+    ratio:                 seek to given fraction of the file
+    index:                 seek to record of given index
+    key:                   binary-search the file sorted by its field named 'key' (see <stream> fields)
+                           and output the first record with key greater or equal to the given one;
+                           key can be a number or time; the file is memory-mapped, thus only
+                           the pages visited by the search are read
 csv options
 )";
     std::cerr << comma::csv::options::usage( verbose ) << std::endl;
@@ -38,6 +48,9 @@ csv options
             sample the 10th record
                 echo 10 | csv-seek "data.bin;binary=12f" | csv-from-bin f
 
+            find the first record at or after given time in a recording sorted by time
+                echo 20240101T120000 | csv-seek --fields=key "recording.bin;binary=t,3d;fields=key" | csv-from-bin t,3d
+
         colour hue (you would need snark installed with graphics and imaging enabled)
             make data file
                 ( csv-paste value=255 value=0 line-number --head 256; \
@@ -80,10 +93,18 @@ struct input_t
     std::uint64_t get_index( std::size_t filesize, std::size_t record_size, bool use_ratio ) const { return use_ratio ? static_cast<std::uint64_t>(filesize * ratio) : index*record_size; }
 };
 
+template < typename K > struct key_t { K key; };
+
 }} // namespace comma { namespace csv {
 
 namespace comma { namespace visiting {
 
+template < typename K > struct traits< comma::csv::key_t< K > >
+{
+    template < typename Key, typename V > static void visit( const Key&, comma::csv::key_t< K >& p, V& v ) { v.apply( "key", p.key ); }
+    template < typename Key, typename V > static void visit( const Key&, const comma::csv::key_t< K >& p, V& v ) { v.apply( "key", p.key ); }
+};
+
 template <> struct traits< comma::csv::config_t >
 {
     template < typename K, typename V > static void visit( const K&, comma::csv::config_t& p, V& v )
@@ -118,6 +139,39 @@ template <> struct traits< comma::csv::input_t >
 
 } } // namespace comma { namespace visiting {
 
+template < typename K > static int seek_key( const comma::csv::options& csv, const comma::csv::options& stream_csv, const std::string& filename, bool permissive )
+{
+    comma::csv::impl::mapped_file file( filename );
+    file.random();
+    std::size_t record_size = stream_csv.format().size();
+    std::size_t size = file.size() / record_size;
+    comma::csv::binary< comma::csv::key_t< K > > binary( stream_csv );
+    comma::csv::input_stream< comma::csv::key_t< K > > istream( std::cin, csv );
+    comma::csv::key_t< K > record;
+    while( std::cin.good() && !std::cin.eof() )
+    {
+        const comma::csv::key_t< K >* p = istream.read();
+        if( !p ) { break; }
+        std::size_t first = 0;
+        std::size_t count = size;
+        while( count > 0 ) // as std::lower_bound
+        {
+            std::size_t step = count / 2;
+            binary.get( record, file.data() + ( first + step ) * record_size );
+            if( record.key < p->key ) { first += step + 1; count -= step + 1; } else { count = step; }
+        }
+        if( first == size )
+        {
+            comma::saymore() << "key out of bounds" << std::endl;
+            if( permissive ) { continue; }
+            return 1;
+        }
+        std::cout.write( file.data() + first * record_size, record_size );
+        if( csv.flush ) { std::cout.flush(); }
+    }
+    return 0;
+}
+
 int main( int ac, char** av )
 {
     try
@@ -126,7 +180,7 @@ int main( int ac, char** av )
         std::vector< std::string > unnamed = options.unnamed( "--flush,-v,--verbose,--permissive,-p,--size", "-.*" );
         comma::csv::options csv( options, "index" );
         bool permissive = options.exists( "--permissive,-p" );
-        COMMA_ASSERT_BRIEF( csv.has_field( "ratio" ) != csv.has_field( "index" ), "please specify either 'ratio' or 'index' (but not both) in --fields" );
+        COMMA_ASSERT_BRIEF( int( csv.has_field( "ratio" ) ) + int( csv.has_field( "index" ) ) + int( csv.has_field( "key" ) ) == 1, "please specify one of 'ratio', 'index', or 'key' in --fields" );
 
         COMMA_ASSERT_BRIEF( unnamed.size() > 0, "expected file (or stream, todo)" );
         COMMA_ASSERT_BRIEF( unnamed.size() < 2, "Does not work on multiple streams (yet (shouuld it?))" );
@@ -137,6 +191,22 @@ int main( int ac, char** av )
         std::string filename = stream.filename;
         COMMA_ASSERT_BRIEF( filename!="-", "expected filename. file scrubbing does not work on streams." );
         COMMA_ASSERT_BRIEF( stream_csv.binary(), "expected binary file" );
+        if( csv.has_field( "key" ) )
+        {
+            COMMA_ASSERT_BRIEF( stream_csv.has_field( "key" ), "for key seeking, please specify sorted field as 'key' in stream fields, e.g. \"data.bin;binary=t,d;fields=key\"" );
+            const std::vector< std::string >& fields = comma::split( stream_csv.fields, ',' );
+            unsigned int i = std::find( fields.begin(), fields.end(), "key" ) - fields.begin();
+            switch( stream_csv.format().offset( i ).type )
+            {
+                case comma::csv::format::time:
+                case comma::csv::format::long_time:
+                    return seek_key< boost::posix_time::ptime >( csv, stream_csv, filename, permissive );
+                case comma::csv::format::fixed_string:
+                    COMMA_THROW_BRIEF( comma::exception, "key seeking on strings: not implemented" );
+                default:
+                    return seek_key< double >( csv, stream_csv, filename, permissive );
+            }
+        }
 
         std::ifstream file(filename, std::ios::binary | std::ios::ate);
         COMMA_ASSERT_BRIEF( file.is_open(), "unable to open file" );
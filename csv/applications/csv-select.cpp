@@ -2,23 +2,30 @@
 
 /// @author vsevolod vlaskine
 
+#ifndef WIN32
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <map>
-#include <sstream>
-#include <unordered_set>
+#include <memory>
 #include <vector>
 #include <boost/lexical_cast.hpp>
 #include <boost/optional.hpp>
 #include <boost/regex.hpp>
-#include <boost/scoped_ptr.hpp>
 #include "../../application/command_line_options.h"
 #include "../../base/exception.h"
-#include "../../csv/stream.h"
+#include "../../csv/format.h"
+#include "../../csv/options.h"
+#include "../../csv/impl/ascii_cast.h"
+#include "../../csv/impl/block_reader.h"
+#include "../../csv/impl/mapped_file.h"
+#include "../../csv/impl/tokenizer.h"
 #include "../../csv/impl/unstructured.h"
 #include "../../math/compare.h"
 #include "../../name_value/parser.h"
 #include "../../string/string.h"
-#include "../../visiting/traits.h"
 
 void usage( bool verbose )
 {
@@ -47,6 +54,10 @@ void usage( bool verbose )
     std::cerr << "              attention: this key is applied only to the common constraints, e.g. in the following example" << std::endl;
     std::cerr << "                         --sorted will be applied to the condition --less=2, but NOT to the condition \"x;less=1\"" << std::endl;
     std::cerr << "                         csv-select --less=2 --sorted --fields x \"x;less=1\"" << std::endl;
+    std::cerr << "              seeking: if stdin is a file (e.g. csv-select ... < data.bin) and sorted constraints have lower bounds" << std::endl;
+    std::cerr << "                       (from, greater, or equals), csv-select binary-searches the file for the first possibly matching" << std::endl;
+    std::cerr << "                       record instead of reading it from the start; ascii files are bisected by bytes" << std::endl;
+    std::cerr << "                       resynchronising on line breaks; not done with --output-all or --not-matching" << std::endl;
     std::cerr << "    --strict: if constraint field is not present among fields, exit with error (added for backward compatibility)" << std::endl;
     std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
     std::cerr << "    --or: uses 'or' expression instead of 'and' (default is 'and')" << std::endl;
@@ -59,6 +70,7 @@ void usage( bool verbose )
     std::cerr << "examples" << std::endl;
     std::cerr << "    cat a.csv | csv-select --fields=,,t --from=20120101T000000" << std::endl;
     std::cerr << "    cat a.csv | csv-select --fields=,,t --from=20120101T000000 --to=20120101T000010 --sorted" << std::endl;
+    std::cerr << "    csv-select --fields=t,,, --binary=t,3d --from=20120101T000000 --to=20120101T000010 --sorted < month.bin" << std::endl;
     std::cerr << "    cat xyz.csv | csv-select --fields=x,y,z \"x;from=1;to=2\" \"y;from=-1;to=1.1\" \"z;from=5;to=5.5\"" << std::endl;
     std::cerr << "    cat a.csv | csv-select --fields=t,scalar \"t;from=20120101T000000;sorted\" \"scalar;from=-10;to=20.5\"" << std::endl;
     std::cerr << "    echo hello,world | csv-select --fields=h,w \"h;regex=he.*\"" << std::endl;
@@ -66,9 +78,6 @@ void usage( bool verbose )
     exit( 0 );
 }
 
-bool matches( const std::string& value, const boost::regex& r ) { return boost::regex_match( value, r ); }
-template < typename T > bool matches( const T& value, const boost::regex& r ) { COMMA_THROW( comma::exception, "regex implemented only for strings" ); }
-
 template < typename T > static boost::optional< T > get_optional_( const comma::command_line_options& options, const std::string& what ) { return options.optional< T >( what ); }
 template <> boost::optional< boost::posix_time::ptime > get_optional_< boost::posix_time::ptime >( const comma::command_line_options& options, const std::string& what )
 {
@@ -125,27 +134,6 @@ struct constraints
             else if( v.first == "sorted" ) { sorted = true; }
         }
     }
-
-    bool is_a_match( const T& t ) const // quick and dirty, implement a proper expression parser
-    {
-        return    ( !equals || comma::math::equal( *equals, t ) )
-               && ( !not_equal || !comma::math::equal( *not_equal, t ) )
-               && ( !from || !comma::math::less( t, *from ) )
-               && ( !to || !comma::math::less( *to, t ) )
-               && ( !less || comma::math::less( t, *less ) )
-               && ( !greater || comma::math::less( *greater, t ) )
-               && ( !regex || matches( t, *regex ) );
-    }
-
-    bool done( const T& t ) const // quick and dirty
-    {
-        if( !sorted ) { return false; }
-        if( to && comma::math::less( *to, t ) ) { return true; }
-        if( less && !comma::math::less( t, *less ) ) { return true; }
-        if( equals && comma::math::less( *equals, t ) ) { return true; }
-        // todo: more?
-        return false;
-    }
 };
 
 static bool default_constraints_empty( const comma::command_line_options& options ) // quick and dirty
@@ -154,148 +142,480 @@ static bool default_constraints_empty( const comma::command_line_options& option
     return empty;
 }
 
-template < typename T >
-struct constrained
+/// constraints compiled once into a flat program of typed comparisons against constants
+///
+/// records are evaluated in batches column-wise: each constrained field is decoded once into
+/// a contiguous column, then each comparison is a tight loop over the column updating
+/// the selection mask, which the compiler can vectorise
+///
+/// semantics are the same as of the constraints: numbers are compared as doubles with
+/// comma::math::equal and comma::math::less, conditions of a constraint are and-ed,
+/// constraints are and-ed (or or-ed, if --or); sorted constraints are checked for
+/// the end of matching records only if they can possibly end it
+///
+/// sorted constraints also give the beginning of possibly matching records, i.e. records
+/// before it cannot match; since on sorted input this property changes only once, it can be
+/// binary-searched for in a seekable input instead of reading it from the start
+class program
 {
-    T value;
-    std::vector< ::constraints< T > > constraints;
+    public:
+        enum kinds { time_kind, double_kind, string_kind };
+
+        program( bool is_or ) : is_or_( is_or ) {}
+
+        template < typename T > void add( unsigned int index, const comma::csv::format::element& element, const std::vector< constraints< T > >& c );
+
+        /// decode batch of binary records
+        void decode( const char* records, std::size_t record_size, std::size_t size );
+
+        /// decode batch of ascii lines
+        void decode( const std::vector< std::string >& lines, std::size_t size, comma::csv::impl::tokenizer& tokenizer );
+
+        /// return index of the first record in decoded batch after which no record can match, i.e. batch size, if none
+        std::size_t end() const;
+
+        /// return true, if sorted constraints can tell that a record is before any possible match
+        bool may_begin() const { return may_begin_; }
+
+        /// return index of the first record in decoded batch that is not before any possible match, i.e. batch size, if none
+        std::size_t begin() const;
 
-    bool is_a_match( bool is_or = false ) const
+        /// calculate matches for the first size records of decoded batch
+        const std::vector< unsigned char >& match( std::size_t size );
+
+    private:
+        enum ops { equals, not_equal, less, greater, from, to, regex };
+        struct column
+        {
+            kinds kind;
+            unsigned int index;
+            comma::csv::format::element element;
+        };
+        struct condition
+        {
+            ops op;
+            std::size_t column;
+            double d;
+            boost::posix_time::ptime t;
+            std::string s;
+            boost::regex r;
+            bool negated;
+            condition( ops op, std::size_t column, bool negated = false ) : op( op ), column( column ), d( 0 ), negated( negated ) {}
+            void set( double v ) { d = v; }
+            void set( const boost::posix_time::ptime& v ) { t = v; }
+            void set( const std::string& v ) { s = v; }
+        };
+        struct set
+        {
+            std::vector< condition > conditions;
+            std::vector< condition > done; // any of them true means no more matches, if sorted
+            std::vector< condition > before; // any of them true means no matches yet, if sorted
+        };
+        struct field { std::vector< set > sets; };
+        bool is_or_;
+        bool may_end_{false};
+        bool may_begin_{false};
+        std::vector< column > columns_;
+        std::vector< field > fields_;
+        std::vector< std::vector< double > > doubles_;
+        std::vector< std::vector< boost::posix_time::ptime > > times_;
+        std::vector< std::vector< std::string > > strings_;
+        std::vector< unsigned char > mask_;
+        std::vector< unsigned char > set_mask_;
+        std::size_t size_{0};
+
+        void resize_( std::size_t size );
+        bool test_( const condition& c, std::size_t i ) const;
+        void apply_( const condition& c, unsigned char* mask, std::size_t begin, std::size_t size ) const;
+        template < typename T, typename F > static void apply_( const T* v, unsigned char* mask, std::size_t size, F f ) { for( std::size_t i = 0; i < size; ++i ) { mask[i] &= f( v[i] ); } }
+        template < typename T > static void decode_( const char* records, std::size_t record_size, std::size_t size, double* v ) { for( std::size_t i = 0; i < size; ++i ) { v[i] = comma::csv::format::traits< T >::from_bin( records + i * record_size ); } }
+        template < typename T > void add_( std::vector< condition >& conditions, ops op, std::size_t column, const boost::optional< T >& value, bool negated = false );
+};
+
+template < typename T > inline void program::add_( std::vector< condition >& conditions, ops op, std::size_t column, const boost::optional< T >& value, bool negated )
+{
+    if( !value ) { return; }
+    conditions.push_back( condition( op, column, negated ) );
+    conditions.back().set( *value );
+}
+
+template < typename T > inline void program::add( unsigned int index, const comma::csv::format::element& element, const std::vector< constraints< T > >& c )
+{
+    column k;
+    k.kind = element.type == comma::csv::format::time || element.type == comma::csv::format::long_time ? time_kind : element.type == comma::csv::format::fixed_string ? string_kind : double_kind;
+    k.index = index;
+    k.element = element;
+    std::size_t n = columns_.size();
+    columns_.push_back( k );
+    doubles_.resize( columns_.size() );
+    times_.resize( columns_.size() );
+    strings_.resize( columns_.size() );
+    field f;
+    for( const auto& e: c )
     {
-        if( is_or )
+        set s;
+        add_( s.conditions, equals, n, e.equals );
+        add_( s.conditions, not_equal, n, e.not_equal );
+        add_( s.conditions, from, n, e.from );
+        add_( s.conditions, to, n, e.to );
+        add_( s.conditions, less, n, e.less );
+        add_( s.conditions, greater, n, e.greater );
+        if( e.regex )
         {
-            for( unsigned int i = 0; i < constraints.size(); ++i ) { if( this->constraints[i].is_a_match( value ) ) { return true; } }
-            return false;
+            if( k.kind != string_kind ) { COMMA_THROW( comma::exception, "regex implemented only for strings" ); }
+            s.conditions.push_back( condition( regex, n ) );
+            s.conditions.back().r = *e.regex;
         }
-        for( unsigned int i = 0; i < constraints.size(); ++i ) { if( !this->constraints[i].is_a_match( value ) ) { return false; } }
-        return true;
+        if( e.sorted )
+        {
+            add_( s.done, to, n, e.to, true ); // to < value
+            add_( s.done, less, n, e.less, true ); // value >= less
+            add_( s.done, greater, n, e.equals ); // equals < value
+            add_( s.before, from, n, e.from, true ); // value < from
+            add_( s.before, greater, n, e.greater, true ); // value <= greater
+            add_( s.before, less, n, e.equals ); // value < equals
+        }
+        f.sets.push_back( s );
+    }
+    fields_.push_back( f );
+    may_end_ = is_or_;
+    for( const auto& f: fields_ ) // see end()
+    {
+        bool all = !f.sets.empty();
+        bool any = false;
+        for( const auto& s: f.sets ) { all = all && !s.done.empty(); any = any || !s.done.empty(); }
+        if( is_or_ ) { may_end_ = may_end_ && any; } else { may_end_ = may_end_ || all; }
+    }
+    may_begin_ = is_or_;
+    for( const auto& f: fields_ ) // see begin()
+    {
+        for( const auto& s: f.sets ) { if( is_or_ ) { may_begin_ = may_begin_ && !s.before.empty(); } else { may_begin_ = may_begin_ || !s.before.empty(); } }
     }
+}
 
-    bool done( bool is_or = false ) const
+inline void program::resize_( std::size_t size )
+{
+    size_ = size;
+    for( std::size_t c = 0; c < columns_.size(); ++c )
     {
-        if( constraints.empty() ) { return false; }
-        if( is_or )
+        switch( columns_[c].kind )
         {
-            for( unsigned int i = 0; i < constraints.size(); ++i ) { if( this->constraints[i].done( value ) ) { return true; } }
-            return false;
+            case time_kind: if( times_[c].size() < size ) { times_[c].resize( size ); } break;
+            case double_kind: if( doubles_[c].size() < size ) { doubles_[c].resize( size ); } break;
+            case string_kind: if( strings_[c].size() < size ) { strings_[c].resize( size ); } break;
         }
-        for( unsigned int i = 0; i < constraints.size(); ++i ) { if( !this->constraints[i].done( value ) ) { return false; } }
-        return true;
     }
-};
+}
 
-struct input_t
+inline void program::decode( const char* records, std::size_t record_size, std::size_t size )
 {
-    std::vector< constrained< boost::posix_time::ptime > > time;
-    std::vector< constrained< double > > doubles;
-    std::vector< constrained< std::string > > strings;
-
-    bool is_a_match( bool is_or ) const
+    resize_( size );
+    for( std::size_t c = 0; c < columns_.size(); ++c )
     {
-        if( is_or )
+        const comma::csv::format::element& e = columns_[c].element;
+        const char* p = records + e.offset;
+        switch( e.type )
         {
-            for( unsigned int i = 0; i < time.size(); ++i ) { if( time[i].is_a_match( is_or ) ) { return true; } }
-            for( unsigned int i = 0; i < doubles.size(); ++i ) { if( doubles[i].is_a_match( is_or ) ) { return true; } }
-            for( unsigned int i = 0; i < strings.size(); ++i ) { if( strings[i].is_a_match( is_or ) ) { return true; } }
-            return false;
+            case comma::csv::format::char_t: decode_< char >( p, record_size, size, &doubles_[c][0] ); break;
+            case comma::csv::format::int8: decode_< char >( p, record_size, size, &doubles_[c][0] ); break;
+            case comma::csv::format::uint8: decode_< unsigned char >( p, record_size, size, &doubles_[c][0] ); break;
+            case comma::csv::format::int16: decode_< comma::int16 >( p, record_size, size, &doubles_[c][0] ); break;
+            case comma::csv::format::uint16: decode_< comma::uint16 >( p, record_size, size, &doubles_[c][0] ); break;
+            case comma::csv::format::int32: decode_< comma::int32 >( p, record_size, size, &doubles_[c][0] ); break;
+            case comma::csv::format::uint32: decode_< comma::uint32 >( p, record_size, size, &doubles_[c][0] ); break;
+            case comma::csv::format::int64: decode_< comma::int64 >( p, record_size, size, &doubles_[c][0] ); break;
+            case comma::csv::format::uint64: decode_< comma::uint64 >( p, record_size, size, &doubles_[c][0] ); break;
+            case comma::csv::format::float_t: decode_< float >( p, record_size, size, &doubles_[c][0] ); break;
+            case comma::csv::format::double_t: decode_< double >( p, record_size, size, &doubles_[c][0] ); break;
+            case comma::csv::format::time: for( std::size_t i = 0; i < size; ++i ) { times_[c][i] = comma::csv::format::traits< boost::posix_time::ptime >::from_bin( p + i * record_size ); } break;
+            case comma::csv::format::long_time: for( std::size_t i = 0; i < size; ++i ) { times_[c][i] = comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::long_time >::from_bin( p + i * record_size ); } break;
+            case comma::csv::format::fixed_string: for( std::size_t i = 0; i < size; ++i ) { strings_[c][i] = comma::csv::format::traits< std::string >::from_bin( p + i * record_size, e.size ); } break;
         }
-        else
+    }
+}
+
+inline void program::decode( const std::vector< std::string >& lines, std::size_t size, comma::csv::impl::tokenizer& tokenizer )
+{
+    resize_( size );
+    for( std::size_t i = 0; i < size; ++i )
+    {
+        const std::vector< comma::csv::impl::tokenizer::span >& spans = tokenizer.split( lines[i] );
+        for( std::size_t c = 0; c < columns_.size(); ++c )
         {
-            for( unsigned int i = 0; i < time.size(); ++i ) { if( !time[i].is_a_match() ) { return false; } }
-            for( unsigned int i = 0; i < doubles.size(); ++i ) { if( !doubles[i].is_a_match() ) { return false; } }
-            for( unsigned int i = 0; i < strings.size(); ++i ) { if( !strings[i].is_a_match() ) { return false; } }
-            return true;
+            if( columns_[c].index >= spans.size() ) { COMMA_THROW( comma::exception, "got column index " << columns_[c].index << ", for " << spans.size() << " column(s) in line: \"" << lines[i] << "\"" ); }
+            const comma::csv::impl::tokenizer::span& s = spans[ columns_[c].index ];
+            switch( columns_[c].kind ) // as in comma::csv::impl::from_ascii_
+            {
+                case double_kind:
+                    doubles_[c][i] = 0;
+                    if( !s.empty() ) { comma::csv::impl::ascii_cast< double >::from( doubles_[c][i], s.data, s.data + s.size ); }
+                    break;
+                case time_kind:
+                    times_[c][i] = boost::posix_time::not_a_date_time;
+                    if( s.empty() ) { break; }
+                    try { comma::csv::impl::ascii_cast< boost::posix_time::ptime >::from( times_[c][i], s.data, s.data + s.size ); }
+                    catch( ... )
+                    {
+                        const std::string& v = s.string();
+                        times_[c][i] = v == "+infinity" || v == "+inf" || v == "inf" ? boost::posix_time::pos_infin
+                                     : v == "-infinity" || v == "-inf" ? boost::posix_time::neg_infin
+                                     : boost::posix_time::not_a_date_time;
+                    }
+                    break;
+                case string_kind:
+                    strings_[c][i] = comma::strip( s.string(), "\"" );
+                    break;
+            }
         }
     }
+}
+
+inline bool program::test_( const condition& c, std::size_t i ) const
+{
+    unsigned char m = 1;
+    apply_( c, &m, i, 1 );
+    return c.negated ? !m : m;
+}
 
-    bool done( bool is_or ) const
+inline void program::apply_( const condition& c, unsigned char* mask, std::size_t begin, std::size_t size ) const
+{
+    switch( columns_[ c.column ].kind )
     {
-        if( is_or )
+        case double_kind:
+        {
+            const double* v = &doubles_[ c.column ][0] + begin;
+            double d = c.d;
+            switch( c.op )
+            {
+                case equals: apply_( v, mask, size, [d]( double v ) { return comma::math::equal( d, v ); } ); break;
+                case not_equal: apply_( v, mask, size, [d]( double v ) { return !comma::math::equal( d, v ); } ); break;
+                case from: apply_( v, mask, size, [d]( double v ) { return !comma::math::less( v, d ); } ); break;
+                case to: apply_( v, mask, size, [d]( double v ) { return !comma::math::less( d, v ); } ); break;
+                case less: apply_( v, mask, size, [d]( double v ) { return comma::math::less( v, d ); } ); break;
+                case greater: apply_( v, mask, size, [d]( double v ) { return comma::math::less( d, v ); } ); break;
+                case regex: break;
+            }
+            break;
+        }
+        case time_kind:
         {
-            for( unsigned int i = 0; i < time.size(); ++i ) { if( !time[i].done( is_or ) ) { return false; } }
-            for( unsigned int i = 0; i < doubles.size(); ++i ) { if( !doubles[i].done( is_or ) ) { return false; } }
-            for( unsigned int i = 0; i < strings.size(); ++i ) { if( !strings[i].done( is_or ) ) { return false; } }
-            return true;
+            const boost::posix_time::ptime* v = &times_[ c.column ][0] + begin;
+            const boost::posix_time::ptime& t = c.t;
+            switch( c.op )
+            {
+                case equals: apply_( v, mask, size, [&]( const boost::posix_time::ptime& v ) { return t == v; } ); break;
+                case not_equal: apply_( v, mask, size, [&]( const boost::posix_time::ptime& v ) { return !( t == v ); } ); break;
+                case from: apply_( v, mask, size, [&]( const boost::posix_time::ptime& v ) { return !( v < t ); } ); break;
+                case to: apply_( v, mask, size, [&]( const boost::posix_time::ptime& v ) { return !( t < v ); } ); break;
+                case less: apply_( v, mask, size, [&]( const boost::posix_time::ptime& v ) { return v < t; } ); break;
+                case greater: apply_( v, mask, size, [&]( const boost::posix_time::ptime& v ) { return t < v; } ); break;
+                case regex: break;
+            }
+            break;
         }
-        else
+        case string_kind:
         {
-            for( unsigned int i = 0; i < time.size(); ++i ) { if( time[i].done() ) { return true; } }
-            for( unsigned int i = 0; i < doubles.size(); ++i ) { if( doubles[i].done() ) { return true; } }
-            for( unsigned int i = 0; i < strings.size(); ++i ) { if( strings[i].done() ) { return true; } }
-            return false;
+            const std::string* v = &strings_[ c.column ][0] + begin;
+            const std::string& s = c.s;
+            switch( c.op )
+            {
+                case equals: apply_( v, mask, size, [&]( const std::string& v ) { return s == v; } ); break;
+                case not_equal: apply_( v, mask, size, [&]( const std::string& v ) { return s != v; } ); break;
+                case from: apply_( v, mask, size, [&]( const std::string& v ) { return !( v < s ); } ); break;
+                case to: apply_( v, mask, size, [&]( const std::string& v ) { return !( s < v ); } ); break;
+                case less: apply_( v, mask, size, [&]( const std::string& v ) { return v < s; } ); break;
+                case greater: apply_( v, mask, size, [&]( const std::string& v ) { return s < v; } ); break;
+                case regex: apply_( v, mask, size, [&]( const std::string& v ) { return boost::regex_match( v, c.r ); } ); break;
+            }
+            break;
         }
     }
-};
-
-namespace comma { namespace visiting {
+}
 
-template < typename T > struct traits< constrained< T > >
+inline std::size_t program::end() const
 {
-    template < typename K, typename V > static void visit( const K&, const constrained< T >& p, V& v ) { v.apply( "value", p.value ); }
-    template < typename K, typename V > static void visit( const K&, constrained< T >& p, V& v ) { v.apply( "value", p.value ); }
-};
+    if( !may_end_ ) { return size_; }
+    for( std::size_t i = 0; i < size_; ++i )
+    {
+        bool done = is_or_;
+        for( const auto& f: fields_ ) // if or: all fields done; otherwise: any field done
+        {
+            bool any = false; // any set done
+            bool all = true; // all sets done
+            for( const auto& s: f.sets )
+            {
+                bool d = false;
+                for( const auto& c: s.done ) { if( test_( c, i ) ) { d = true; break; } }
+                any = any || d;
+                all = all && d;
+            }
+            if( is_or_ ) { if( !any ) { done = false; break; } }
+            else if( all ) { done = true; break; }
+        }
+        if( done ) { return i; }
+    }
+    return size_;
+}
 
-template <> struct traits< input_t >
+inline std::size_t program::begin() const
 {
-    template < typename K, typename V > static void visit( const K&, const input_t& p, V& v )
+    if( !may_begin_ ) { return 0; }
+    for( std::size_t i = 0; i < size_; ++i )
     {
-        v.apply( "t", p.time );
-        v.apply( "doubles", p.doubles );
-        v.apply( "strings", p.strings );
+        bool before = is_or_; // if or: all sets before; otherwise: any set before, since all conditions are and-ed
+        for( const auto& f: fields_ )
+        {
+            for( const auto& s: f.sets )
+            {
+                bool b = false;
+                for( const auto& c: s.before ) { if( test_( c, i ) ) { b = true; break; } }
+                if( is_or_ ) { before = before && b; } else { before = before || b; }
+            }
+        }
+        if( !before ) { return i; }
     }
+    return size_;
+}
 
-    template < typename K, typename V > static void visit( const K&, input_t& p, V& v )
+inline const std::vector< unsigned char >& program::match( std::size_t size )
+{
+    if( size == 0 ) { return mask_; }
+    if( mask_.size() < size ) { mask_.resize( size ); set_mask_.resize( size ); }
+    std::fill( mask_.begin(), mask_.begin() + size, is_or_ ? 0 : 1 );
+    for( const auto& f: fields_ )
     {
-        v.apply( "t", p.time );
-        v.apply( "doubles", p.doubles );
-        v.apply( "strings", p.strings );
+        for( const auto& s: f.sets )
+        {
+            if( !is_or_ ) { for( const auto& c: s.conditions ) { apply_( c, &mask_[0], 0, size ); } continue; }
+            std::fill( set_mask_.begin(), set_mask_.begin() + size, 1 );
+            for( const auto& c: s.conditions ) { apply_( c, &set_mask_[0], 0, size ); }
+            for( std::size_t i = 0; i < size; ++i ) { mask_[i] |= set_mask_[i]; }
+        }
     }
-};
-
-} } // namespace comma { namespace visiting {
+    return mask_;
+}
 
 static comma::csv::options csv;
-static input_t input;
 static std::vector< std::string > fields;
 typedef std::multimap< std::string, std::string > constraints_map_t;
 static constraints_map_t constraints_map;
 
-template < typename T > static constrained< T > make_value( unsigned int i, const comma::command_line_options& options )
+template < typename T > static std::vector< constraints< T > > make_constraints( unsigned int i, const comma::command_line_options& options )
 {
-    constrained< T > v;
-    for( auto r = constraints_map.equal_range( fields[i] ); r.first != r.second; ++r.first ) { v.constraints.push_back( constraints< T >( r.first->second ) ); }
+    std::vector< constraints< T > > v;
+    for( auto r = constraints_map.equal_range( fields[i] ); r.first != r.second; ++r.first ) { v.push_back( constraints< T >( r.first->second ) ); }
     static constraints< T > common_constraints( options ); // quick and dirty
-    if( !common_constraints.empty() ) { v.constraints.push_back( common_constraints ); }
+    if( !common_constraints.empty() ) { v.push_back( common_constraints ); }
     return v;
 }
 
-static void init_input( const comma::csv::format& format, const comma::command_line_options& options )
+static void compile( program& p, const comma::csv::format& format, const comma::command_line_options& options )
 {
     if( fields.empty() ) { for( unsigned int i = 0; i < format.count(); ++i ) { fields.push_back( "v" ); } }
     for( unsigned int i = 0; i < fields.size(); ++i )
     {
         if( comma::strip( fields[i], ' ' ).empty() ) { continue; }
         if( default_constraints_empty( options ) && constraints_map.find( fields[i] ) == constraints_map.end() ) { continue; }
-        switch( format.offset( i ).type )
+        const comma::csv::format::element& e = format.offset( i );
+        switch( e.type )
         {
             case comma::csv::format::time:
             case comma::csv::format::long_time:
-                input.time.push_back( make_value< boost::posix_time::ptime >( i, options ) );
-                fields[i] = "t[" + boost::lexical_cast< std::string >( input.time.size() - 1 ) + "]/value";
+                p.add( i, e, make_constraints< boost::posix_time::ptime >( i, options ) );
                 break;
             case comma::csv::format::fixed_string:
-                input.strings.push_back( make_value< std::string >( i, options ) );
-                fields[i] = "strings[" + boost::lexical_cast< std::string >( input.strings.size() - 1 ) + "]/value";
+                p.add( i, e, make_constraints< std::string >( i, options ) );
                 break;
             default:
-                input.doubles.push_back( make_value< double >( i, options ) );
-                fields[i] = "doubles[" + boost::lexical_cast< std::string >( input.doubles.size() - 1 ) + "]/value";
+                p.add( i, e, make_constraints< double >( i, options ) );
                 break;
         }
     }
-    csv.fields = comma::join( fields, ',' );
 }
 
+/// stdin as a regular file (e.g. csv-select ... < data.bin) mapped to memory for seeking
+struct seekable_input
+{
+    std::unique_ptr< comma::csv::impl::mapped_file > file;
+    std::size_t offset{0}; // current position of stdin in file
+
+    seekable_input( bool enabled )
+    {
+        #ifndef WIN32
+        if( !enabled || !comma::csv::impl::mapped_file::mappable( 0 ) ) { return; }
+        offset = ::lseek( 0, 0, SEEK_CUR );
+        file.reset( new comma::csv::impl::mapped_file( 0 ) );
+        if( file->size() == 0 || offset > file->size() ) { file.reset(); return; } // size 0: e.g. empty or not telling its size (as files in /proc), read as a stream
+        file->random();
+        #endif
+    }
+
+    operator bool() const { return bool( file ); }
+
+    /// move stdin to given offset; nothing must have been read from std::cin yet
+    void seek( std::size_t offset ) const
+    {
+        #ifndef WIN32
+        if( ::lseek( 0, offset, SEEK_SET ) < 0 ) { COMMA_THROW( comma::exception, "failed to seek stdin to " << offset ); }
+        #endif
+    }
+
+    /// return offset of the first record from the current position that is not before any possible match, binary-searching fixed-size records
+    std::size_t search( program& p, std::size_t record_size ) const
+    {
+        std::size_t first = 0;
+        std::size_t count = ( file->size() - offset ) / record_size;
+        while( count > 0 ) // as std::lower_bound
+        {
+            std::size_t step = count / 2;
+            p.decode( file->data() + offset + ( first + step ) * record_size, record_size, 1 );
+            if( p.begin() == 0 ) { count = step; } else { first += step + 1; count -= step + 1; }
+        }
+        return offset + first * record_size;
+    }
+
+    /// return offset of a line from the current position such that no line before it can match, bisecting by bytes and resynchronising on line breaks
+    std::size_t search( program& p, comma::csv::impl::tokenizer& tokenizer ) const
+    {
+        std::size_t begin = offset;
+        std::size_t end = file->size();
+        std::vector< std::string > lines( 1 );
+        while( begin < end ) // invariant: begin is the beginning of a line, no line before begin can match, a line at end or before it is not before any possible match
+        {
+            std::size_t next = line( begin + ( end - begin ) / 2, lines[0] );
+            if( next >= end ) { break; } // too close: no line between, will be read anyway
+            std::size_t after = next;
+            while( lines[0].empty() && after < end ) { after = line( after + 1, lines[0] ); } // skip empty lines
+            if( lines[0].empty() || after >= end ) { break; }
+            p.decode( lines, 1, tokenizer );
+            if( p.begin() == 0 ) { end = after; continue; }
+            const char* n = static_cast< const char* >( std::memchr( file->data() + after, '\n', file->size() - after ) );
+            if( !n ) { return file->size(); } // last line and it is before
+            begin = n - file->data() + 1;
+        }
+        return begin;
+    }
+
+    /// get the first line beginning at or after offset, with windows line ending stripped; return its offset, file size, if none
+    std::size_t line( std::size_t o, std::string& s ) const
+    {
+        s.clear();
+        const char* data = file->data();
+        std::size_t size = file->size();
+        if( o > offset ) // find the beginning of a line
+        {
+            const char* n = static_cast< const char* >( std::memchr( data + o - 1, '\n', size - o + 1 ) );
+            if( !n ) { return size; }
+            o = n - data + 1;
+        }
+        if( o >= size ) { return size; }
+        const char* n = static_cast< const char* >( std::memchr( data + o, '\n', size - o ) );
+        s.assign( data + o, n ? n : data + size );
+        if( !s.empty() && s.back() == '\r' ) { s.pop_back(); } // windows... sigh...
+        return o;
+    }
+};
+
 int main( int ac, char** av )
 {
     try
@@ -305,13 +625,14 @@ int main( int ac, char** av )
         csv = comma::csv::options( options );
         fields = comma::split( csv.fields, ',' );
         if( fields.size() == 1 && fields[0].empty() ) { fields.clear(); }
-        std::vector< std::string > unnamed = options.unnamed( "--first-matching,--or,--sorted,--input-sorted,--not-matching,--output-all,--all,--strict,--verbose,-v,--flush"
+        std::vector< std::string > unnamed = options.unnamed( "--first-matching,--or,--sorted,--input-sorted,--not-matching,--output-all,--all,--strict,--verbose,-v,--flush,--mmap"
                                                             , "--equals,--not-equal,--less,--greater,--from,--greater-or-equal,--ge,--to,--less-or-equal,--le,--regex,--fields,-f,--binary,-b,--format,--delimiter,-d,--precision" );
         //for( unsigned int i = 0; i < unnamed.size(); constraints_map.insert( std::make_pair( comma::split( unnamed[i], ';' )[0], unnamed[i] ) ), ++i );
         bool strict = options.exists( "--strict" );
         bool first_matching = options.exists( "--first-matching" );
         bool not_matching = options.exists( "--not-matching" );
         bool all = options.exists( "--output-all,--all" );
+        bool verbose = options.exists( "--verbose,-v" );
         for( unsigned int i = 0; i < unnamed.size(); ++i )
         {
             std::string field = comma::split( unnamed[i], ';' )[0];
@@ -321,68 +642,103 @@ int main( int ac, char** av )
             if( strict ) { std::cerr << "csv-select: on constraint: \"" << unnamed[i] << "\" field \"" << field << "\" not found in fields: " << csv.fields << std::endl; return 1; }
             std::cerr << "csv-select: warning: on constraint: \"" << unnamed[i] << "\" field \"" << field << "\" not found in fields: " << csv.fields << std::endl;
         }
+        if( !csv.flush ) { std::cin.tie( NULL ); std::ios_base::sync_with_stdio( false ); } // to read and write in batches
+        program p( is_or );
         if( csv.binary() )
         {
             #ifdef WIN32
             _setmode( _fileno( stdout ), _O_BINARY );
             #endif
-            init_input( csv.format(), options );
-            comma::csv::binary_input_stream< input_t > istream( std::cin, csv, input );
-            while( istream.ready() || ( std::cin.good() && !std::cin.eof() ) )
+            compile( p, csv.format(), options );
+            seekable_input seekable( p.may_begin() && !all && !not_matching );
+            if( seekable )
             {
-                const input_t* p = istream.read();
-                if( !p || p->done( is_or ) ) { break; }
-                char match = ( p->is_a_match( is_or ) == !not_matching ) ? 1 : 0;
-                if( match || all )
+                std::size_t offset = seekable.search( p, csv.format().size() );
+                if( verbose ) { std::cerr << "csv-select: sorted input: skipped " << ( offset - seekable.offset ) / csv.format().size() << " record(s)" << std::endl; }
+                seekable.seek( offset );
+            }
+            comma::csv::impl::block_reader reader( std::cin, csv.format().size(), 0, csv.mmap );
+            bool done = false;
+            while( !done && reader.read() > 0 )
+            {
+                p.decode( reader.record( 0 ), reader.record_size(), reader.size() );
+                std::size_t end = p.end();
+                done = end < reader.size();
+                const std::vector< unsigned char >& matches = p.match( end );
+                for( std::size_t i = 0; i < end; ++i )
                 {
-                    std::cout.write( istream.last(), csv.format().size() );
+                    char match = ( bool( matches[i] ) == !not_matching ) ? 1 : 0;
+                    if( !match && !all ) { continue; }
+                    std::cout.write( reader.record( i ), reader.record_size() );
                     if( all ) { std::cout.write( &match, 1 ); }
                     if( csv.flush ) { std::cout.flush(); }
-                    if( first_matching ) { break; }
+                    if( first_matching ) { done = true; break; }
                 }
+                std::cout.flush();
+            }
+            return 0;
+        }
+        std::vector< std::string > lines( 1 );
+        auto read_first_line = [&]() -> bool
+        {
+            for( lines[0].clear(); lines[0].empty() && std::cin.good() && !std::cin.eof(); )
+            {
+                std::getline( std::cin, lines[0] );
+                if( !lines[0].empty() && lines[0].back() == '\r' ) { lines[0].pop_back(); } // windows... sigh...
             }
+            return !lines[0].empty();
+        };
+        bool has_format = options.exists( "--format" );
+        comma::csv::format format;
+        if( has_format ) { format = comma::csv::format( options.value< std::string >( "--format" ) ); compile( p, format, options ); }
+        seekable_input seekable( !all && !not_matching && ( !has_format || p.may_begin() ) ); // without --format, map anyway to peek the first line for guessing the format
+        if( seekable ) { for( std::size_t o = seekable.line( seekable.offset, lines[0] ); lines[0].empty() && o < seekable.file->size(); o = seekable.line( o + 1, lines[0] ) ); }
+        else if( !read_first_line() ) { return 0; }
+        if( lines[0].empty() ) { return 0; }
+        if( !has_format )
+        {
+            format = comma::csv::impl::unstructured::guess_format( lines[0] );
+            std::cerr << "csv-select: guessed format from the first input line: " << format.string() << "; if you think the guess is wrong, please specify --format" << std::endl;
+            compile( p, format, options );
+            if( seekable && !p.may_begin() ) { seekable.file.reset(); if( !read_first_line() ) { return 0; } } // no sorted bounds: nothing to seek, read as a stream
         }
-        else
+        comma::csv::impl::tokenizer tokenizer( csv.delimiter, csv.quote );
+        if( seekable )
         {
-            std::string line;
-            while( std::cin.good() && !std::cin.eof() )
+            std::size_t offset = seekable.search( p, tokenizer );
+            if( verbose ) { std::cerr << "csv-select: sorted input: skipped " << ( offset - seekable.offset ) << " byte(s)" << std::endl; }
+            seekable.seek( offset );
+            if( !read_first_line() ) { return 0; }
+        }
+        lines.resize( 1024 );
+        std::size_t size = 1;
+        while( size > 0 )
+        {
+            while( size < lines.size() && std::cin.rdbuf()->in_avail() > 0 && std::cin.good() && !std::cin.eof() ) // batch lines already available, thus not delaying output
             {
-                std::getline( std::cin, line );
-                line = comma::strip( line, '\r' ); // windows, sigh...
-                if( !line.empty() ) { break; }
+                std::getline( std::cin, lines[size] );
+                if( !lines[size].empty() && lines[size].back() == '\r' ) { lines[size].pop_back(); } // windows... sigh...
+                if( !lines[size].empty() ) { ++size; }
             }
-            if( line.empty() ) { return 0; }
-            comma::csv::format format = options.exists( "--format" )
-                                      ? comma::csv::format( options.value< std::string >( "--format" ) )
-                                      : comma::csv::impl::unstructured::guess_format( line );
-            if( !options.exists( "--format" ) ) { std::cerr << "csv-select: guessed format from the first input line: " << format.string() << "; if you think the guess is wrong, please specify --format" << std::endl; }
-            init_input( format, options );
-            comma::csv::ascii_input_stream< input_t > istream( std::cin, csv, input );
-            // todo: quick and dirty: no time to debug why the commented section does not work (but that's the right way)
-            std::istringstream iss( line );
-            comma::csv::ascii_input_stream< input_t > isstream( iss, csv, input );
-            const input_t* p = isstream.read();
-            if( !p || p->done( is_or ) ) { return 0; }
-            bool match = p->is_a_match( is_or ) == !not_matching;
-            if( match || all )
+            p.decode( lines, size, tokenizer );
+            std::size_t end = p.end();
+            const std::vector< unsigned char >& matches = p.match( end );
+            for( std::size_t i = 0; i < end; ++i )
             {
-                std::cout << line;
+                bool match = bool( matches[i] ) == !not_matching;
+                if( !match && !all ) { continue; }
+                std::cout << lines[i];
                 if( all ) { std::cout << csv.delimiter << match; }
-                std::cout << std::endl;
+                std::cout << '\n';
                 if( first_matching ) { return 0; }
             }
-            while( istream.ready() || ( std::cin.good() && !std::cin.eof() ) )
+            std::cout.flush();
+            if( end < size ) { return 0; }
+            for( size = 0; size == 0 && std::cin.good() && !std::cin.eof(); )
             {
-                const input_t* p = istream.read();
-                if( !p || p->done( is_or ) ) { break; }
-                bool match = p->is_a_match( is_or ) == !not_matching;
-                if( match || all )
-                {
-                    std::cout << comma::join( istream.last(), csv.delimiter );
-                    if( all ) { std::cout << csv.delimiter << match; }
-                    std::cout << std::endl;
-                    if( first_matching ) { return 0; }
-                }
+                std::getline( std::cin, lines[0] );
+                if( !lines[0].empty() && lines[0].back() == '\r' ) { lines[0].pop_back(); } // windows... sigh...
+                if( !lines[0].empty() ) { size = 1; }
             }
         }
         return 0;
@@ -12,6 +12,8 @@
 #include <vector>
 #include "../../application/command_line_options.h"
 #include "../../base/exception.h"
+#include "../../csv/impl/block_reader.h"
+#include "../../csv/impl/gather.h"
 #include "../../csv/options.h"
 #include "../../string/string.h"
 
@@ -73,26 +75,20 @@ int main( int ac, char** av )
         };
         if( csv.binary() )
         {
-            std::vector< std::pair< unsigned int, unsigned int > > offsets;
-            for( unsigned int i = 0; i < output_fields.size(); )
-            {
-                unsigned int j = find_( output_fields[i] );
-                offsets.push_back( std::make_pair( csv.format().offset( j ).offset, 0 ) );
-                for( ; i < output_fields.size() && j < input_fields.size() && input_fields[j] == output_fields[i]; ++i, ++j ) { offsets.back().second += csv.format().offset( j ).size; }
-            }
+            comma::csv::impl::gather gather;
+            for( const auto& field: output_fields ) { const auto& e = csv.format().offset( find_( field ) ); gather.add( e.offset, e.size ); }
             #ifdef WIN32
             _setmode( _fileno( stdin ), _O_BINARY );
             _setmode( _fileno( stdout ), _O_BINARY );
             #endif
-            std::vector< char > buf( csv.format().size() );
+            comma::csv::impl::block_reader reader( std::cin, csv.format().size(), 0, csv.mmap );
             if( !csv.flush ) { std::cin.tie( NULL ); } // quick and dirty; std::cin is tied to std::cout by default, which is thread-unsafe now
-            while( std::cin.good() && !std::cin.eof() )
+            std::vector< char > buffer( reader.capacity() * gather.size() );
+            while( reader.read() > 0 )
             {
-                std::cin.read( &buf[0], csv.format().size() );
-                if( std::cin.gcount() == 0 ) { continue; }
-                COMMA_ASSERT_BRIEF( std::cin.gcount() >= int( csv.format().size() ), "expected " << csv.format().size() << " bytes, got only " << std::cin.gcount() );
-                for( const auto& offset: offsets ) { std::cout.write( &buf[ offset.first ], offset.second ); }
-                if( csv.flush ) { std::cout.flush(); }
+                gather.apply( reader.record( 0 ), reader.record_size(), reader.size(), &buffer[0] );
+                if( !csv.flush ) { std::cout.write( &buffer[0], reader.size() * gather.size() ); continue; }
+                for( std::size_t i = 0; i < reader.size(); ++i ) { std::cout.write( &buffer[0] + i * gather.size(), gather.size() ); std::cout.flush(); }
             }
             return 0;
         }
@@ -3,14 +3,21 @@
 /// @authors matthew imhoff, dewey nguyen, vsevolod vlaskine
 
 #include <algorithm>
+#include <array>
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <deque>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
 #include <random>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <boost/unordered_map.hpp>
 #include <boost/unordered_set.hpp>
@@ -44,6 +51,9 @@ static void usage( bool more )
     std::cerr << "               id: if present, multiple id fields accepted; output first record for each set of ids in a given block; e.g. --fields=id,a,,id" << std::endl;
     std::cerr << "               block: if present; output minimum for each contiguous block" << std::endl;
     std::cerr << "    --last: to be implemented: last line matching given keys; last line in the block, if block field present; no sorting will be done; if sorting required, use unique instead" << std::endl;
+    std::cerr << "    --memory-limit=<bytes>: sort input larger than memory: sort runs of up to about <bytes> in memory," << std::endl;
+    std::cerr << "                            spill them to temporary files and merge; works with --order, --reverse, --unique, block field" << std::endl;
+    std::cerr << "                            runs are merged at most 64 at a time, in several passes, if there are more" << std::endl;
     std::cerr << "    --min: output only record(s) with minimum value for a given field" << std::endl;
     std::cerr << "           fields" << std::endl;
     std::cerr << "               id: if present, multiple id fields accepted; output minimum for each set of ids in a given block; e.g. --fields=id,a,,id" << std::endl;
@@ -58,6 +68,9 @@ static void usage( bool more )
     std::cerr << "    --sliding-window,--window=<size>: sort last <size> entries" << std::endl;
     std::cerr << "    --string,-s: keys are strings; a quick and dirty option to support strings" << std::endl;
     std::cerr << "                 default: double" << std::endl;
+    std::cerr << "    --temporary-directory,--tmp-dir=<dir>: directory for temporary files of --memory-limit; default: $TMPDIR or /tmp" << std::endl;
+    std::cerr << "    --threads=<n>: sort in memory using <n> threads; 0: number of cores; radix sort for a single integer or time key," << std::endl;
+    std::cerr << "                   merge sort otherwise; output is the same as without --threads; can be used with --memory-limit" << std::endl;
     std::cerr << "    --unique,-u: sort input, output only the first line matching given keys; if no sorting required, use --first for better performance" << std::endl;
     std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
     std::cerr << std::endl;
@@ -345,6 +358,414 @@ static int handle_sliding_window( comma::csv::input_stream< input_with_block >&
     return 0;
 }
 
+namespace parallel {
+
+/// run f( i ) for i in [0, size) in up to size threads; the last one runs in the calling thread
+template < typename F > static void run_( unsigned int size, F f )
+{
+    std::vector< std::thread > threads;
+    for( unsigned int i = 0; i + 1 < size; ++i ) { threads.emplace_back( f, i ); }
+    f( size - 1 );
+    for( auto& t: threads ) { t.join(); }
+}
+
+/// stable merge sort: sort chunks in parallel, then merge pairs of adjacent chunks in parallel
+template < typename T, typename Less > static void stable_sort( std::vector< T >& v, Less less, unsigned int threads )
+{
+    if( threads < 2 || v.size() < threads * 1024 ) { std::stable_sort( v.begin(), v.end(), less ); return; }
+    std::size_t chunk = ( v.size() + threads - 1 ) / threads;
+    auto begin = [&]( std::size_t i ) { return v.begin() + std::min( i * chunk, v.size() ); };
+    run_( threads, [&]( unsigned int i ) { std::stable_sort( begin( i ), begin( i + 1 ), less ); } );
+    for( std::size_t width = 1; width < threads; width *= 2 )
+    {
+        unsigned int pairs = ( threads + width * 2 - 1 ) / ( width * 2 );
+        run_( pairs, [&]( unsigned int i ) { std::inplace_merge( begin( i * width * 2 ), begin( i * width * 2 + width ), begin( i * width * 2 + width * 2 ), less ); } );
+    }
+}
+
+/// stable lsd radix sort of indices by 64-bit unsigned keys, 8 bits per pass; passes on bytes that are the same for all keys are skipped
+static void radix_sort( std::vector< std::pair< comma::uint64, std::size_t > >& v, unsigned int threads )
+{
+    if( threads < 1 ) { threads = 1; }
+    if( v.size() < threads * 1024 ) { threads = 1; }
+    std::vector< std::pair< comma::uint64, std::size_t > > buffer( v.size() );
+    std::size_t chunk = ( v.size() + threads - 1 ) / threads;
+    std::vector< std::array< std::size_t, 256 > > counts( threads );
+    for( unsigned int shift = 0; shift < 64; shift += 8 )
+    {
+        run_( threads, [&]( unsigned int t )
+        {
+            counts[t].fill( 0 );
+            for( std::size_t i = t * chunk; i < std::min( ( t + 1 ) * chunk, v.size() ); ++i ) { ++counts[t][ ( v[i].first >> shift ) & 0xff ]; }
+        } );
+        bool same = false;
+        for( unsigned int d = 0; d < 256 && !same; ++d ) { std::size_t c = 0; for( unsigned int t = 0; t < threads; c += counts[t][d], ++t ); same = c == v.size(); }
+        if( same ) { continue; }
+        std::size_t offset = 0;
+        for( unsigned int d = 0; d < 256; ++d ) { for( unsigned int t = 0; t < threads; ++t ) { std::size_t c = counts[t][d]; counts[t][d] = offset; offset += c; } } // chunk order within digit keeps it stable
+        run_( threads, [&]( unsigned int t )
+        {
+            for( std::size_t i = t * chunk; i < std::min( ( t + 1 ) * chunk, v.size() ); ++i ) { buffer[ counts[t][ ( v[i].first >> shift ) & 0xff ]++ ] = v[i]; }
+        } );
+        v.swap( buffer );
+    }
+}
+
+} // namespace parallel {
+
+namespace external {
+
+/// keys of a record serialized in ordering sequence: longs, doubles and times as 8 bytes, strings as size and characters
+static void serialize_( const input_t& input, std::vector< char >& buf )
+{
+    auto append = [&]( const void* p, std::size_t size ) { buf.insert( buf.end(), static_cast< const char* >( p ), static_cast< const char* >( p ) + size ); };
+    for( const auto& o: ordering )
+    {
+        switch( o.type )
+        {
+            case ordering_t::long_type: append( &input.keys.longs[ o.index ], sizeof( comma::int64 ) ); break;
+            case ordering_t::double_type: append( &input.keys.doubles[ o.index ], sizeof( double ) ); break;
+            case ordering_t::time_type: append( &input.keys.time[ o.index ], sizeof( boost::posix_time::ptime ) ); break;
+            case ordering_t::str_type:
+            {
+                const std::string& s = input.keys.strings[ o.index ];
+                comma::uint32 size = s.size();
+                append( &size, sizeof( size ) );
+                append( s.data(), s.size() );
+                break;
+            }
+        }
+    }
+}
+
+template < typename T > static T get_( const char*& p ) { T t; ::memcpy( &t, p, sizeof( T ) ); p += sizeof( T ); return t; }
+
+/// compare serialized keys as input_t::operator< does: return negative, 0, or positive
+static int compare_( const char* lhs, const char* rhs )
+{
+    for( const auto& o: ordering )
+    {
+        switch( o.type )
+        {
+            case ordering_t::long_type: { comma::int64 l = get_< comma::int64 >( lhs ); comma::int64 r = get_< comma::int64 >( rhs ); if( l != r ) { return l < r ? -1 : 1; } break; }
+            case ordering_t::double_type: { double l = get_< double >( lhs ); double r = get_< double >( rhs ); if( l < r ) { return -1; } if( r < l ) { return 1; } break; }
+            case ordering_t::time_type: { auto l = get_< boost::posix_time::ptime >( lhs ); auto r = get_< boost::posix_time::ptime >( rhs ); if( l < r ) { return -1; } if( r < l ) { return 1; } break; }
+            case ordering_t::str_type:
+            {
+                comma::uint32 ls = get_< comma::uint32 >( lhs );
+                comma::uint32 rs = get_< comma::uint32 >( rhs );
+                int c = std::string::traits_type::compare( lhs, rhs, std::min( ls, rs ) );
+                if( c == 0 && ls != rs ) { c = ls < rs ? -1 : 1; }
+                if( c != 0 ) { return c; }
+                lhs += ls;
+                rhs += rs;
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+static bool less_( const char* lhs, const char* rhs, bool reverse ) { return reverse ? compare_( rhs, lhs ) < 0 : compare_( lhs, rhs ) < 0; }
+
+/// record in memory arena: serialized keys followed by record bytes; no allocations per record
+struct record_t
+{
+    std::size_t offset{0}; // offset of keys in arena
+    comma::uint32 keys{0}; // size of serialized keys
+    comma::uint32 size{0}; // size of record
+};
+
+template < typename T > static void write_( std::ostream& os, const T& t ) { os.write( reinterpret_cast< const char* >( &t ), sizeof( T ) ); }
+
+template < typename T > static void read_( std::istream& is, T& t ) { is.read( reinterpret_cast< char* >( &t ), sizeof( T ) ); }
+
+/// sorted run in a temporary file as a sequence of: keys size, record size, keys, record bytes
+/// the file is open only while being written and while being merged, which bounds the number of open files
+class run
+{
+    public:
+        run( const std::string& directory )
+        {
+            std::string name = directory + "/csv-sort.XXXXXX";
+            int fd = ::mkstemp( &name[0] );
+            if( fd < 0 ) { COMMA_THROW( comma::exception, "failed to create temporary file in " << directory << ": " << ::strerror( errno ) ); }
+            ::close( fd );
+            filename_ = name;
+            ofs_.open( filename_, std::ios::binary | std::ios::trunc );
+            if( !ofs_.is_open() ) { COMMA_THROW( comma::exception, "failed to open " << filename_ ); }
+        }
+
+        ~run() { ofs_.close(); ifs_.close(); ::remove( filename_.c_str() ); }
+
+        void write( const char* keys, comma::uint32 keys_size, const char* buf, comma::uint32 size )
+        {
+            write_( ofs_, keys_size );
+            write_( ofs_, size );
+            ofs_.write( keys, keys_size );
+            ofs_.write( buf, size );
+        }
+
+        /// done writing
+        void close()
+        {
+            ofs_.close();
+            if( ofs_.fail() ) { COMMA_THROW( comma::exception, "failed to write " << filename_ << "; disk full?" ); }
+        }
+
+        /// open for merging and read first record
+        void open()
+        {
+            ifs_.open( filename_, std::ios::binary );
+            if( !ifs_.is_open() ) { COMMA_THROW( comma::exception, "failed to open " << filename_ << ": " << ::strerror( errno ) ); }
+            next();
+        }
+
+        /// read next record, return false at the end of run
+        bool next()
+        {
+            if( ifs_.peek() == EOF ) { done_ = true; return false; }
+            comma::uint32 keys_size, size;
+            read_( ifs_, keys_size );
+            read_( ifs_, size );
+            keys_.resize( keys_size );
+            record_.resize( size );
+            ifs_.read( &keys_[0], keys_size );
+            ifs_.read( &record_[0], size );
+            if( !ifs_ ) { COMMA_THROW( comma::exception, "failed to read " << filename_ ); }
+            return true;
+        }
+
+        bool done() const { return done_; }
+
+        const std::string& keys() const { return keys_; }
+
+        const std::string& record() const { return record_; }
+
+    private:
+        std::string filename_;
+        std::ofstream ofs_;
+        std::ifstream ifs_;
+        std::string keys_;
+        std::string record_;
+        bool done_{false};
+};
+
+/// loser tree for k-way merge of sorted runs; on equal keys, the earlier run wins, which keeps the sort stable
+class loser_tree
+{
+    public:
+        loser_tree( std::vector< std::unique_ptr< run > >& runs, bool reverse ) : runs_( runs ), reverse_( reverse ), tree_( runs.size(), 0 )
+        {
+            tree_[0] = runs_.size() == 1 ? 0 : build_( 1 );
+        }
+
+        /// return current winner or null, if all runs are done
+        run* top() const { return runs_[ tree_[0] ]->done() ? nullptr : runs_[ tree_[0] ].get(); }
+
+        /// advance winner and replay its path to the root
+        void pop()
+        {
+            std::size_t winner = tree_[0];
+            runs_[winner]->next();
+            for( std::size_t node = ( winner + runs_.size() ) / 2; node > 0; node /= 2 ) { if( beats_( tree_[node], winner ) ) { std::swap( tree_[node], winner ); } }
+            tree_[0] = winner;
+        }
+
+    private:
+        std::vector< std::unique_ptr< run > >& runs_;
+        bool reverse_;
+        std::vector< std::size_t > tree_; // losers in internal nodes 1..k-1, winner in 0; leaves k..2k-1 are implicit
+
+        bool beats_( std::size_t a, std::size_t b ) const
+        {
+            if( runs_[a]->done() ) { return false; }
+            if( runs_[b]->done() ) { return true; }
+            if( less_( &runs_[a]->keys()[0], &runs_[b]->keys()[0], reverse_ ) ) { return true; }
+            if( less_( &runs_[b]->keys()[0], &runs_[a]->keys()[0], reverse_ ) ) { return false; }
+            return a < b;
+        }
+
+        std::size_t build_( std::size_t node )
+        {
+            if( node >= runs_.size() ) { return node - runs_.size(); }
+            std::size_t left = build_( node * 2 );
+            std::size_t right = build_( node * 2 + 1 );
+            if( beats_( left, right ) ) { tree_[node] = right; return left; }
+            tree_[node] = left;
+            return right;
+        }
+};
+
+/// sort records of a block in memory; if they do not fit in memory limit, sort them in runs spilled to disk and merge
+class sorter
+{
+    public:
+        /// merge at most that many runs at a time, merging in several passes, if there are more runs
+        static const std::size_t fan_in = 64;
+
+        sorter( bool reverse, bool unique, std::size_t memory_limit, const std::string& directory, unsigned int threads = 0 )
+            : reverse_( reverse ), unique_( unique ), memory_limit_( memory_limit ), directory_( directory ), threads_( threads ), used_( 0 )
+        {
+        }
+
+        void push( const input_t& keys, const char* buf, std::size_t size )
+        {
+            record_t r;
+            r.offset = arena_.size();
+            serialize_( keys, arena_ );
+            r.keys = arena_.size() - r.offset;
+            r.size = size;
+            arena_.insert( arena_.end(), buf, buf + size );
+            records_.push_back( r );
+            used_ += r.keys + size + sizeof( record_t ) + sizeof( std::size_t ); // record, its index in order_
+            if( used_ >= memory_limit_ ) { spill_(); }
+        }
+
+        /// output all records sorted and clear
+        void flush()
+        {
+            if( runs_.empty() )
+            {
+                sort_();
+                const char* last = nullptr;
+                for( auto i: order_ )
+                {
+                    const record_t& r = records_[i];
+                    if( unique_ && last && compare_( last, keys_( r ) ) == 0 ) { continue; }
+                    output_( keys_( r ) + r.keys, r.size );
+                    last = keys_( r );
+                }
+            }
+            else
+            {
+                if( !records_.empty() ) { spill_(); }
+                for( unsigned int pass = 1; runs_.size() > fan_in; ++pass ) // merge groups of adjacent runs into intermediate runs, which keeps the sort stable
+                {
+                    if( verbose ) { std::cerr << "csv-sort: merge pass " << pass << ": merging " << runs_.size() << " run(s) in groups of up to " << fan_in << std::endl; }
+                    std::vector< std::unique_ptr< run > > merged;
+                    for( std::size_t i = 0; i < runs_.size(); i += fan_in )
+                    {
+                        std::vector< std::unique_ptr< run > > group;
+                        for( std::size_t j = i; j < std::min( i + fan_in, runs_.size() ); ++j ) { group.push_back( std::move( runs_[j] ) ); }
+                        merged.emplace_back( new run( directory_ ) );
+                        run& m = *merged.back();
+                        merge_( group, [&]( const run& r ) { m.write( &r.keys()[0], r.keys().size(), &r.record()[0], r.record().size() ); } );
+                        m.close();
+                    }
+                    runs_.swap( merged );
+                }
+                if( verbose ) { std::cerr << "csv-sort: merging " << runs_.size() << " run(s)" << std::endl; }
+                merge_( runs_, [&]( const run& r ) { output_( &r.record()[0], r.record().size() ); } );
+            }
+            if( csv.flush ) { std::cout.flush(); }
+            clear_();
+        }
+
+    private:
+        bool reverse_;
+        bool unique_;
+        std::size_t memory_limit_;
+        std::string directory_;
+        unsigned int threads_;
+        std::size_t used_;
+        std::vector< char > arena_; // serialized keys and record bytes stored contiguously
+        std::vector< record_t > records_;
+        std::vector< std::size_t > order_; // sorted indices of records
+        std::vector< std::unique_ptr< run > > runs_;
+
+        const char* keys_( const record_t& r ) const { return &arena_[ r.offset ]; }
+
+        void sort_()
+        {
+            if( threads_ > 0 && ordering.size() == 1 && ( ordering[0].type == ordering_t::long_type || ordering[0].type == ordering_t::time_type ) )
+            {
+                static_assert( sizeof( boost::posix_time::ptime ) == sizeof( comma::int64 ), "expected time of size 8" ); // quick and dirty: underlying tick count, ordered as time
+                std::vector< std::pair< comma::uint64, std::size_t > > keys( records_.size() ); // compact key array: keys mapped to unsigned order, and record indices
+                for( std::size_t i = 0; i < records_.size(); ++i )
+                {
+                    const char* p = keys_( records_[i] );
+                    keys[i].first = comma::uint64( get_< comma::int64 >( p ) ) ^ ( comma::uint64( 1 ) << 63 );
+                    if( reverse_ ) { keys[i].first = ~keys[i].first; }
+                    keys[i].second = i;
+                }
+                parallel::radix_sort( keys, threads_ );
+                order_.resize( keys.size() );
+                for( std::size_t i = 0; i < keys.size(); ++i ) { order_[i] = keys[i].second; }
+                return;
+            }
+            order_.resize( records_.size() );
+            for( std::size_t i = 0; i < order_.size(); ++i ) { order_[i] = i; }
+            bool reverse = reverse_;
+            parallel::stable_sort( order_, [&]( std::size_t lhs, std::size_t rhs ) { return less_( keys_( records_[lhs] ), keys_( records_[rhs] ), reverse ); }, threads_ );
+        }
+
+        /// merge runs, pass records to f, and discard the runs
+        template < typename F > void merge_( std::vector< std::unique_ptr< run > >& runs, F f )
+        {
+            for( auto& r: runs ) { r->open(); }
+            std::string last;
+            bool has_last = false;
+            for( loser_tree tree( runs, reverse_ ); tree.top(); tree.pop() )
+            {
+                const run& r = *tree.top();
+                if( unique_ && has_last && compare_( &last[0], &r.keys()[0] ) == 0 ) { continue; }
+                f( r );
+                if( unique_ ) { last = r.keys(); has_last = true; }
+            }
+            runs.clear();
+        }
+
+        void spill_()
+        {
+            sort_();
+            runs_.emplace_back( new run( directory_ ) );
+            const char* last = nullptr;
+            for( auto i: order_ )
+            {
+                const record_t& r = records_[i];
+                if( unique_ && last && compare_( last, keys_( r ) ) == 0 ) { continue; }
+                runs_.back()->write( keys_( r ), r.keys, keys_( r ) + r.keys, r.size );
+                last = keys_( r );
+            }
+            runs_.back()->close(); // keep closed until merged
+            if( verbose ) { std::cerr << "csv-sort: spilled run " << runs_.size() << " of " << records_.size() << " record(s)" << std::endl; }
+            clear_();
+        }
+
+        void clear_() { records_.clear(); order_.clear(); arena_.clear(); used_ = 0; }
+
+        static void output_( const char* buf, std::size_t size )
+        {
+            std::cout.write( buf, size );
+            if( !csv.binary() ) { std::cout << std::endl; }
+        }
+};
+
+} // namespace external {
+
+static int handle_sorter( comma::csv::input_stream< input_with_block >& istream, const std::string& first_line, const input_with_block& default_input, bool reverse, bool unique, std::size_t memory_limit, const std::string& directory, unsigned int threads )
+{
+    external::sorter sorter( reverse, unique, memory_limit, directory, threads );
+    if( !first_line.empty() )
+    {
+        input_with_block input = comma::csv::ascii< input_with_block >( csv, default_input ).get( first_line );
+        block.update( input );
+        sorter.push( input, &first_line[0], first_line.size() );
+    }
+    while( istream.ready() || ( std::cin.good() && !std::cin.eof() ) )
+    {
+        const input_with_block* p = istream.read();
+        if( !p || block != *p ) { sorter.flush(); }
+        if( !p ) { break; }
+        block.update( *p );
+        if( istream.is_binary() ) { sorter.push( *p, istream.binary().last(), csv.format().size() ); }
+        else { sorter.push( *p, &istream.ascii().line()[0], istream.ascii().line().size() ); }
+    }
+    sorter.flush();
+    return 0;
+}
+
 typedef std::vector< std::string > records_t;
 struct limit_data_t
 {
@@ -678,6 +1099,16 @@ static int sort( const comma::command_line_options& options )
     if( options.exists( "--discard-out-of-order,--discard-unsorted" ) ) { return handle_discard_out_of_order( istream, first_line, default_input, reverse ); }
     auto sliding_window = options.optional< unsigned int >( "--sliding-window,--window" );
     if( sliding_window ) { return handle_sliding_window( istream, first_line, default_input, reverse, *sliding_window ); }
+    auto memory_limit = options.optional< std::size_t >( "--memory-limit" );
+    auto threads = options.optional< unsigned int >( "--threads" );
+    if( memory_limit || threads )
+    {
+        const char* tmpdir = ::getenv( "TMPDIR" );
+        std::string directory = options.value< std::string >( "--temporary-directory,--tmp-dir", tmpdir ? tmpdir : "/tmp" );
+        unsigned int t = threads ? *threads : 0;
+        if( threads && t == 0 ) { t = std::max( 1U, std::thread::hardware_concurrency() ); }
+        return handle_sorter( istream, first_line, default_input, reverse, unique, memory_limit ? *memory_limit : std::numeric_limits< std::size_t >::max(), directory, t );
+    }
     input_t::map map;
     if( !first_line.empty() )
     {
@@ -723,6 +1154,10 @@ int main( int ac, char** av )
         comma::command_line_options options( ac, av, usage );
         options.assert_mutually_exclusive( "--discard-out-of-order,--discard-unsorted,--first,--min,--sliding-window,--window,--unique,--random" );
         options.assert_mutually_exclusive( "--discard-out-of-order,--discard-unsorted,--first,--max,--sliding-window,--window,--unique,--random" );
+        options.assert_mutually_exclusive( "--discard-out-of-order,--discard-unsorted,--first,--min,--sliding-window,--window,--random,--memory-limit" );
+        options.assert_mutually_exclusive( "--discard-out-of-order,--discard-unsorted,--first,--max,--sliding-window,--window,--random,--memory-limit" );
+        options.assert_mutually_exclusive( "--discard-out-of-order,--discard-unsorted,--first,--min,--sliding-window,--window,--random,--threads" );
+        options.assert_mutually_exclusive( "--discard-out-of-order,--discard-unsorted,--first,--max,--sliding-window,--window,--random,--threads" );
         if( options.exists( "--last" ) ) { std::cerr << "csv-sort: --last: not implemented; todo" << std::endl; return 1; }
         verbose = options.exists( "--verbose,-v" );
         csv = comma::csv::options( options );
@@ -30,8 +30,10 @@
 
 /// @author vsevolod vlaskine
 
+#include <algorithm>
 #include <cmath>
 #include <deque>
+#include <memory>
 #include <iostream>
 #include <string>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -71,6 +73,16 @@ static void usage( bool verbose )
     std::cerr << "note: on windows only files are supported as bounding data" << std::endl;
     std::cerr << std::endl;
     std::cerr << "usage: cat a.csv | csv-time-join <how> [<options>] bounding.csv [-] > joined.csv" << std::endl;
+    std::cerr << "       cat a.csv | csv-time-join <how> [<options>] [-] b.csv c.csv [-] d.csv ... > joined.csv" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "n-way join: if more than one bounding source is given, each input record is joined" << std::endl;
+    std::cerr << "    with all of them at once and output as a single record, concatenated in the order" << std::endl;
+    std::cerr << "    of sources on the command line ('-' for stdin, default: first); the record is output" << std::endl;
+    std::cerr << "    only if it gets joined with every bounding source; bounding sources are read as their" << std::endl;
+    std::cerr << "    data arrives, input waits only for the source lagging behind it in time" << std::endl;
+    std::cerr << "    --diff, --abs-diff: differences for each bounding source in the order of sources" << std::endl;
+    std::cerr << "    --buffer, --discard-bounding: apply to each bounding source" << std::endl;
+    std::cerr << "    --realtime: not supported" << std::endl;
     std::cerr << std::endl;
     std::cerr << "<how>" << std::endl;
     std::cerr << "    --by-lower: join by lower timestamp (default)" << std::endl;
@@ -130,6 +142,8 @@ static void usage( bool verbose )
         std::cerr << "    cat a.csv | csv-time-join b.csv --nearest --bound=2" << std::endl;
         std::cerr << "    cat a.csv | csv-time-join b.csv --nearest --bound=2 --select" << std::endl;
         std::cerr << "    cat a.csv | csv-time-join b.csv --nearest --bound=2 --timestamp-only" << std::endl;
+        std::cerr << "    cat a.csv | csv-time-join b.csv c.csv --nearest" << std::endl;
+        std::cerr << "    cat a.csv | csv-time-join b.csv - c.csv" << std::endl;
         std::cerr << std::endl;
         std::cerr << "    ( sleep 1; cat a.csv ) | csv-play |" << std::endl;
         std::cerr << "        csv-time-join --realtime <( cat b.csv | csv-play )" << std::endl;
@@ -232,6 +246,196 @@ static void output( const timestring_t& input, const timestring_t& bounding, boo
     std::cout.flush();
 }
 
+namespace nway {
+
+/// ring buffer of timestamped records of a bounding source; slots are reused, i.e. once
+/// warmed up, no memory is allocated per record
+class ring
+{
+    public:
+        ring( std::size_t limit = 0 ) : buffer_( 16 ), begin_( 0 ), size_( 0 ), limit_( limit == 1 ? 2 : limit ) {} // limit: 0 for unlimited; at least lower and upper bound need to fit
+
+        std::size_t size() const { return size_; }
+        bool full() const { return limit_ > 0 && size_ >= limit_; }
+        const timestring_t& operator[]( std::size_t i ) const { return buffer_[ ( begin_ + i ) & ( buffer_.size() - 1 ) ]; }
+        const timestring_t& back() const { return ( *this )[ size_ - 1 ]; }
+        void pop_front() { begin_ = ( begin_ + 1 ) & ( buffer_.size() - 1 ); --size_; }
+        void push_back( const boost::posix_time::ptime& t, const char* data, std::size_t size )
+        {
+            if( size_ == buffer_.size() ) { grow_(); }
+            timestring_t& r = buffer_[ ( begin_ + size_ ) & ( buffer_.size() - 1 ) ];
+            r.first = t;
+            r.second.assign( data, size );
+            ++size_;
+        }
+
+    private:
+        std::vector< timestring_t > buffer_; // size is a power of 2
+        std::size_t begin_;
+        std::size_t size_;
+        std::size_t limit_;
+        void grow_()
+        {
+            std::vector< timestring_t > b( buffer_.size() * 2 );
+            for( std::size_t i = 0; i < size_; ++i ) { b[i].first = ( *this )[i].first; b[i].second.swap( buffer_[ ( begin_ + i ) & ( buffer_.size() - 1 ) ].second ); }
+            buffer_.swap( b );
+            begin_ = 0;
+        }
+};
+
+struct source
+{
+    comma::csv::options csv;
+    std::unique_ptr< comma::io::istream > istream;
+    std::unique_ptr< comma::csv::input_stream< Point > > stream;
+    nway::ring records;
+    bool eof;
+
+    source( const std::string& properties, unsigned int buffer_size ) : records( buffer_size ), eof( false )
+    {
+        csv = comma::name_value::parser( "filename" ).get< comma::csv::options >( properties );
+        if( csv.fields.empty() ) { csv.fields = "t"; }
+        istream.reset( new comma::io::istream( comma::split( properties, ';' )[0], csv.binary() ? comma::io::mode::binary : comma::io::mode::ascii ) );
+        stream.reset( new comma::csv::input_stream< Point >( **istream, csv ) );
+        records.push_back( boost::posix_time::neg_infin, "", 0 ); // fake lower bound to allow input before the first bound to match
+    }
+
+    /// return time of the latest record read; +infinity after the end of stream
+    const boost::posix_time::ptime& latest() const { return records.back().first; }
+
+    bool ready( const comma::io::select& select ) const { return !eof && ( stream->ready() || select.read().ready( istream->fd() ) ); }
+
+    /// read one record; on the end of stream, add a fake upper bound to allow input after the last bound to match
+    void read()
+    {
+        const Point* p = stream->read();
+        if( p )
+        {
+            if( csv.binary() ) { records.push_back( get_time( *p ), stream->binary().last(), csv.format().size() ); }
+            else { const std::string& s = stream->last(); records.push_back( get_time( *p ), &s[0], s.size() ); }
+            return;
+        }
+        records.push_back( boost::posix_time::pos_infin, "", 0 );
+        eof = true;
+    }
+
+    /// discard records that cannot be bounds for input at time t or later
+    void trim( const boost::posix_time::ptime& t ) { while( records.size() >= 2 && t >= records[1].first ) { records.pop_front(); } }
+};
+
+/// min-heap of sources by their latest time, i.e. the top is the source lagging behind
+///
+/// latest times of sources only grow, thus keys in the heap may be stale, but never too big:
+/// a stale top is refreshed lazily when queried
+class frontier
+{
+    public:
+        frontier( const std::vector< std::unique_ptr< source > >& sources ) : sources_( sources )
+        {
+            for( std::size_t i = 0; i < sources.size(); ++i ) { heap_.push_back( std::make_pair( sources[i]->latest(), i ) ); }
+            std::make_heap( heap_.begin(), heap_.end(), later_ );
+        }
+
+        /// return index of the source with the earliest latest time
+        std::size_t lagging()
+        {
+            while( heap_.front().first != sources_[ heap_.front().second ]->latest() )
+            {
+                std::pop_heap( heap_.begin(), heap_.end(), later_ );
+                heap_.back().first = sources_[ heap_.back().second ]->latest();
+                std::push_heap( heap_.begin(), heap_.end(), later_ );
+            }
+            return heap_.front().second;
+        }
+
+    private:
+        typedef std::pair< boost::posix_time::ptime, std::size_t > entry;
+        const std::vector< std::unique_ptr< source > >& sources_;
+        std::vector< entry > heap_;
+        static bool later_( const entry& lhs, const entry& rhs ) { return rhs.first < lhs.first; }
+};
+
+static void output( const timestring_t& input, const std::vector< std::unique_ptr< source > >& sources, const std::vector< int >& order )
+{
+    static std::vector< const timestring_t* > chosen( sources.size() );
+    for( std::size_t i = 0; i < sources.size(); ++i )
+    {
+        const ring& r = sources[i]->records;
+        if( method == how::by_lower && input.first < r[0].first ) { return; }
+        bool is_first = method == how::by_lower || ( method == how::nearest && ( input.first - r[0].first ) < ( r[1].first - input.first ) );
+        chosen[i] = &r[ is_first ? 0 : 1 ];
+        if( chosen[i]->first.is_infinity() ) { return; }
+        if( bound && ( input.first - chosen[i]->first > bound || chosen[i]->first - input.first > bound ) ) { return; }
+    }
+    bool first = true;
+    for( int j: order )
+    {
+        if( j < 0 ) { if( !first && !stdin_csv.binary() ) { std::cout << stdin_csv.delimiter; } output_input( std::cout, input ); first = false; continue; }
+        if( select_only ) { continue; }
+        if( stdin_csv.binary() ) { output_bounding( std::cout, *chosen[j], true ); }
+        else { std::cout << ( first ? "" : std::string( 1, stdin_csv.delimiter ) ) << ( timestamp_only ? boost::posix_time::to_iso_string( chosen[j]->first ) : chosen[j]->second ); }
+        first = false;
+    }
+    for( std::size_t i = 0; i < sources.size(); ++i ) { _output_diff( std::cout, input.first, chosen[i]->first ); }
+    if( !stdin_csv.binary() ) { std::cout << '\n'; }
+    std::cout.flush();
+}
+
+/// join stdin with all sources, waiting for events rather than polling
+/// @param order sources and stdin (-1) in the output order
+static int run( comma::csv::input_stream< Point >& stdin_stream, const std::vector< std::unique_ptr< source > >& sources, const std::vector< int >& order, bool discard_bounding, const comma::signal_flag& is_shutdown )
+{
+    #ifdef WIN32
+    COMMA_THROW( comma::exception, "n-way join not supported in WIN32" );
+    #else
+    comma::io::select select;
+    select.read().add( 0 );
+    for( const auto& s: sources ) { select.read().add( s->istream->fd() ); }
+    frontier f( sources );
+    timestring_t input;
+    bool pending = false;
+    while( !is_shutdown )
+    {
+        bool idle = true;
+        if( !pending && ( stdin_stream.ready() || select.read().ready( 0 ) ) )
+        {
+            const Point* p = stdin_stream.read();
+            if( !p ) { break; }
+            input.first = get_time( *p );
+            if( stdin_csv.binary() ) { input.second.assign( stdin_stream.binary().last(), stdin_csv.format().size() ); } else { input.second = stdin_stream.last(); }
+            pending = true;
+            idle = false;
+        }
+        if( pending )
+        {
+            for( auto& s: sources ) { s->trim( input.first ); }
+            if( input.first < sources[ f.lagging() ]->latest() ) // all sources have records after input
+            {
+                output( input, sources, order );
+                pending = false;
+                idle = false;
+            }
+        }
+        for( auto& s: sources )
+        {
+            if( !s->ready( select ) ) { continue; }
+            if( s->records.full() && !discard_bounding ) { continue; } // block source until stdin catches up
+            s->read();
+            if( s->eof ) { select.read().remove( s->istream->fd() ); }
+            else if( s->records.full() && discard_bounding && s->records.size() > 2 ) { s->records.pop_front(); }
+            idle = false;
+        }
+        if( pending ) { select.read().remove( 0 ); } else { select.read().add( 0 ); } // watch only what can be read now, otherwise select would spin
+        for( const auto& s: sources ) { if( !s->eof ) { if( s->records.full() && !discard_bounding ) { select.read().remove( s->istream->fd() ); } else { select.read().add( s->istream->fd() ); } } }
+        if( idle ) { select.wait(); } else { select.check(); }
+    }
+    if( is_shutdown ) { comma::verbose << "got a signal" << std::endl; }
+    return 0;
+    #endif
+}
+
+} // namespace nway {
+
 int main( int ac, char** av )
 {
     try
@@ -256,6 +460,25 @@ int main( int ac, char** av )
         std::vector< std::string > unnamed = options.unnamed(
             "--by-lower,--by-upper,--nearest,--realtime,--select,--do-not-append,--timestamp-only,--time-only,--discard-bounding",
             "--binary,-b,--delimiter,-d,--fields,-f,--bound,--buffer,--verbose,-v,--output-diff-abs,--abs-diff,--diff-abs,--diff" );
+        if( std::count_if( unnamed.begin(), unnamed.end(), []( const std::string& s ) { return s != "-"; } ) > 1 )
+        {
+            COMMA_ASSERT_BRIEF( std::count( unnamed.begin(), unnamed.end(), std::string( "-" ) ) < 2, "expected at most one '-'; got: " << comma::join( unnamed, ' ' ) );
+            COMMA_ASSERT_BRIEF( method != how::realtime, "--realtime: not supported for more than one bounding source" );
+            std::vector< std::unique_ptr< nway::source > > sources;
+            std::vector< int > order;
+            if( std::find( unnamed.begin(), unnamed.end(), std::string( "-" ) ) == unnamed.end() ) { order.push_back( -1 ); }
+            for( const auto& u: unnamed )
+            {
+                if( u == "-" ) { order.push_back( -1 ); continue; }
+                order.push_back( sources.size() );
+                sources.emplace_back( new nway::source( u, buffer_size ? *buffer_size : 0 ) );
+            }
+            #ifdef WIN32
+            if( stdin_csv.binary() ) { _setmode( _fileno( stdout ), _O_BINARY ); }
+            #endif // #ifdef WIN32
+            comma::csv::input_stream< Point > stdin_stream( std::cin, stdin_csv );
+            return nway::run( stdin_stream, sources, order, discard_bounding, is_shutdown );
+        }
         std::string properties;
         bool stdin_first = true;
         switch( unnamed.size() )
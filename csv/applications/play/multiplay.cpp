@@ -42,12 +42,13 @@ Multiplay::Multiplay( const std::vector< SourceConfig >& configs
                     , const boost::posix_time::time_duration& resolution
                     , boost::posix_time::ptime from
                     , boost::posix_time::ptime to
-                    , bool flush )
+                    , bool flush
+                    , const csv::impl::play::precise_t& precise )
     : m_configs( configs )
     , istreams_( configs.size() )
     , _input_streams( configs.size() )
     , _publishers( configs.size() )
-    , m_play( speed, quiet, resolution )
+    , m_play( speed, quiet, resolution, precise )
     , m_timestamps( configs.size() )
     , m_started( false )
     , m_from( from )
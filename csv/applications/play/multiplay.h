@@ -107,7 +107,8 @@ class Multiplay
                  , const boost::posix_time::time_duration& resolution = boost::posix_time::milliseconds( 1 )
                  , boost::posix_time::ptime from = boost::posix_time::not_a_date_time
                  , boost::posix_time::ptime to = boost::posix_time::not_a_date_time
-                 , bool flush = true );
+                 , bool flush = true
+                 , const csv::impl::play::precise_t& precise = csv::impl::play::precise_t() );
 
         void close();
 
@@ -117,6 +118,8 @@ class Multiplay
 
         void paused_for( const boost::posix_time::time_duration& pause_duration ) { m_play.paused_for( pause_duration ); }
 
+        const csv::impl::play::jitter_t& jitter() const { return m_play.jitter(); }
+
     private:
         std::vector<SourceConfig> m_configs;
         std::vector< boost::shared_ptr< comma::io::istream > > istreams_;
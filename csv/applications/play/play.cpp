@@ -29,8 +29,14 @@
 
 /// @author cedric wohlleber
 
+#ifndef WIN32
+#include <errno.h>
+#include <time.h>
+#endif
+#include <algorithm>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/thread_time.hpp>
+#include "../../../base/exception.h"
 #include "play.h"
 
 namespace comma { namespace csv { namespace impl {
@@ -38,21 +44,87 @@ namespace comma { namespace csv { namespace impl {
 /// constructor    
 /// @param speed speed-up factor: 1.0 = real time, 0.5 = half speed etc
 /// @param quiet if true, do not output warnings if we can not keep up with the desired playback speed
-/// @param resolution expected resolution from the sleep function
-play::play( double speed, bool quiet, const boost::posix_time::time_duration& resolution )
-    : m_times_initialized( false )
+/// @param resolution expected resolution from the sleep function; with precise scheduler: tick, i.e. records due within resolution after a release are released together
+/// @param precise precise scheduler settings
+play::play( double speed, bool quiet, const boost::posix_time::time_duration& resolution, const precise_t& precise )
+    : m_precise( precise )
+    , m_monotonicFirst( 0 )
+    , m_tickEnd( 0 )
+    , m_times_initialized( false )
     , m_speed( speed )
     , m_resolution( resolution )
     , m_lag( false )
     , m_lagCounter( 0U )
     , m_quiet( quiet )
 {
+    #ifndef __linux__
+    if( m_precise.enabled ) { COMMA_THROW( comma::exception, "precise scheduler: implemented only for linux" ); }
+    #endif
+}
+
+#ifdef __linux__
+static comma::int64 monotonic_now()
+{
+    struct timespec t;
+    ::clock_gettime( CLOCK_MONOTONIC, &t );
+    return comma::int64( t.tv_sec ) * 1000000000 + t.tv_nsec;
+}
+
+static void sleep_until( comma::int64 deadline )
+{
+    struct timespec t;
+    t.tv_sec = deadline / 1000000000;
+    t.tv_nsec = deadline % 1000000000;
+    while( ::clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &t, nullptr ) == EINTR );
+}
+#endif // #ifdef __linux__
+
+/// wait until a timestamp using absolute deadlines on monotonic clock: sleep until shortly before the deadline, then spin;
+/// records due in the same tick are released without reading the clock
+void play::precise_wait_( const boost::posix_time::ptime& time )
+{
+    #ifdef __linux__
+    if( !m_times_initialized )
+    {
+        m_monotonicFirst = monotonic_now();
+        m_tickEnd = m_monotonicFirst + m_resolution.total_microseconds() * 1000;
+        m_first = time;
+        m_last = time;
+        m_times_initialized = true;
+        m_jitter.add( 0 );
+        return;
+    }
+    if( time < m_last ) { return; } // timestamp earlier than last time, nothing to do
+    m_last = time;
+    const comma::int64 target = m_monotonicFirst + comma::int64( ( time - m_first ).total_nanoseconds() / m_speed );
+    if( target <= m_tickEnd ) { ++m_jitter.batched; m_jitter.add( m_tickEnd - m_resolution.total_microseconds() * 1000 - target ); return; }
+    comma::int64 now = monotonic_now();
+    const comma::int64 spin = m_precise.spin.total_microseconds() * 1000;
+    if( target - now > spin ) { sleep_until( target - spin ); now = monotonic_now(); }
+    while( now < target ) { now = monotonic_now(); }
+    const comma::int64 lag = now - target;
+    m_jitter.add( lag );
+    m_tickEnd = now + m_resolution.total_microseconds() * 1000;
+    if( m_quiet ) { return; }
+    if( lag > std::max( m_resolution.total_microseconds() * 1000, comma::int64( 10000000 ) ) ) // small lags are reported in jitter statistics instead
+    {
+        if( !m_lag ) { m_lag = true; std::cerr << "csv-play: warning, lagging behind " << boost::posix_time::microseconds( lag / 1000 ) << std::endl; }
+        m_lagCounter++;
+    }
+    else if( m_lag )
+    {
+        std::cerr << "csv-play: recovered after " << m_lagCounter << " packets " << std::endl;
+        m_lag = false;
+        m_lagCounter = 0U;
+    }
+    #endif // #ifdef __linux__
 }
 
 /// wait until a timestamp
 /// @param time timestamp as ptime
 void play::wait( const boost::posix_time::ptime& time )
 {
+    if( m_precise.enabled ) { precise_wait_( time ); return; }
     if ( !m_times_initialized )
     {
         boost::posix_time::ptime systemTime = boost::get_system_time();
@@ -102,6 +174,40 @@ void play::wait( const std::string& isoTime ) { wait( boost::posix_time::from_is
 
 /// allow for a pause in playback
 /// @param pause_duration duration of pause
-void play::paused_for( const boost::posix_time::time_duration& pause_duration ) { if( m_times_initialized ) { m_systemFirst += pause_duration; } }
+void play::paused_for( const boost::posix_time::time_duration& pause_duration )
+{
+    if( !m_times_initialized ) { return; }
+    m_systemFirst += pause_duration;
+    m_monotonicFirst += pause_duration.total_microseconds() * 1000;
+}
+
+void play::jitter_t::add( comma::int64 lateness )
+{
+    std::array< comma::uint64, size >& h = lateness < 0 ? early : late;
+    comma::int64 d = lateness < 0 ? -lateness : lateness;
+    if( lateness < 0 ) { max_early = std::max( max_early, d ); } else { max_late = std::max( max_late, d ); }
+    unsigned int i = 0;
+    for( comma::int64 b = 1000; i + 1 < size && d >= b; b *= 10, ++i );
+    ++h[i];
+}
+
+comma::uint64 play::jitter_t::count() const
+{
+    comma::uint64 c = 0;
+    for( unsigned int i = 0; i < size; ++i ) { c += late[i] + early[i]; }
+    return c;
+}
+
+void play::jitter_t::write( std::ostream& os ) const
+{
+    static const char* buckets[] = { "<1us", "<10us", "<100us", "<1ms", "<10ms", ">=10ms" };
+    os << "csv-play: released " << count() << " record(s), " << batched << " of them in the tick of a previous record" << std::endl;
+    os << "csv-play: late:";
+    for( unsigned int i = 0; i < size; ++i ) { os << " " << buckets[i] << ": " << late[i]; }
+    os << "; max: " << ( max_late / 1000 ) << "us" << std::endl;
+    os << "csv-play: early:";
+    for( unsigned int i = 0; i < size; ++i ) { os << " " << buckets[i] << ": " << early[i]; }
+    os << "; max: " << ( max_early / 1000 ) << "us" << std::endl;
+}
 
 } } } // namespace comma { namespace csv { namespace impl {
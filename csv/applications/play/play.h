@@ -31,8 +31,11 @@
 
 #pragma once
 
+#include <array>
+#include <iostream>
 #include <boost/optional.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include "../../../base/types.h"
 
 namespace comma { namespace csv { namespace impl {
 
@@ -40,7 +43,30 @@ namespace comma { namespace csv { namespace impl {
 class play
 {
 public:
-    play( double speed = 1.0, bool quiet = false, const boost::posix_time::time_duration& resolution = boost::posix_time::milliseconds(1) );
+    /// precise scheduler settings
+    struct precise_t
+    {
+        bool enabled;
+        boost::posix_time::time_duration spin; /// busy-wait that long before the deadline instead of sleeping
+        precise_t( bool enabled = false, const boost::posix_time::time_duration& spin = boost::posix_time::microseconds( 200 ) ) : enabled( enabled ), spin( spin ) {}
+    };
+
+    /// release jitter statistics of precise scheduler
+    struct jitter_t
+    {
+        enum { size = 6 }; /// histogram buckets: <1us, <10us, <100us, <1ms, <10ms, >=10ms
+        std::array< comma::uint64, size > late;
+        std::array< comma::uint64, size > early;
+        comma::uint64 batched; /// records released in the tick of a previous record without waiting
+        comma::int64 max_late; /// nanoseconds
+        comma::int64 max_early; /// nanoseconds
+        jitter_t() : batched( 0 ), max_late( 0 ), max_early( 0 ) { late.fill( 0 ); early.fill( 0 ); }
+        void add( comma::int64 lateness ); /// lateness in nanoseconds, negative if early
+        comma::uint64 count() const;
+        void write( std::ostream& os ) const;
+    };
+
+    play( double speed = 1.0, bool quiet = false, const boost::posix_time::time_duration& resolution = boost::posix_time::milliseconds(1), const precise_t& precise = precise_t() );
 
     void wait( const boost::posix_time::ptime& time );
 
@@ -48,7 +74,14 @@ public:
 
     void paused_for( const boost::posix_time::time_duration& pause_duration );
 
+    const jitter_t& jitter() const { return m_jitter; }
+
 private:
+    void precise_wait_( const boost::posix_time::ptime& time );
+    precise_t m_precise;
+    comma::int64 m_monotonicFirst; /// monotonic clock at first timestamp, nanoseconds
+    comma::int64 m_tickEnd; /// monotonic clock up to which due records are released without waiting, nanoseconds
+    jitter_t m_jitter;
     bool m_times_initialized;
     boost::posix_time::ptime m_systemFirst; /// system time at first timestamp
     boost::posix_time::ptime m_first; /// first timestamp
@@ -33,11 +33,13 @@
 #ifndef COMMA_CSV_BINARY_HEADER_GUARD_
 #define COMMA_CSV_BINARY_HEADER_GUARD_
 
+#include <type_traits>
 #include <boost/optional.hpp>
 #include "../string/string.h"
 #include "names.h"
 #include "options.h"
 #include "impl/binary_visitor.h"
+#include "impl/default_binary.h"
 #include "impl/from_binary.h"
 #include "impl/to_binary.h"
 
@@ -68,13 +70,24 @@ class binary
     private:
         csv::format format_;
         boost::optional< impl::binary_visitor > binary_;
+        bool memcpy_;
+        bool init_default_( const std::string& names, bool full_path_as_name, const S& sample );
 };
 
+template < typename S >
+inline bool binary< S >::init_default_( const std::string& names, bool full_path_as_name, const S& sample )
+{
+    memcpy_ = false;
+    if( format_.string() != csv::format::value( sample ) || names != join( csv::names( full_path_as_name ), ',' ) ) { return false; }
+    memcpy_ = format_.size() == sizeof( S ) && std::is_trivially_copyable< S >::value && impl::default_binary::same_as_memory( sample );
+    return memcpy_ || impl::default_binary::fits( sample, format_.size() );
+}
+
 template < typename S >
 inline binary< S >::binary( const std::string& f, const std::string& column_names, bool full_path_as_name, const S& sample )
     : format_( f == "" ? csv::format::value( sample ) : f )
 {
-    if( format_.size() == sizeof( S ) && format_.string() == csv::format::value( sample ) && join( csv::names( column_names, full_path_as_name, sample ), ',' ) == join( csv::names( full_path_as_name ), ',' ) ) { return; }
+    if( init_default_( join( csv::names( column_names, full_path_as_name, sample ), ',' ), full_path_as_name, sample ) ) { return; }
     binary_ = impl::binary_visitor( format_, join( csv::names( column_names, full_path_as_name, sample ), ',' ), full_path_as_name );
     visiting::apply( *binary_, sample );
     //if( binary_ && binary_->offsets().size() == 0 ) { COMMA_THROW( comma::exception, "expected at least one field of \"" << comma::join( csv::names< S >( full_path_as_name ), ',' ) << "\"; got \"" << column_names << "\"" ); }
@@ -84,7 +97,7 @@ template < typename S >
 inline binary< S >::binary( const options& o, const S& sample )
     : format_( o.format().string() == "" ? csv::format::value( sample ) : o.format().string() )
 {
-    if( format_.size() == sizeof( S ) && format_.string() == csv::format::value( sample ) && join( csv::names( o.fields, o.full_xpath, sample ), ',' ) == join( csv::names( o.full_xpath ), ',' ) ) { return; }
+    if( init_default_( join( csv::names( o.fields, o.full_xpath, sample ), ',' ), o.full_xpath, sample ) ) { return; }
     binary_ = impl::binary_visitor( format_, join( csv::names( o.fields, o.full_xpath, sample ), ',' ), o.full_xpath );
     visiting::apply( *binary_, sample );
     //if( binary_ && binary_->offsets().size() == 0 ) { COMMA_THROW( comma::exception, "expected at least one field of \"" << comma::join( csv::names< S >( o.full_xpath ), ',' ) << "\"; got \"" << o.fields << "\"" ); }
@@ -98,10 +111,14 @@ inline const S& binary< S >::get( S& s, const char* buf ) const
         impl::from_binary_ f( binary_->offsets(), binary_->optional(), buf );
         visiting::apply( f, s );
     }
-    else // quick and dirty for better performance
+    else if( memcpy_ ) // layout in memory is the same as binary layout
     {
         ::memcpy( reinterpret_cast< char* >( &s ), buf, sizeof( S ) );
     }
+    else
+    {
+        impl::default_binary::get( s, buf );
+    }
     return s;
 }
 
@@ -113,10 +130,14 @@ inline char* binary< S >::put( const S& s, char* buf ) const
         impl::to_binary f( binary_->offsets(), buf );
         visiting::apply( f, s );
     }
-    else // quick and dirty for better performance
+    else if( memcpy_ ) // layout in memory is the same as binary layout
     {
         ::memcpy( buf, reinterpret_cast< const char* >( &s ), sizeof( S ) );
     }
+    else
+    {
+        impl::default_binary::put( s, buf );
+    }
     return buf;
 }
 
@@ -13,6 +13,7 @@
 #include "../base/types.h"
 #include "../string/string.h"
 #include "../csv/format.h"
+#include "../csv/impl/ascii_cast.h"
 
 namespace comma { namespace csv {
 
@@ -163,32 +164,22 @@ static std::size_t csv_to_bin( char* buf, const std::string& s )
 {
     // T t = boost::lexical_cast< T >( s );
     //::memcpy( buf, &t, sizeof( T ) );
-    *reinterpret_cast< T* >( buf ) = boost::lexical_cast< T >( s );
+    ascii_cast< T >::from( *reinterpret_cast< T* >( buf ), &s[0], &s[0] + s.size() );
     return sizeof( T );
 }
 
 template < typename T >
-static void withPrecision( std::ostringstream& oss, T t, const boost::optional< unsigned int >& ) { oss << t; }
-
-static void withPrecision( std::ostringstream& oss, float t, const boost::optional< unsigned int >& precision )
-{
-    oss.precision( precision ? *precision : 6 );
-    oss << t;
-}
-
-static void withPrecision( std::ostringstream& oss, double t, const boost::optional< unsigned int >& precision )
+static void append( std::string& s, const T& t, const boost::optional< unsigned int >& precision )
 {
-    oss.precision( precision ? *precision : 16 );
-    oss << t;
+    std::string v;
+    ascii_cast< T >::to( v, t, precision );
+    s += v;
 }
 
 template < typename T >
-static std::size_t bin_to_csv( std::ostringstream& oss, const char* buf, const boost::optional< unsigned int >& precision )
+static std::size_t bin_to_csv( std::string& s, const char* buf, const boost::optional< unsigned int >& precision )
 {
-    //T t;
-    //::memcpy( &t, buf, sizeof( T ) );
-    //withPrecision( oss, t, precision );
-    withPrecision( oss, *reinterpret_cast< const T* >( buf ), precision );
+    append( s, *reinterpret_cast< const T* >( buf ), precision );
     return sizeof( T );
 }
 
@@ -199,7 +190,7 @@ static boost::posix_time::ptime time_from_iso_string( const std::string& s )
     else if ( s == "-infinity" || s == "-inf" ) { return boost::posix_time::neg_infin; }
     else
     {
-        try { return boost::posix_time::from_iso_string( s ); }
+        try { boost::posix_time::ptime t; ascii_cast< boost::posix_time::ptime >::from( t, &s[0], &s[0] + s.size() ); return t; }
         catch ( ... ) { return boost::posix_time::not_a_date_time; }
     }
     return boost::posix_time::not_a_date_time;
@@ -213,14 +204,16 @@ static std::size_t csv_to_bin( char* buf, const std::string& s, format::types_en
         {
             case format::int8:
             {
-                int i = boost::lexical_cast< int >( s );
+                int i;
+                ascii_cast< int >::from( i, &s[0], &s[0] + s.size() );
                 if( i < -128 || i > 127 ) { COMMA_THROW( comma::exception, "expected byte, got " << i ); }
                 *buf = static_cast< signed char >( i );
                 return sizeof( signed char );
             }
             case format::uint8:
             {
-                unsigned int i = boost::lexical_cast< unsigned int >( s );
+                unsigned int i;
+                ascii_cast< unsigned int >::from( i, &s[0], &s[0] + s.size() );
                 if( i > 255 ) { COMMA_THROW( comma::exception, "expected unsigned byte, got " << i ); }
                 //unsigned char c = static_cast< unsigned char >( i );
                 //::memcpy( buf, &c, 1 );
@@ -233,7 +226,7 @@ static std::size_t csv_to_bin( char* buf, const std::string& s, format::types_en
             case format::uint32: return csv_to_bin< comma::uint32 >( buf, s );
             case format::int64: return csv_to_bin< comma::int64 >( buf, s );
             case format::uint64: return csv_to_bin< comma::uint64 >( buf, s );
-            case format::char_t: return csv_to_bin< char >( buf, s );
+            case format::char_t: *buf = boost::lexical_cast< char >( s ); return sizeof( char ); // a character, not a number
             case format::float_t: return csv_to_bin< float >( buf, s );
             case format::double_t: return csv_to_bin< double >( buf, s );
             case format::time: // TODO: quick and dirty: use serialization traits
@@ -262,33 +255,31 @@ static std::size_t csv_to_bin( char* buf, const std::string& s, format::types_en
     catch( ... ) { throw; }
 }
 
-static std::size_t bin_to_csv( std::ostringstream& oss, const char* buf, format::types_enum type, std::size_t size, const boost::optional< unsigned int >& precision )
+static std::size_t bin_to_csv( std::string& s, const char* buf, format::types_enum type, std::size_t size, const boost::optional< unsigned int >& precision )
 {
+    static const boost::optional< unsigned int > float_precision( 6 ); // default precisions, as before
+    static const boost::optional< unsigned int > double_precision( 16 );
     switch( type ) // todo: tear down bin_to_csv, use format::traits
     {
-        case format::int8:
-            oss << static_cast< int >( static_cast< signed char >( *buf ));
-            return sizeof( char );
-        case format::uint8:
-            oss << static_cast< unsigned int >( static_cast< unsigned char >( *buf ) );
-            return sizeof( unsigned char );
-        case format::int16: return bin_to_csv< comma::int16 >( oss, buf, precision );
-        case format::uint16: return bin_to_csv< comma::uint16 >( oss, buf, precision );
-        case format::int32: return bin_to_csv< comma::int32 >( oss, buf, precision );
-        case format::uint32: return bin_to_csv< comma::uint32 >( oss, buf, precision );
-        case format::int64: return bin_to_csv< comma::int64 >( oss, buf, precision );
-        case format::uint64: return bin_to_csv< comma::uint64 >( oss, buf, precision );
-        case format::char_t: return bin_to_csv< char >( oss, buf, precision );
-        case format::float_t: return bin_to_csv< float >( oss, buf, precision );
-        case format::double_t: return bin_to_csv< double >( oss, buf, precision );
+        case format::int8: append< int >( s, static_cast< signed char >( *buf ), precision ); return sizeof( char );
+        case format::uint8: append< unsigned int >( s, static_cast< unsigned char >( *buf ), precision ); return sizeof( unsigned char );
+        case format::int16: return bin_to_csv< comma::int16 >( s, buf, precision );
+        case format::uint16: return bin_to_csv< comma::uint16 >( s, buf, precision );
+        case format::int32: return bin_to_csv< comma::int32 >( s, buf, precision );
+        case format::uint32: return bin_to_csv< comma::uint32 >( s, buf, precision );
+        case format::int64: return bin_to_csv< comma::int64 >( s, buf, precision );
+        case format::uint64: return bin_to_csv< comma::uint64 >( s, buf, precision );
+        case format::char_t: s += *buf; return sizeof( char ); // a character, not a number
+        case format::float_t: return bin_to_csv< float >( s, buf, precision ? precision : float_precision );
+        case format::double_t: return bin_to_csv< double >( s, buf, precision ? precision : double_precision );
         case format::time:
-            oss << boost::posix_time::to_iso_string( format::traits< boost::posix_time::ptime, format::time >::from_bin( buf, sizeof( comma::uint64 ) ) );
+            append( s, format::traits< boost::posix_time::ptime, format::time >::from_bin( buf, sizeof( comma::uint64 ) ), boost::none );
             return format::traits< boost::posix_time::ptime, format::time >::size;
         case format::long_time:
-            oss << boost::posix_time::to_iso_string( format::traits< boost::posix_time::ptime, format::long_time >::from_bin( buf, sizeof( comma::uint64 ) + sizeof( comma::uint32 ) ) );
+            append( s, format::traits< boost::posix_time::ptime, format::long_time >::from_bin( buf, sizeof( comma::uint64 ) + sizeof( comma::uint32 ) ), boost::none );
             return format::traits< boost::posix_time::ptime, format::long_time >::size;
         case format::fixed_string:
-            oss << ( buf[ size - 1 ] == 0 ? std::string( buf ) : std::string( buf, size ) );
+            if( buf[ size - 1 ] == 0 ) { s += buf; } else { s.append( buf, size ); }
             return size;
         default : COMMA_THROW( comma::exception, "on type: " << type << ": todo: not implemented" );
     }
@@ -347,17 +338,17 @@ std::string format::bin_to_csv( const std::string& bin, char delimiter, const bo
 
 std::string format::bin_to_csv( const char* buf, char delimiter, const boost::optional< unsigned int >& precision ) const
 {
-    std::ostringstream oss;
+    std::string s;
     const char* p = buf;
     unsigned int offsetIndex = 0u; // index in elements_
     unsigned int count = 0u;
     for( unsigned int i = 0u; i < count_; ++i, ++count )
     {
-        if( i > 0 ) { oss << delimiter; }
+        if( i > 0 ) { s += delimiter; }
         if( count >= elements_[ offsetIndex ].count ) { count = 0; ++offsetIndex; }
-        p += impl::bin_to_csv( oss, p, elements_[ offsetIndex ].type, elements_[ offsetIndex ].size, precision );
+        p += impl::bin_to_csv( s, p, elements_[ offsetIndex ].type, elements_[ offsetIndex ].size, precision );
     }
-    return oss.str();
+    return s;
 }
 
 const std::vector< format::element >& format::elements() const { return elements_; }
@@ -0,0 +1,78 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#include "ascii_cast.h"
+
+namespace comma { namespace csv { namespace impl {
+
+static bool digits_( const char* begin, const char* end )
+{
+    for( const char* p = begin; p < end; ++p ) { if( *p < '0' || *p > '9' ) { return false; } }
+    return true;
+}
+
+static unsigned int number_( const char* begin, const char* end )
+{
+    unsigned int n = 0;
+    for( const char* p = begin; p < end; ++p ) { n = n * 10 + ( *p - '0' ); }
+    return n;
+}
+
+static bool from_iso_string_( boost::posix_time::ptime& t, const char* begin, const char* end )
+{
+    if( end - begin < 15 || begin[8] != 'T' || !digits_( begin, begin + 8 ) || !digits_( begin + 9, begin + 15 ) ) { return false; }
+    unsigned int hours = number_( begin + 9, begin + 11 );
+    unsigned int minutes = number_( begin + 11, begin + 13 );
+    unsigned int seconds = number_( begin + 13, begin + 15 );
+    if( hours > 23 || minutes > 59 || seconds > 59 ) { return false; }
+    boost::int64_t fractional = 0;
+    const char* p = begin + 15;
+    if( p < end )
+    {
+        if( *p != '.' || p + 1 == end || !digits_( p + 1, end ) ) { return false; }
+        const int resolution = boost::posix_time::time_duration::num_fractional_digits();
+        int n = 0;
+        for( ++p; p < end && n < resolution; ++p, ++n ) { fractional = fractional * 10 + ( *p - '0' ); } // excess digits truncated, as in boost
+        for( ; n < resolution; ++n ) { fractional *= 10; }
+    }
+    try
+    {
+        boost::gregorian::date d( number_( begin, begin + 4 ), number_( begin + 4, begin + 6 ), number_( begin + 6, begin + 8 ) );
+        t = boost::posix_time::ptime( d, boost::posix_time::time_duration( hours, minutes, seconds, fractional ) );
+        return true;
+    }
+    catch( ... ) { return false; } // e.g. invalid day of month: let boost decide what to do
+}
+
+void ascii_cast< boost::posix_time::ptime >::from( boost::posix_time::ptime& t, const char* begin, const char* end )
+{
+    if( !from_iso_string_( t, begin, end ) ) { t = boost::posix_time::from_iso_string( std::string( begin, end ) ); }
+}
+
+static char* put_( char* p, unsigned int n, unsigned int width )
+{
+    for( unsigned int i = width; i > 0; --i, n /= 10 ) { p[ i - 1 ] = '0' + n % 10; }
+    return p + width;
+}
+
+void ascii_cast< boost::posix_time::ptime >::to( std::string& s, const boost::posix_time::ptime& t, const boost::optional< unsigned int >& )
+{
+    if( t.is_special() ) { s = boost::posix_time::to_iso_string( t ); return; }
+    const auto& ymd = t.date().year_month_day();
+    const auto& d = t.time_of_day();
+    char buf[64];
+    char* p = put_( buf, ymd.year, 4 );
+    p = put_( p, ymd.month, 2 );
+    p = put_( p, ymd.day, 2 );
+    *p++ = 'T';
+    p = put_( p, d.hours(), 2 );
+    p = put_( p, d.minutes(), 2 );
+    p = put_( p, d.seconds(), 2 );
+    if( d.fractional_seconds() != 0 )
+    {
+        *p++ = '.';
+        p = put_( p, d.fractional_seconds(), boost::posix_time::time_duration::num_fractional_digits() );
+    }
+    s.assign( buf, p );
+}
+
+} } } // namespace comma { namespace csv { namespace impl {
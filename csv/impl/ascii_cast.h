@@ -0,0 +1,95 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#pragma once
+
+#if __cplusplus >= 201703L && defined( __has_include )
+#if __has_include( <charconv> )
+#include <charconv>
+#endif
+#endif
+
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/optional.hpp>
+
+namespace comma { namespace csv { namespace impl {
+
+/// conversions between ascii and values used by csv::ascii, csv::format, etc
+///
+/// default implementation for arithmetic types uses std::from_chars/std::to_chars, if available;
+/// anything not recognised by the fast path (e.g. leading '+' or whitespace) falls back
+/// to boost::lexical_cast, so that the accepted input and the errors are the same as before
+///
+/// to plug in a custom conversion for a type, specialise ascii_cast for it
+///
+/// output with precision is the same as std::ostream output with the same precision;
+/// precision 0 means the shortest representation that reads back to exactly the same value
+template < typename T, typename Enable = void > struct ascii_cast
+{
+    static void from( T& v, const char* begin, const char* end ) { v = boost::lexical_cast< T >( begin, end - begin ); }
+
+    static void to( std::string& s, const T& v, const boost::optional< unsigned int >& precision )
+    {
+        std::ostringstream oss;
+        if( precision ) { oss.precision( *precision ); }
+        oss << v;
+        s = oss.str();
+    }
+};
+
+template < typename T > struct ascii_cast< T, typename std::enable_if< std::is_arithmetic< T >::value && !std::is_same< T, bool >::value >::type >
+{
+    static void from( T& v, const char* begin, const char* end )
+    {
+        #ifdef __cpp_lib_to_chars
+        auto r = std::from_chars( begin, end, v );
+        if( r.ec == std::errc() && r.ptr == end ) { return; }
+        #endif
+        v = boost::lexical_cast< T >( begin, end - begin );
+    }
+
+    static void to( std::string& s, const T& v, const boost::optional< unsigned int >& precision )
+    {
+        #ifdef __cpp_lib_to_chars
+        char buf[128];
+        std::to_chars_result r{ nullptr, std::errc::value_too_large };
+        if constexpr( std::is_floating_point< T >::value )
+        {
+            if( !precision ) { r = std::to_chars( buf, buf + sizeof( buf ), v, std::chars_format::general, 6 ); }
+            else if( *precision == 0 ) { r = std::to_chars( buf, buf + sizeof( buf ), v ); }
+            else if( *precision < 64 ) { r = std::to_chars( buf, buf + sizeof( buf ), v, std::chars_format::general, *precision ); }
+        }
+        else
+        {
+            r = std::to_chars( buf, buf + sizeof( buf ), v );
+        }
+        if( r.ec == std::errc() ) { s.assign( buf, r.ptr ); return; }
+        #endif
+        std::ostringstream oss;
+        if( precision ) { oss.precision( *precision ); }
+        oss << v;
+        s = oss.str();
+    }
+};
+
+template <> struct ascii_cast< bool >
+{
+    static void from( bool& v, const char* begin, const char* end ) { unsigned int i; ascii_cast< unsigned int >::from( i, begin, end ); v = static_cast< bool >( i ); }
+
+    static void to( std::string& s, bool v, const boost::optional< unsigned int >& ) { s.assign( 1, v ? '1' : '0' ); }
+};
+
+/// time in iso format, e.g. 20240101T102030.123456
+/// parsing: fast path for yyyymmddThhmmss[.f...], anything else as boost::posix_time::from_iso_string()
+/// output: same as boost::posix_time::to_iso_string()
+template <> struct ascii_cast< boost::posix_time::ptime >
+{
+    static void from( boost::posix_time::ptime& t, const char* begin, const char* end );
+
+    static void to( std::string& s, const boost::posix_time::ptime& t, const boost::optional< unsigned int >& precision = boost::none );
+};
+
+} } } // namespace comma { namespace csv { namespace impl {
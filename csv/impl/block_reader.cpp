@@ -0,0 +1,131 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#ifndef WIN32
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cstdint>
+#include "../../base/exception.h"
+#include "block_reader.h"
+#include "mapped_file.h"
+
+namespace comma { namespace csv { namespace impl {
+
+namespace {
+
+struct streambuf_access : public std::streambuf
+{
+    /// return number of bytes already in stream buffer, i.e. without touching the underlying file
+    static std::size_t buffered( const std::streambuf* b )
+    {
+        auto gptr = &streambuf_access::gptr;
+        auto egptr = &streambuf_access::egptr;
+        return ( b->*egptr )() - ( b->*gptr )();
+    }
+};
+
+} // namespace {
+
+block_reader::block_reader( std::istream& is, std::size_t record_size, std::size_t capacity, bool mmap )
+    : is_( is )
+    , record_size_( record_size )
+    , capacity_( capacity > 0 ? capacity : record_size >= 65536 ? 1 : 65536 / record_size )
+    , buffer_( capacity_ * record_size_ + alignment )
+    , begin_( &buffer_[0] + ( alignment - reinterpret_cast< std::uintptr_t >( &buffer_[0] ) % alignment ) % alignment )
+    , size_( 0 )
+    #ifdef WIN32
+    , fd_( -1 )
+    #else
+    , fd_( &is == &std::cin ? 0 : -1 )
+    #endif
+    , offset_( 0 )
+    , advised_( 0 )
+{
+    if( record_size_ == 0 ) { COMMA_THROW( comma::exception, "expected non-zero record size" ); }
+    #ifndef WIN32
+    if( !mmap || fd_ < 0 || streambuf_access::buffered( is_.rdbuf() ) != 0 || !mapped_file::mappable( fd_ ) ) { return; }
+    off_t offset = ::lseek( fd_, 0, SEEK_CUR );
+    if( offset < 0 ) { return; }
+    mapped_.reset( new mapped_file( fd_ ) );
+    if( mapped_->size() == 0 ) { mapped_.reset(); return; } // e.g. empty or not telling its size (as files in /proc), read as a stream
+    offset_ = advised_ = std::min( std::size_t( offset ), mapped_->size() );
+    mapped_->sequential();
+    #endif
+}
+
+block_reader::~block_reader() {}
+
+std::size_t block_reader::remaining() const { return mapped_ ? mapped_->size() - offset_ : 0; }
+
+std::size_t block_reader::read( std::size_t size )
+{
+    if( size > capacity_ ) { size = capacity_; }
+    if( size == 0 ) { size_ = 0; return 0; }
+    size_ = mapped_ ? read_mapped_( size ) : fd_ >= 0 && streambuf_access::buffered( is_.rdbuf() ) == 0 ? read_fd_( size ) : read_stream_( size );
+    return size_;
+}
+
+std::size_t block_reader::read_mapped_( std::size_t size )
+{
+    #ifdef WIN32
+    return 0;
+    #else
+    static const std::size_t window = 1 << 23; // quick and dirty: read ahead in large chunks, since sequential advice alone does not always keep up
+    std::size_t count = std::min( size, remaining() / record_size_ );
+    if( count == 0 )
+    {
+        is_.setstate( std::ios::eofbit );
+        if( remaining() == 0 ) { return 0; }
+        COMMA_THROW( comma::exception, "expected " << record_size_ << " bytes; got " << remaining() );
+    }
+    begin_ = const_cast< char* >( mapped_->data() ) + offset_;
+    offset_ += count * record_size_;
+    if( offset_ + window / 2 > advised_ && advised_ < mapped_->size() ) { mapped_->will_need( advised_, window ); advised_ += window; }
+    if( ::lseek( fd_, offset_, SEEK_SET ) < 0 ) { COMMA_THROW( comma::exception, "failed to seek stdin: " << ::strerror( errno ) ); } // keep stdin consistent for direct reads
+    return count;
+    #endif
+}
+
+std::size_t block_reader::read_fd_( std::size_t size )
+{
+    #ifdef WIN32
+    return read_stream_( size );
+    #else
+    std::size_t wanted = size * record_size_;
+    std::size_t count = 0;
+    while( count == 0 || count % record_size_ != 0 ) // block only until the first complete record or end of the partial one
+    {
+        ssize_t r = ::read( fd_, begin_ + count, wanted - count );
+        if( r < 0 )
+        {
+            if( errno == EINTR ) { continue; }
+            COMMA_THROW( comma::exception, "failed to read from stdin: " << ::strerror( errno ) );
+        }
+        if( r == 0 )
+        {
+            is_.setstate( std::ios::eofbit );
+            if( count == 0 ) { return 0; }
+            COMMA_THROW( comma::exception, "expected " << record_size_ << " bytes; got " << count % record_size_ );
+        }
+        count += r;
+    }
+    return count / record_size_;
+    #endif
+}
+
+std::size_t block_reader::read_stream_( std::size_t size )
+{
+    is_.read( begin_, record_size_ );
+    if( is_.gcount() == 0 ) { return 0; }
+    if( is_.gcount() != std::streamsize( record_size_ ) ) { COMMA_THROW( comma::exception, "expected " << record_size_ << " bytes; got " << is_.gcount() ); }
+    std::streamsize available = is_.rdbuf()->in_avail(); // will not block
+    if( available < std::streamsize( record_size_ ) || size == 1 ) { return 1; }
+    std::size_t n = std::min( size - 1, std::size_t( available ) / record_size_ );
+    is_.read( begin_ + record_size_, n * record_size_ );
+    if( is_.gcount() % record_size_ != 0 ) { COMMA_THROW( comma::exception, "expected " << record_size_ << " bytes; got " << is_.gcount() % record_size_ ); }
+    return 1 + is_.gcount() / record_size_;
+}
+
+} } } // namespace comma { namespace csv { namespace impl {
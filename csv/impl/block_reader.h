@@ -0,0 +1,81 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+
+namespace comma { namespace csv { namespace impl {
+
+class mapped_file;
+
+/// reads fixed-size binary records in batches into a reusable aligned buffer
+///
+/// if the stream is std::cin and nothing is buffered in std::cin, reads straight from
+/// file descriptor 0 with a single ::read() per batch, otherwise reads through std::istream
+///
+/// never waits for more data than one complete record, i.e. on live streams
+/// a batch contains whatever complete records are available, which keeps latency low;
+/// no bytes are kept between the calls, thus the stream can still be read directly
+/// (e.g. by binary_input_stream::read()) between the batches
+///
+/// if mmap is requested and the stream is std::cin redirected from a regular file, the file
+/// is memory-mapped and records of a batch point straight into the mapping, i.e. are not copied;
+/// stdin position is still moved past each batch, records are aligned only as the file layout
+/// allows; otherwise, mmap is silently ignored
+class block_reader
+{
+    public:
+        /// alignment of the buffer and, for record sizes multiple of it, of each record
+        static const std::size_t alignment = 64;
+
+        /// constructor
+        /// @param capacity maximum number of records in a batch; if 0, choose a reasonable default
+        /// @param mmap if possible, read records from memory-mapped stdin
+        block_reader( std::istream& is, std::size_t record_size, std::size_t capacity = 0, bool mmap = false );
+
+        ~block_reader();
+
+        /// read up to size records (no more than capacity); return number of records read, 0 on end of stream
+        /// throws on incomplete record at the end of stream
+        std::size_t read( std::size_t size );
+
+        /// read up to capacity records
+        std::size_t read() { return read( capacity_ ); }
+
+        /// return i-th record of the last batch
+        const char* record( std::size_t i ) const { return begin_ + i * record_size_; }
+
+        /// return number of records in the last batch
+        std::size_t size() const { return size_; }
+
+        /// return record size in bytes
+        std::size_t record_size() const { return record_size_; }
+
+        /// return maximum number of records in a batch
+        std::size_t capacity() const { return capacity_; }
+
+        /// return true, if records are read from memory-mapped stdin
+        bool mapped() const { return bool( mapped_ ); }
+
+        /// return number of bytes left in memory-mapped stdin, 0 if not mapped
+        std::size_t remaining() const;
+
+    private:
+        std::istream& is_;
+        std::size_t record_size_;
+        std::size_t capacity_;
+        std::vector< char > buffer_;
+        char* begin_;
+        std::size_t size_;
+        int fd_;
+        boost::scoped_ptr< mapped_file > mapped_;
+        std::size_t offset_; // current position in mapped file
+        std::size_t advised_; // end of the mapped region already advised to be read ahead
+        std::size_t read_fd_( std::size_t size );
+        std::size_t read_mapped_( std::size_t size );
+        std::size_t read_stream_( std::size_t size );
+};
+
+} } } // namespace comma { namespace csv { namespace impl {
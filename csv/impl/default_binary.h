@@ -0,0 +1,117 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#pragma once
+
+#include <string>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/optional.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/type_traits.hpp>
+#include "../../csv/format.h"
+#include "../../visiting/visit.h"
+#include "../../visiting/while.h"
+
+namespace comma { namespace csv { namespace impl {
+
+/// binary (de)serialisation of a struct with default fields and default format
+///
+/// the fields are packed one after another in the visiting order with their default
+/// binary types, so the offsets do not need to be looked up at run time: once inlined,
+/// get() and put() become straight-line sequences of fixed-offset loads and stores
+///
+/// only layouts without strings, optional or pointer members and without types whose
+/// default binary size differs from their size in memory (e.g. long double) qualify;
+/// use default_binary::fits() to check it
+class default_binary
+{
+    public:
+        /// return true, if sample qualifies and its default binary size is format_size
+        template < typename S > static bool fits( const S& sample, std::size_t format_size );
+
+        /// return true, if sample qualifies and its binary layout is exactly its layout in memory, i.e. it can be simply copied
+        template < typename S > static bool same_as_memory( const S& sample );
+
+        /// get value from buffer
+        template < typename S > static void get( S& s, const char* buf ) { from f( buf ); visiting::apply( f, s ); }
+
+        /// put value in buffer
+        template < typename S > static void put( const S& s, char* buf ) { to t( buf ); visiting::apply( t, s ); }
+
+    private:
+        template < typename T > struct is_final { static const bool value = boost::is_fundamental< T >::value || boost::is_same< T, std::string >::value || boost::is_same< T, boost::posix_time::ptime >::value; };
+
+        class size
+        {
+            public:
+                size( const char* base = nullptr ) : base_( base ), size_( 0 ), fits_( true ), same_as_memory_( true ) {}
+                template < typename K, typename T > void apply( const K&, const boost::optional< T >& ) { fits_ = false; }
+                template < typename K, typename T > void apply( const K&, const boost::scoped_ptr< T >& ) { fits_ = false; }
+                template < typename K, typename T > void apply( const K&, const boost::shared_ptr< T >& ) { fits_ = false; }
+                template < typename K, typename T > void apply( const K& name, const T& value ) { visiting::do_while< !is_final< T >::value >::visit( name, value, *this ); }
+                template < typename K, typename T > void apply_next( const K& name, const T& value ) { visiting::visit( name, value, *this ); }
+                template < typename K > void apply_final( const K&, const std::string& ) { fits_ = false; }
+                template < typename K, typename T > void apply_final( const K&, const T& value )
+                {
+                    if( format::traits< T >::size != format::size_of( format::traits< T >::type ) ) { fits_ = false; }
+                    if( reinterpret_cast< const char* >( &value ) != base_ + size_ ) { same_as_memory_ = false; }
+                    size_ += format::traits< T >::size;
+                }
+                std::size_t operator()() const { return fits_ ? size_ : 0; }
+                bool same_as_memory() const { return fits_ && same_as_memory_; }
+
+            private:
+                const char* base_;
+                std::size_t size_;
+                bool fits_;
+                bool same_as_memory_;
+        };
+
+        class from
+        {
+            public:
+                from( const char* buf ) : buf_( buf ) {}
+                template < typename K, typename T > void apply( const K&, boost::optional< T >& ) {} // never called, since optional members do not fit
+                template < typename K, typename T > void apply( const K&, boost::scoped_ptr< T >& ) {}
+                template < typename K, typename T > void apply( const K&, boost::shared_ptr< T >& ) {}
+                template < typename K, typename T > void apply( const K& name, T& value ) { visiting::do_while< !is_final< T >::value >::visit( name, value, *this ); }
+                template < typename K, typename T > void apply_next( const K& name, T& value ) { visiting::visit( name, value, *this ); }
+                template < typename K > void apply_final( const K&, std::string& ) {} // never called, since strings do not fit
+                template < typename K, typename T > void apply_final( const K&, T& value ) { value = format::traits< T >::from_bin( buf_ ); buf_ += format::traits< T >::size; }
+
+            private:
+                const char* buf_;
+        };
+
+        class to
+        {
+            public:
+                to( char* buf ) : buf_( buf ) {}
+                template < typename K, typename T > void apply( const K&, const boost::optional< T >& ) {} // never called, since optional members do not fit
+                template < typename K, typename T > void apply( const K&, const boost::scoped_ptr< T >& ) {}
+                template < typename K, typename T > void apply( const K&, const boost::shared_ptr< T >& ) {}
+                template < typename K, typename T > void apply( const K& name, const T& value ) { visiting::do_while< !is_final< T >::value >::visit( name, value, *this ); }
+                template < typename K, typename T > void apply_next( const K& name, const T& value ) { visiting::visit( name, value, *this ); }
+                template < typename K > void apply_final( const K&, const std::string& ) {} // never called, since strings do not fit
+                template < typename K, typename T > void apply_final( const K&, const T& value ) { format::traits< T >::to_bin( value, buf_ ); buf_ += format::traits< T >::size; }
+
+            private:
+                char* buf_;
+        };
+};
+
+template < typename S > inline bool default_binary::fits( const S& sample, std::size_t format_size )
+{
+    size v;
+    visiting::apply( v, sample );
+    return format_size > 0 && v() == format_size;
+}
+
+template < typename S > inline bool default_binary::same_as_memory( const S& sample )
+{
+    size v( reinterpret_cast< const char* >( &sample ) );
+    visiting::apply( v, sample );
+    return v.same_as_memory() && v() == sizeof( S );
+}
+
+} } } // namespace comma { namespace csv { namespace impl {
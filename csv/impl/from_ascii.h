@@ -45,6 +45,7 @@
 #include "../../string/string.h"
 #include "../../visiting/visit.h"
 #include "../../visiting/while.h"
+#include "ascii_cast.h"
 
 namespace comma { namespace csv { namespace impl {
 
@@ -82,15 +83,15 @@ class from_ascii_
         const std::vector< std::string >& row_;
         std::size_t index_;
         std::size_t optional_index;
-        static void lexical_cast_( char& v, const std::string& s ) { v = s.at( 0 ) == '\'' && s.at( 2 ) == '\'' && s.length() == 3 ? s.at( 1 ) : static_cast< char >( boost::lexical_cast< int >( s ) ); }
-        static void lexical_cast_( signed char& v, const std::string& s ) { v = s.at( 0 ) == '\'' && s.at( 2 ) == '\'' && s.length() == 3 ? s.at( 1 ) : static_cast< signed char >( boost::lexical_cast< int >( s ) ); }
-        static void lexical_cast_( unsigned char& v, const std::string& s ) { v = s.at( 0 ) == '\'' && s.at( 2 ) == '\'' && s.length() == 3 ? s.at( 1 ) : static_cast< unsigned char >( boost::lexical_cast< unsigned int >( s ) ); }
+        static void lexical_cast_( char& v, const std::string& s ) { v = s.at( 0 ) == '\'' && s.at( 2 ) == '\'' && s.length() == 3 ? s.at( 1 ) : static_cast< char >( cast_< int >( s ) ); }
+        static void lexical_cast_( signed char& v, const std::string& s ) { v = s.at( 0 ) == '\'' && s.at( 2 ) == '\'' && s.length() == 3 ? s.at( 1 ) : static_cast< signed char >( cast_< int >( s ) ); }
+        static void lexical_cast_( unsigned char& v, const std::string& s ) { v = s.at( 0 ) == '\'' && s.at( 2 ) == '\'' && s.length() == 3 ? s.at( 1 ) : static_cast< unsigned char >( cast_< unsigned int >( s ) ); }
         static void lexical_cast_( boost::posix_time::ptime& v, const std::string& s )
         { 
             if( s.empty() ) { return; }
             try
             { 
-                v = boost::posix_time::from_iso_string( s );
+                ascii_cast< boost::posix_time::ptime >::from( v, &s[0], &s[0] + s.size() );
             }
             catch( ... )
             {
@@ -100,9 +101,10 @@ class from_ascii_
             }
         }
         static void lexical_cast_( std::string& v, const std::string& s ) { v = comma::strip( s, "\"" ); }
-        static void lexical_cast_( bool& v, const std::string& s ) { if( s.empty() ) { return; } v = static_cast< bool >( boost::lexical_cast< unsigned int >( s ) ); }
         template < typename T >
-        static void lexical_cast_( T& v, const std::string& s ) { if( s.empty() ) { return; } v = boost::lexical_cast< T >( s ); }
+        static void lexical_cast_( T& v, const std::string& s ) { if( s.empty() ) { return; } ascii_cast< T >::from( v, &s[0], &s[0] + s.size() ); }
+        template < typename T >
+        static T cast_( const std::string& s ) { T t; ascii_cast< T >::from( t, &s[0], &s[0] + s.size() ); return t; }
 };
 
 inline from_ascii_::from_ascii_( const std::vector< boost::optional< std::size_t > >& indices
@@ -0,0 +1,80 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#pragma once
+
+#include <cstring>
+#include <vector>
+
+namespace comma { namespace csv { namespace impl {
+
+/// precomputed plan to gather fields of fixed-size binary records into new records,
+/// e.g. to cut, reorder, or duplicate fields
+///
+/// fields are added in output order; fields adjacent both in input and output are
+/// coalesced into a single run, thus e.g. cutting a few leading fields becomes a single copy
+///
+/// apply() copies a batch of records run by run rather than record by record: for each run
+/// it is a tight strided loop; runs of common field sizes (1, 2, 4, 8, 12, 16, 24 bytes, i.e.
+/// also 3f and 3d) are copied with fixed-size loads and stores, since std::memcpy of a
+/// constant size compiles into one or two moves
+class gather
+{
+    public:
+        struct run
+        {
+            std::size_t from; // offset in input record
+            std::size_t to; // offset in output record
+            std::size_t size;
+        };
+
+        /// append field of given offset and size in input record to output record
+        void add( std::size_t offset, std::size_t size );
+
+        /// return output record size
+        std::size_t size() const { return size_; }
+
+        /// return runs
+        const std::vector< run >& runs() const { return runs_; }
+
+        /// gather count input records of input_size bytes each into contiguous output records of size() bytes
+        void apply( const char* input, std::size_t input_size, std::size_t count, char* output ) const;
+
+    private:
+        std::vector< run > runs_;
+        std::size_t size_{0};
+        template < std::size_t N > static void copy_( const char* input, std::size_t input_size, std::size_t count, char* output, std::size_t output_size )
+        {
+            for( std::size_t i = 0; i < count; ++i, input += input_size, output += output_size ) { std::memcpy( output, input, N ); }
+        }
+};
+
+inline void gather::add( std::size_t offset, std::size_t size )
+{
+    if( size == 0 ) { return; }
+    if( !runs_.empty() && runs_.back().from + runs_.back().size == offset ) { runs_.back().size += size; } // output is always contiguous
+    else { runs_.push_back( run{ offset, size_, size } ); }
+    size_ += size;
+}
+
+inline void gather::apply( const char* input, std::size_t input_size, std::size_t count, char* output ) const
+{
+    if( runs_.size() == 1 && runs_[0].from == 0 && runs_[0].size == input_size ) { std::memcpy( output, input, count * input_size ); return; }
+    for( const auto& r: runs_ )
+    {
+        const char* in = input + r.from;
+        char* out = output + r.to;
+        switch( r.size )
+        {
+            case 1: copy_< 1 >( in, input_size, count, out, size_ ); break;
+            case 2: copy_< 2 >( in, input_size, count, out, size_ ); break;
+            case 4: copy_< 4 >( in, input_size, count, out, size_ ); break;
+            case 8: copy_< 8 >( in, input_size, count, out, size_ ); break;
+            case 12: copy_< 12 >( in, input_size, count, out, size_ ); break;
+            case 16: copy_< 16 >( in, input_size, count, out, size_ ); break;
+            case 24: copy_< 24 >( in, input_size, count, out, size_ ); break;
+            default: for( std::size_t i = 0; i < count; ++i ) { std::memcpy( out + i * size_, in + i * input_size, r.size ); } break;
+        }
+    }
+}
+
+} } } // namespace comma { namespace csv { namespace impl {
@@ -0,0 +1,94 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include "../../base/exception.h"
+#include "mapped_file.h"
+
+namespace comma { namespace csv { namespace impl {
+
+mapped_file::mapped_file( const std::string& filename ) : data_( nullptr ), size_( 0 )
+{
+    #ifdef WIN32
+    COMMA_THROW( comma::exception, "mapped file: not implemented on windows" );
+    #else
+    int fd = ::open( filename.c_str(), O_RDONLY );
+    if( fd < 0 ) { COMMA_THROW( comma::exception, "failed to open \"" << filename << "\": " << ::strerror( errno ) ); }
+    try { map_( fd, "\"" + filename + "\"" ); }
+    catch( ... ) { ::close( fd ); throw; }
+    ::close( fd ); // mapping stays valid
+    #endif
+}
+
+mapped_file::mapped_file( int fd ) : data_( nullptr ), size_( 0 )
+{
+    #ifdef WIN32
+    COMMA_THROW( comma::exception, "mapped file: not implemented on windows" );
+    #else
+    map_( fd, "file descriptor " + std::to_string( fd ) );
+    #endif
+}
+
+mapped_file::~mapped_file()
+{
+    #ifndef WIN32
+    if( data_ ) { ::munmap( const_cast< char* >( data_ ), size_ ); }
+    #endif
+}
+
+void mapped_file::map_( int fd, const std::string& name )
+{
+    #ifndef WIN32
+    struct stat s;
+    if( ::fstat( fd, &s ) != 0 ) { COMMA_THROW( comma::exception, "failed to stat " << name << ": " << ::strerror( errno ) ); }
+    if( !S_ISREG( s.st_mode ) ) { COMMA_THROW( comma::exception, "expected regular file, got " << name ); }
+    if( s.st_size == 0 ) { return; }
+    void* p = ::mmap( nullptr, s.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    if( p == MAP_FAILED ) { COMMA_THROW( comma::exception, "failed to map " << name << ": " << ::strerror( errno ) ); }
+    data_ = static_cast< const char* >( p );
+    size_ = s.st_size;
+    #endif
+}
+
+void mapped_file::random() const
+{
+    #ifndef WIN32
+    if( data_ ) { ::madvise( const_cast< char* >( data_ ), size_, MADV_RANDOM ); }
+    #endif
+}
+
+void mapped_file::sequential() const
+{
+    #ifndef WIN32
+    if( data_ ) { ::madvise( const_cast< char* >( data_ ), size_, MADV_SEQUENTIAL ); }
+    #endif
+}
+
+void mapped_file::will_need( std::size_t offset, std::size_t size ) const
+{
+    #ifndef WIN32
+    if( offset >= size_ ) { return; }
+    static const std::size_t page = ::sysconf( _SC_PAGESIZE );
+    std::size_t begin = offset - offset % page; // madvise needs page-aligned address
+    ::madvise( const_cast< char* >( data_ ) + begin, std::min( size + offset - begin, size_ - begin ), MADV_WILLNEED );
+    #endif
+}
+
+bool mapped_file::mappable( int fd )
+{
+    #ifdef WIN32
+    return false;
+    #else
+    struct stat s;
+    return ::fstat( fd, &s ) == 0 && S_ISREG( s.st_mode );
+    #endif
+}
+
+} } } // namespace comma { namespace csv { namespace impl {
@@ -0,0 +1,49 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#pragma once
+
+#include <string>
+#include <boost/noncopyable.hpp>
+
+namespace comma { namespace csv { namespace impl {
+
+/// read-only memory mapping of a whole regular file
+///
+/// used to access large recorded files randomly (e.g. to binary-search a sorted key)
+/// without reading them; an empty file maps to data() == nullptr and size() == 0
+class mapped_file : public boost::noncopyable
+{
+    public:
+        /// map file by name
+        mapped_file( const std::string& filename );
+
+        /// map file open as file descriptor fd; the descriptor is not closed or moved
+        explicit mapped_file( int fd );
+
+        ~mapped_file();
+
+        /// return pointer to the beginning of the file
+        const char* data() const { return data_; }
+
+        /// return file size in bytes
+        std::size_t size() const { return size_; }
+
+        /// advise the kernel that mapped pages will be accessed randomly, i.e. not to read ahead
+        void random() const;
+
+        /// advise the kernel that mapped pages will be accessed sequentially, i.e. to read ahead aggressively
+        void sequential() const;
+
+        /// advise the kernel that given region will be accessed soon, i.e. to start reading it in
+        void will_need( std::size_t offset, std::size_t size ) const;
+
+        /// return true, if fd is a regular file, i.e. can be mapped and seeked
+        static bool mappable( int fd );
+
+    private:
+        const char* data_;
+        std::size_t size_;
+        void map_( int fd, const std::string& name );
+};
+
+} } } // namespace comma { namespace csv { namespace impl {
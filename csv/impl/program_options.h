@@ -57,7 +57,8 @@ inline boost::program_options::options_description program_options::description(
         ( "delimiter,d", boost::program_options::value< char >()->default_value( ',' ), "csv delimiter" )
         ( "precision", boost::program_options::value< unsigned int >()->default_value( 12 ), "floating point precision" )
         ( "quote", boost::program_options::value< std::string >()->default_value( "\"" ), "quote sign to quote strings (ascii only)" )
-        ( "flush", "flush output stream after each record" );
+        ( "flush", "flush output stream after each record" )
+        ( "mmap", "if binary input is a regular file, read records from its memory mapping" );
     return d;
 }
 
@@ -69,6 +70,7 @@ inline csv::options program_options::get( const boost::program_options::variable
     if( vm.count( "precision" ) ) { csv.precision = vm[ "precision" ].as< unsigned int >(); }
     if( vm.count( "binary" ) ) { csv.format( vm[ "binary" ].as< std::string >() ); }
     csv.flush = vm.count( "flush" ) > 0;
+    csv.mmap = vm.count( "mmap" ) > 0;
     if( vm.count( "quote" ) )
     {
         std::string quote_character = vm[ "quote" ].as< std::string >();
@@ -43,6 +43,7 @@
 #include "../../string/string.h"
 #include "../../visiting/visit.h"
 #include "../../visiting/while.h"
+#include "ascii_cast.h"
 
 namespace comma { namespace csv { namespace impl {
 
@@ -87,22 +88,14 @@ class to_ascii
         boost::optional< unsigned int > precision_{ comma::silent_none< unsigned int >() };
         boost::optional< char > quote_{ comma::silent_none< char >() };
 
-        std::string as_string_( const boost::posix_time::ptime& v ) { return to_iso_string( v ); }
-        std::string as_string_( const std::string& v ) { return quote_ ? *quote_ + v + *quote_ : v; } // todo: escape/unescape
+        void as_string_( std::string& s, const boost::posix_time::ptime& v ) { ascii_cast< boost::posix_time::ptime >::to( s, v, precision_ ); }
+        void as_string_( std::string& s, const std::string& v ) { if( quote_ ) { s = *quote_ + v + *quote_; } else { s = v; } } // todo: escape/unescape
         // todo: better output semantics for char/unsigned char
-        std::string as_string_( const char& v ) { std::ostringstream oss; oss << static_cast< int >( v ); return oss.str(); }
-        std::string as_string_( const signed char& v ) { std::ostringstream oss; oss << static_cast< int >( v ); return oss.str(); }
-        std::string as_string_( const unsigned char& v ) { std::ostringstream oss; oss << static_cast< unsigned int >( v ); return oss.str(); }
-        void set_precision_( std::ostringstream& oss ) const;
-
+        void as_string_( std::string& s, const char& v ) { ascii_cast< int >::to( s, static_cast< int >( v ), precision_ ); }
+        void as_string_( std::string& s, const signed char& v ) { ascii_cast< int >::to( s, static_cast< int >( v ), precision_ ); }
+        void as_string_( std::string& s, const unsigned char& v ) { ascii_cast< unsigned int >::to( s, static_cast< unsigned int >( v ), precision_ ); }
         template < typename T >
-        std::string as_string_( T v )
-        {
-            std::ostringstream oss;
-            set_precision_( oss );
-            oss << v;
-            return oss.str();
-        }
+        void as_string_( std::string& s, T v ) { ascii_cast< T >::to( s, v, precision_ ); }
 };
 
 inline to_ascii::to_ascii( const std::vector< boost::optional< std::size_t > >& indices
@@ -151,7 +144,7 @@ inline void to_ascii::apply_final( const K&, const T& value )
     {
         std::size_t i = *indices_[ index_ ];
         if( i >= row_.size() ) { COMMA_THROW( comma::exception, "got column index " << i << ", for " << row_.size() << " columns in row " << join( row_, ',' ) ); }
-        row_[i] = as_string_( value );
+        as_string_( row_[i], value );
     }
     ++index_;
 }
@@ -0,0 +1,95 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+
+namespace comma { namespace csv { namespace impl {
+
+/// in-place tokenizer for ascii csv records
+///
+/// splits a line into spans pointing into the line itself, i.e. no copying;
+/// delimiters inside quotes do not split; quotes are kept in the fields as is,
+/// so that joining the fields back with the delimiter gives the original line
+///
+/// the tokenizer keeps its span buffer between calls, thus once warmed up,
+/// it does not allocate memory
+class tokenizer
+{
+    public:
+        /// string_view-like field
+        struct span
+        {
+            const char* data;
+            std::size_t size;
+            span( const char* data = nullptr, std::size_t size = 0 ): data( data ), size( size ) {}
+            bool empty() const { return size == 0; }
+            std::string string() const { return std::string( data, size ); }
+        };
+
+        /// constructor
+        tokenizer( char delimiter = ',', const boost::optional< char >& quote = boost::none ): delimiter_( delimiter ), quote_( quote ) {}
+
+        /// split [begin, end) into spans; spans are valid as long as the buffer they point to
+        const std::vector< span >& split( const char* begin, const char* end );
+
+        /// split line into spans
+        const std::vector< span >& split( const std::string& line ) { return split( &line[0], &line[0] + line.size() ); }
+
+        /// split line and assign fields to v reusing its strings' capacity, thus not allocating once warmed up
+        const std::vector< std::string >& split( const std::string& line, std::vector< std::string >& v );
+
+        /// return spans of the last split
+        const std::vector< span >& spans() const { return spans_; }
+
+        /// return delimiter
+        char delimiter() const { return delimiter_; }
+
+        /// return quote
+        const boost::optional< char >& quote() const { return quote_; }
+
+    private:
+        char delimiter_;
+        boost::optional< char > quote_;
+        std::vector< span > spans_;
+};
+
+inline const std::vector< tokenizer::span >& tokenizer::split( const char* begin, const char* end )
+{
+    spans_.clear();
+    std::size_t size = end - begin;
+    if( !quote_ || ::memchr( begin, *quote_, size ) == nullptr ) // fast path: no quotes in line
+    {
+        const char* p = begin;
+        while( true )
+        {
+            const char* d = static_cast< const char* >( ::memchr( p, delimiter_, end - p ) );
+            if( d == nullptr ) { spans_.emplace_back( p, end - p ); break; }
+            spans_.emplace_back( p, d - p );
+            p = d + 1;
+        }
+        return spans_;
+    }
+    const char* field = begin;
+    bool quoted = false;
+    for( const char* p = begin; p < end; ++p )
+    {
+        if( *p == *quote_ ) { quoted = !quoted; }
+        else if( !quoted && *p == delimiter_ ) { spans_.emplace_back( field, p - field ); field = p + 1; }
+    }
+    spans_.emplace_back( field, end - field );
+    return spans_;
+}
+
+inline const std::vector< std::string >& tokenizer::split( const std::string& line, std::vector< std::string >& v )
+{
+    split( line );
+    v.resize( spans_.size() );
+    for( std::size_t i = 0; i < spans_.size(); ++i ) { v[i].assign( spans_[i].data, spans_[i].size ); }
+    return v;
+}
+
+} } } // namespace comma { namespace csv { namespace impl {
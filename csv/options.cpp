@@ -76,11 +76,12 @@ static void init( comma::csv::options& csv_options
         }
     }
     csv_options.flush = options.exists( "--flush" );
+    csv_options.mmap = options.exists( "--mmap" );
 }
 
 } // namespace impl {
 
-options::options(): full_xpath( true ), delimiter( ',' ), precision( 12 ), quote( '"' ), flush( false ) {}
+options::options(): full_xpath( true ), delimiter( ',' ), precision( 12 ), quote( '"' ), flush( false ), mmap( false ) {}
 
 options::options( int argc, char** argv, const std::string& default_fields, bool full_xpath ): options( comma::command_line_options( argc, argv ), default_fields, full_xpath ) {}
 
@@ -97,9 +98,11 @@ std::string options::usage( const std::string& default_fields, bool verbose )
         oss << "    --fields,-f <names>: comma-separated field names";
         if( !default_fields.empty() ) { oss << "; default: " << default_fields; }
         oss << std::endl;
-        oss << "    --precision <precision>: floating point precision; default: 12" << std::endl;
+        oss << "    --precision <precision>: floating point precision; default: 12; 0: shortest representation that reads back exactly" << std::endl;
         oss << "    --quote=[<quote_character>]: quote sign to quote strings (ascii only); default: '\"'" << std::endl;
         oss << "    --flush: if present, flush output stream after each record" << std::endl;
+        oss << "    --mmap: if present and binary input is a regular file (e.g. redirected stdin), read records from its memory mapping" << std::endl;
+        oss << "            without copying them; ignored for pipes, sockets, etc" << std::endl;
         oss << "    --format <format>: explicitly set input format in csv mode (if not set, guess format from first line)" << std::endl;
         oss << "    --binary,-b <format>: use binary format" << std::endl;
         oss << format::usage();
@@ -112,7 +115,7 @@ std::string options::usage( const std::string& default_fields, bool verbose )
         if( !default_fields.empty() ) { oss << "; default: " << default_fields; }
         oss << std::endl;
         oss << "    --flush: if present, flush output stream after each record" << std::endl;
-        oss << "    --precision <precision>: floating point precision; default: 12" << std::endl;
+        oss << "    --precision <precision>: floating point precision; default: 12; 0: shortest representation that reads back exactly" << std::endl;
         oss << std::endl;
         oss << "    run with verbose for full csv options description..." << std::endl;
     }
@@ -175,6 +178,6 @@ bool options::has_some_of_paths( const std::string& paths ) const
     return false;
 }
 
-std::string options::valueless_options() { return "--flush"; }
+std::string options::valueless_options() { return "--flush,--mmap"; }
 
 } } // namespace comma { namespace csv {
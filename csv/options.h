@@ -61,6 +61,9 @@ class options
         /// if true, flush output stream after each record
         bool flush;
 
+        /// if true and binary input is a regular file, read records straight from its memory mapping
+        bool mmap;
+
         /// return format
         const csv::format& format() const;
 
@@ -10,14 +10,19 @@
 #include <io.h>
 #endif
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 #include "../base/exception.h"
 #include "../csv/ascii.h"
 #include "../csv/binary.h"
 #include "../csv/options.h"
+#include "../csv/impl/block_reader.h"
+#include "../csv/impl/tokenizer.h"
 #include "../string/string.h"
 
 namespace comma { namespace csv {
@@ -72,6 +77,9 @@ class ascii_input_stream : public boost::noncopyable
         /// return the last line read
         const std::vector< std::string >& last() const { return line_; }
 
+        /// return the last line read as is, without end of line
+        const std::string& line() const { return buffer_; }
+
         /// a helper: return the engine
         const csv::ascii< S > ascii() const { return ascii_; }
 
@@ -95,6 +103,8 @@ class ascii_input_stream : public boost::noncopyable
         csv::ascii< S > ascii_;
         const S default_;
         S result_;
+        std::string buffer_;
+        impl::tokenizer tokenizer_;
         std::vector< std::string > line_;
         std::vector< std::string > fields_;
 };
@@ -172,8 +182,16 @@ class binary_input_stream : public boost::noncopyable
         /// @todo implement
         const S* read( const boost::posix_time::ptime& timeout );
 
-        /// return the last line read
-        const char* last() const { return &buf_[0]; }
+        /// read up to size records into records in one go; return number of records read, 0 on end of stream
+        /// blocks only until at least one record is available, i.e. suitable for live streams
+        /// records are assigned from the sample first, as in read()
+        std::size_t read_many( S* records, std::size_t size );
+
+        /// return the last line read; after read_many(), the last record of the batch
+        const char* last() const { return last_; }
+
+        /// return raw bytes of i-th record of the last read_many() batch, e.g. to pass it through
+        const char* last( std::size_t i ) const { return batch_ + i * size_; }
 
         /// a helper: return the engine
         const csv::binary< S > binary() const { return binary_; }
@@ -201,6 +219,11 @@ class binary_input_stream : public boost::noncopyable
         const std::size_t size_;
         std::vector< char > buf_;
         std::vector< std::string > fields_;
+        const char* last_;
+        boost::scoped_ptr< impl::block_reader > block_reader_; // created on the first read_many() or, if memory-mapped, in constructor
+        std::size_t index_; // next record in the current batch of block_reader_
+        const char* batch_;
+        bool mapped_() const { return block_reader_ && block_reader_->mapped(); }
 };
 
 /// binary csv output stream
@@ -223,9 +246,23 @@ class binary_output_stream : public boost::noncopyable
         /// substitute corresponding fields in the buffer and write
         void write( const S& s, const char* buf );
 
-        /// flush
+        /// write buffered records, if any, and flush
         void flush();
 
+        /// buffer up to size records and write them to the stream in one go, which is much faster for small records
+        /// buffered records also get written, once period has passed since the first of them was buffered (checked on write),
+        /// on flush() and on destruction; if flush is on, each record still gets written and flushed straight away
+        /// the period is checked only on write; on live streams, do not hold records on quiet input, e.g:
+        ///     if( !istream.ready() && ostream.buffered() > 0 && select.wait( ostream.due() ) == 0 ) { ostream.flush(); }
+        /// @param size number of records; 0: no buffering, i.e. write records one by one (default)
+        void buffer( std::size_t size, const boost::posix_time::time_duration& period = boost::posix_time::pos_infin );
+
+        /// number of bytes buffered, but not yet written
+        std::size_t buffered() const { return buffered_; }
+
+        /// time left until buffered records are due to be written; pos_infin, if nothing buffered or no period
+        boost::posix_time::time_duration due() const;
+
         /// a helper: return the engine
         const csv::binary< S > binary() const { return binary_; }
 
@@ -244,15 +281,19 @@ class binary_output_stream : public boost::noncopyable
 
         std::ostream& os_;
         csv::binary< S > binary_;
-        //const std::size_t size_;
         std::vector< char > buf_;
-        //char* begin_;
-        //const char* end_;
-        //char* cur_;
         std::vector< std::string > fields_;
         bool flush_;
         unsigned int _size{};
         /// bool is_stdout;
+        std::vector< char > buffer_; // records buffered for writing in one go
+        std::size_t buffered_{0};
+        boost::optional< std::chrono::steady_clock::duration > period_;
+        std::chrono::steady_clock::time_point deadline_;
+        char* reserve_( std::size_t size );
+        void commit_( std::size_t size );
+        void write_buffered_();
+        void write_( const char* passed, std::size_t passed_size, const S& s ); // write passed-through bytes followed by s
 };
 
 /// trivial generic csv input stream wrapper, less optimized, but more convenient
@@ -355,7 +396,7 @@ class output_stream : public boost::noncopyable
 
         bool is_binary() const { return bool( binary_ ); }
 
-        std::ostream& os() { return binary_ ? binary_->os_ : ascii_->os_; }
+        std::ostream& os() { if( binary_ ) { binary_->write_buffered_(); return binary_->os_; } return ascii_->os_; } // write buffered records first to keep output in order
 
         /// return size of last output record in bytes
         unsigned int last_size() const { return binary_ ? binary_->size() : ascii_->last_size(); }
@@ -382,7 +423,8 @@ inline void output_stream< S >::append( const std::string& line, const S& s )
         /// } else {
         ///    bos.os_.write(&line[0], line.size());
         /// }
-        binary().os_.write( &line[0], line.size() );
+        binary().write_( &line[0], line.size(), s );
+        return;
     }
     write( s );
 }
@@ -400,8 +442,7 @@ inline void append( const input_stream< S >& is, output_stream< T >& os, const D
         /// } else {
         ///     bos.os_.write( is.binary().last(), is.binary().size() );
         /// }
-        os.binary().os_.write( is.binary().last(), is.binary().size() );
-        os.write( data );  // todo: low-hanging fruit for append() only: add writing to stdout as a private method or alike (i.e. hide from the user) and still use ::write() for stdout
+        os.binary().write_( is.binary().last(), is.binary().size(), data );
     }
     else
     {
@@ -526,7 +567,7 @@ inline void passed< S >::write()
     }
     else
     {
-        os_ << comma::join( is_.ascii().last(), is_.ascii().ascii().delimiter() ) << std::endl;
+        os_ << is_.ascii().line() << std::endl;
     }
 }
 
@@ -564,6 +605,7 @@ inline ascii_input_stream< S >::ascii_input_stream( std::istream& is, const std:
     , ascii_( column_names, delimiter, full_path_as_name, sample )
     , default_( sample )
     , result_( sample )
+    , tokenizer_( delimiter, ascii_.quote() )
     , fields_( split( column_names, ',' ) )
 {
     detail::unsynchronize_with_stdio();
@@ -575,6 +617,7 @@ inline ascii_input_stream< S >::ascii_input_stream(std::istream& is, const optio
     , ascii_( o, sample )
     , default_( sample )
     , result_( sample )
+    , tokenizer_( o.delimiter, o.quote )
     , fields_( split( o.fields, ',' ) )
 {
     detail::unsynchronize_with_stdio();
@@ -586,6 +629,7 @@ inline ascii_input_stream< S >::ascii_input_stream(std::istream& is, const S& sa
     , ascii_( options().fields, options().delimiter, true, sample ) // , ascii_( options().fields, options().delimiter, o.full_xpath, sample )
     , default_( sample )
     , result_( sample )
+    , tokenizer_( options().delimiter, options().quote )
     , fields_( split( options().fields, ',' ) )
 {
     detail::unsynchronize_with_stdio();
@@ -603,12 +647,11 @@ inline const S* ascii_input_stream< S >::read()
     while( is_.good() && !is_.eof() )
     {
         /// @todo implement reassembly
-        std::string s;
-        std::getline( is_, s );
-        if( !s.empty() && *s.rbegin() == '\r' ) { s = s.substr( 0, s.length() - 1 ); } // windows... sigh...
-        if( s.empty() ) { continue; }
+        std::getline( is_, buffer_ ); // buffer and fields are reused, thus no allocations once warmed up
+        if( !buffer_.empty() && buffer_.back() == '\r' ) { buffer_.pop_back(); } // windows... sigh...
+        if( buffer_.empty() ) { continue; }
         result_ = default_;
-        line_ = split( s, ascii_.delimiter() );
+        tokenizer_.split( buffer_, line_ );
         ascii_.get( result_, line_ );
         return &result_;
     }
@@ -679,6 +722,9 @@ inline binary_input_stream< S >::binary_input_stream( std::istream& is, const st
     , size_( binary_.format().size() )
     , buf_( size_ )
     , fields_( split( column_names, ',' ) )
+    , last_( &buf_[0] )
+    , index_( 0 )
+    , batch_( &buf_[0] )
 {
     #ifdef WIN32
     if( &is == &std::cin ) { _setmode( _fileno( stdin ), _O_BINARY ); }
@@ -695,39 +741,67 @@ inline binary_input_stream< S >::binary_input_stream( std::istream& is, const op
     , size_( binary_.format().size() )
     , buf_( size_ )
     , fields_( split( o.fields, ',' ) )
+    , last_( &buf_[0] )
+    , index_( 0 )
+    , batch_( &buf_[0] )
 {
     #ifdef WIN32
     if( &is == &std::cin ) { _setmode( _fileno( stdin ), _O_BINARY ); }
     #endif
     detail::unsynchronize_with_stdio();
+    if( !o.mmap ) { return; }
+    block_reader_.reset( new impl::block_reader( is_, size_, 0, true ) );
+    if( !block_reader_->mapped() ) { block_reader_.reset(); } // e.g. a pipe: read as usual
 }
 
 template < typename S >
 inline bool binary_input_stream< S >::ready() const
 {
-    return is_.rdbuf()->in_avail() >= int( size_ );
+    return mapped_() ? index_ < block_reader_->size() || block_reader_->remaining() >= size_ : is_.rdbuf()->in_avail() >= int( size_ );
 }
 
 template < typename S >
 inline const S* binary_input_stream< S >::read()
 {
+    if( mapped_() ) // record straight from the mapping, no copy
+    {
+        if( index_ == block_reader_->size() ) { index_ = 0; if( block_reader_->read() == 0 ) { return NULL; } }
+        last_ = block_reader_->record( index_++ );
+        result_ = default_;
+        binary_.get( result_, last_ );
+        return &result_;
+    }
     is_.read( &buf_[0], size_ );
     if( is_.gcount() == 0 ) { return NULL; }
     if( is_.gcount() != int( size_ ) ) { COMMA_THROW( comma::exception, "expected " << size_ << " bytes; got " << is_.gcount() ); }
+    last_ = &buf_[0];
     result_ = default_;
     binary_.get( result_, &buf_[0] );
     return &result_;
 }
 
+template < typename S >
+inline std::size_t binary_input_stream< S >::read_many( S* records, std::size_t size )
+{
+    if( !block_reader_ ) { block_reader_.reset( new impl::block_reader( is_, size_ ) ); }
+    if( index_ == block_reader_->size() ) { index_ = 0; if( block_reader_->read( size ) == 0 ) { return 0; } } // otherwise, the rest of the batch started by read()
+    std::size_t count = std::min( size, block_reader_->size() - index_ );
+    batch_ = block_reader_->record( index_ );
+    for( std::size_t i = 0; i < count; ++i )
+    {
+        records[i] = default_;
+        binary_.get( records[i], batch_ + i * size_ );
+    }
+    index_ += count;
+    if( count > 0 ) { last_ = batch_ + ( count - 1 ) * size_; } // e.g. size 0: keep the last record as is
+    return count;
+}
+
 template < typename S >
 inline binary_output_stream< S >::binary_output_stream( std::ostream& os, const std::string& format, const std::string& column_names, bool full_path_as_name, bool flush, const S& sample )
     : os_( os )
     , binary_( format, column_names, full_path_as_name, sample )
-    //, size_( binary_.format().size() * ( 4098 / binary_.format().size() ) ) // quick and dirty
-    , buf_( binary_.format().size() ) //, buf_( size_ )
-    //, begin_( &buf_[0] )
-    //, end_( begin_ + size_ )
-    //, cur_( begin_ )
+    , buf_( binary_.format().size() )
     , fields_( split( column_names, ',' ) )
     , flush_( flush )
     , _size( binary_.format().size() )
@@ -743,11 +817,7 @@ template < typename S >
 inline binary_output_stream< S >::binary_output_stream( std::ostream& os, const options& o, const S& sample )
     : os_( os )
     , binary_( o.format().string(), o.fields, o.full_xpath, sample )
-//     , size_( binary_.format().size() ) //, size_( binary_.format().size() * ( 4098 / binary_.format().size() ) ) // quick and dirty
-    , buf_( binary_.format().size() ) //, buf_( size_ )
-//     , begin_( &buf_[0] )
-//     , end_( begin_ + size_ )
-//     , cur_( begin_ )
+    , buf_( binary_.format().size() )
     , fields_( split( o.fields, ',' ) )
     , flush_( o.flush )
     /// , is_stdout( os_.rdbuf() == std::cout.rdbuf() )
@@ -762,16 +832,55 @@ inline binary_output_stream< S >::binary_output_stream( std::ostream& os, const
 template < typename S >
 inline void binary_output_stream< S >::flush()
 {
+    write_buffered_();
     os_.flush();
-//     if( cur_ == begin_ ) { return; }
-//     os_.write( begin_, cur_ - begin_ );
-//     os_.flush();
-//     cur_ = begin_;
+}
+
+template < typename S >
+inline void binary_output_stream< S >::buffer( std::size_t size, const boost::posix_time::time_duration& period )
+{
+    write_buffered_();
+    buffer_.resize( size * _size );
+    if( period.is_special() ) { period_.reset(); } else { period_ = std::chrono::microseconds( period.total_microseconds() ); }
+}
+
+template < typename S >
+inline boost::posix_time::time_duration binary_output_stream< S >::due() const
+{
+    if( buffered_ == 0 || !period_ ) { return boost::posix_time::pos_infin; }
+    comma::int64 left = std::chrono::duration_cast< std::chrono::microseconds >( deadline_ - std::chrono::steady_clock::now() ).count();
+    return boost::posix_time::microseconds( left > 0 ? left : 0 );
+}
+
+template < typename S >
+inline char* binary_output_stream< S >::reserve_( std::size_t size )
+{
+    if( buffered_ + size > buffer_.size() ) { write_buffered_(); }
+    if( size > buffer_.size() ) { buffer_.resize( size ); } // e.g. a long passed-through record
+    if( buffered_ == 0 && period_ ) { deadline_ = std::chrono::steady_clock::now() + *period_; }
+    return &buffer_[0] + buffered_;
+}
+
+template < typename S >
+inline void binary_output_stream< S >::commit_( std::size_t size )
+{
+    buffered_ += size;
+    if( flush_ ) { flush(); return; }
+    if( buffered_ + _size > buffer_.size() || ( period_ && std::chrono::steady_clock::now() >= deadline_ ) ) { write_buffered_(); }
+}
+
+template < typename S >
+inline void binary_output_stream< S >::write_buffered_()
+{
+    if( buffered_ == 0 ) { return; }
+    os_.write( &buffer_[0], buffered_ );
+    buffered_ = 0;
 }
 
 template < typename S >
 inline void binary_output_stream< S >::write( const S& s )
 {
+    if( !buffer_.empty() ) { binary_.put( s, reserve_( _size ) ); commit_( _size ); return; }
     binary_.put( s, &buf_[0] );
     /// if ( is_stdout ) {
         /// do not do it! see the notes inside the passed<> implementation
@@ -781,19 +890,31 @@ inline void binary_output_stream< S >::write( const S& s )
         os_.write( &buf_[0], binary_.format().size() );
         if( flush_ ) { os_.flush(); }
     /// }
-//     binary_.put( s, cur_ );
-//     cur_ += binary_.format().size();
-//     if( cur_ == end_ ) { flush(); }
 }
 
 template < typename S >
 inline void binary_output_stream< S >::write( const S& s, const char* buf )
 {
+    if( !buffer_.empty() )
+    {
+        char* p = reserve_( _size );
+        ::memcpy( p, buf, _size );
+        binary_.put( s, p );
+        commit_( _size );
+        return;
+    }
     ::memcpy( &buf_[0], buf, binary_.format().size() );
     write( s );
-//     ::memcpy( cur_, buf, binary_.format().size() );
-//     write( s );
-//    if( flush_ ) { os_.flush(); }
+}
+
+template < typename S >
+inline void binary_output_stream< S >::write_( const char* passed, std::size_t passed_size, const S& s )
+{
+    if( buffer_.empty() ) { os_.write( passed, passed_size ); write( s ); return; }
+    char* p = reserve_( passed_size + _size ); // gather passed-through bytes and s in the buffer without intermediate copies
+    ::memcpy( p, passed, passed_size );
+    binary_.put( s, p + passed_size );
+    commit_( passed_size + _size );
 }
 
 template < typename S >
@@ -812,7 +933,7 @@ inline input_stream< S >::input_stream( std::istream& is, const S& sample )
 template < typename S >
 std::string inline input_stream< S >::last() const
 {
-    if( !binary_ ) { return comma::join( ascii_->last(), ascii_->ascii().delimiter() ); }
+    if( !binary_ ) { return ascii_->line(); }
     std::string s( binary_->size(), 0 );
     ::memcpy( &s[0], binary_->last(), binary_->size() );
     return s;
@@ -28,12 +28,14 @@
 // IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
+#include <vector>
 #include <gtest/gtest.h>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #if ( BOOST_VERSION >= 107400 ) // quick and dirty; fixing trivial compilation error
 #include <boost/optional/optional_io.hpp>
 #endif
 #include "../../csv/ascii.h"
+#include "../../csv/impl/ascii_cast.h"
 #include "../../string/string.h"
 
 namespace comma { namespace csv { namespace ascii_test {
@@ -394,6 +396,54 @@ TEST( csv, ascii_containers )
     // todo: more tests
 }
 
+TEST( csv, ascii_cast )
+{
+    {
+        double d;
+        comma::csv::impl::ascii_cast< double >::from( d, "1.5", "1.5" + 3 );
+        EXPECT_EQ( d, 1.5 );
+        std::string s( "+2.5" ); // not accepted by from_chars, falls back to lexical_cast
+        comma::csv::impl::ascii_cast< double >::from( d, &s[0], &s[0] + s.size() );
+        EXPECT_EQ( d, 2.5 );
+        s = "abc";
+        EXPECT_THROW( comma::csv::impl::ascii_cast< double >::from( d, &s[0], &s[0] + s.size() ), boost::bad_lexical_cast );
+    }
+    {
+        std::string s;
+        for( double d: { 0.1, 1.0 / 3, 123456789.123, 1e-20, -2.5e30 } )
+        {
+            for( unsigned int precision: { 6, 12, 16 } )
+            {
+                std::ostringstream oss;
+                oss.precision( precision );
+                oss << d;
+                comma::csv::impl::ascii_cast< double >::to( s, d, precision );
+                EXPECT_EQ( oss.str(), s );
+            }
+            comma::csv::impl::ascii_cast< double >::to( s, d, 0 );
+            EXPECT_EQ( boost::lexical_cast< double >( s ), d );
+        }
+        comma::csv::impl::ascii_cast< int >::to( s, -123, 6 );
+        EXPECT_EQ( "-123", s );
+        comma::csv::impl::ascii_cast< bool >::to( s, true, boost::none );
+        EXPECT_EQ( "1", s );
+    }
+    {
+        boost::posix_time::ptime t;
+        std::string s;
+        for( const std::string& r: std::vector< std::string >{ "20110304T111111", "20110304T111111.1234", "20110304T111111.000001", "not-a-date-time", "+infinity" } )
+        {
+            comma::csv::impl::ascii_cast< boost::posix_time::ptime >::from( t, &r[0], &r[0] + r.size() );
+            EXPECT_EQ( boost::posix_time::from_iso_string( r ), t );
+            comma::csv::impl::ascii_cast< boost::posix_time::ptime >::to( s, t );
+            EXPECT_EQ( boost::posix_time::to_iso_string( t ), s );
+        }
+        s = "20110304T111111.1234567891"; // extra fractional digits truncated, as in from_iso_string()
+        comma::csv::impl::ascii_cast< boost::posix_time::ptime >::from( t, &s[0], &s[0] + s.size() );
+        EXPECT_EQ( boost::posix_time::from_iso_string( s ), t );
+    }
+}
+
 int main( int argc, char* argv[] )
 {
     ::testing::InitGoogleTest(&argc, argv);
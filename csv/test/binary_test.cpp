@@ -3,6 +3,7 @@
 
 #include <gtest/gtest.h>
 #include <array>
+#include <cstring>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include "../../csv/binary.h"
 #include "../../csv/format.h"
@@ -60,6 +61,12 @@ struct containers
     boost::array< int, 4 > array;
 };
 
+struct swapped // visited in order different from the order in memory
+{
+    int x{0};
+    int y{0};
+};
+
 } } } // namespace comma { namespace csv { namespace binary_test {
 
 namespace comma { namespace visiting {
@@ -167,6 +174,12 @@ template <> struct traits< comma::csv::binary_test::containers >
     }
 };
 
+template <> struct traits< comma::csv::binary_test::swapped >
+{
+    template < typename Key, class Visitor > static void visit( const Key&, const comma::csv::binary_test::swapped& p, Visitor& v ) { v.apply( "y", p.y ); v.apply( "x", p.x ); }
+    template < typename Key, class Visitor > static void visit( const Key&, comma::csv::binary_test::swapped& p, Visitor& v ) { v.apply( "y", p.y ); v.apply( "x", p.x ); }
+};
+
 } } // namespace comma { namespace visiting {
 
 TEST( csv, binary_get )
@@ -444,3 +457,58 @@ TEST( csv, binary_containers )
     }
     // todo: more tests
 }
+
+TEST( csv, binary_default_layout )
+{
+    {
+        comma::csv::binary_test::simple_struct t;
+        t.a = 1;
+        t.b = 2;
+        t.c = 'c';
+        t.t = boost::posix_time::from_iso_string( "20110304T111111.1234" );
+        t.nested.x = 5;
+        t.nested.y = 6;
+        EXPECT_TRUE( comma::csv::impl::default_binary::fits( t, 29 ) );
+        EXPECT_FALSE( comma::csv::impl::default_binary::same_as_memory( t ) ); // padding
+        comma::csv::binary< comma::csv::binary_test::simple_struct > fast;
+        comma::csv::binary< comma::csv::binary_test::simple_struct > slow( "i,d,b,t,2i,d", "a,b,c,t,nested/x,nested/y," ); // not default layout
+        EXPECT_EQ( 29, fast.format().size() );
+        char buf[ sizeof( comma::csv::binary_test::simple_struct ) ]; // record is 29 bytes, but get() may copy the whole struct, if its layout is the same as in memory
+        char expected[37];
+        fast.put( t, buf );
+        slow.put( t, expected );
+        EXPECT_EQ( 0, std::memcmp( buf, expected, 29 ) );
+        comma::csv::binary_test::simple_struct s;
+        fast.get( s, buf );
+        EXPECT_EQ( s.a, 1 );
+        EXPECT_EQ( s.b, 2 );
+        EXPECT_EQ( s.c, 'c' );
+        EXPECT_EQ( s.t, t.t );
+        EXPECT_EQ( s.nested.x, 5 );
+        EXPECT_EQ( s.nested.y, 6 );
+    }
+    {
+        comma::csv::binary_test::swapped t;
+        t.x = 1;
+        t.y = 2;
+        EXPECT_TRUE( comma::csv::impl::default_binary::fits( t, 8 ) );
+        EXPECT_FALSE( comma::csv::impl::default_binary::same_as_memory( t ) );
+        comma::csv::binary< comma::csv::binary_test::swapped > binary;
+        comma::int32 buf[2];
+        binary.put( t, reinterpret_cast< char* >( buf ) );
+        EXPECT_EQ( 2, buf[0] );
+        EXPECT_EQ( 1, buf[1] );
+        comma::csv::binary_test::swapped s;
+        binary.get( s, reinterpret_cast< const char* >( buf ) );
+        EXPECT_EQ( 1, s.x );
+        EXPECT_EQ( 2, s.y );
+    }
+    {
+        comma::csv::binary_test::nested n;
+        EXPECT_TRUE( comma::csv::impl::default_binary::same_as_memory( n ) );
+        comma::csv::binary_test::large_struct l; // strings
+        EXPECT_FALSE( comma::csv::impl::default_binary::fits( l, 100 ) );
+        comma::csv::binary_test::test_struct o; // optional fields
+        EXPECT_FALSE( comma::csv::impl::default_binary::fits( o, 12 ) );
+    }
+}
@@ -85,6 +85,13 @@ TEST( csv, format )
         comma::csv::format f( "%d" );
         EXPECT_EQ( f.bin_to_csv( f.csv_to_bin( "1234.123456789012" ) ), "1234.123456789012" );
     }
+    {
+        comma::csv::format f( "%d%f" );
+        const std::string& b = f.csv_to_bin( "0.1,0.1" );
+        EXPECT_EQ( "0.1,0.1", f.bin_to_csv( b, ',', 0 ) ); // precision 0: shortest that reads back, as in csv::ascii
+        EXPECT_EQ( "0.1,0.1", f.bin_to_csv( b, ',', 3 ) );
+        EXPECT_EQ( "0.10000000000000001,0.10000000149011612", f.bin_to_csv( b, ',', 17 ) );
+    }
     {
         comma::csv::format f( "%uw%ui%f" );
         EXPECT_EQ( f.bin_to_csv( f.csv_to_bin( "1234,5678,90.1234" ) ), "1234,5678,90.1234" );
@@ -0,0 +1,51 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "../impl/gather.h"
+
+namespace comma { namespace csv { namespace impl {
+
+TEST( gather, coalesce )
+{
+    gather g;
+    g.add( 0, 4 );
+    g.add( 4, 8 );
+    g.add( 20, 2 );
+    g.add( 0, 0 );
+    g.add( 12, 8 );
+    ASSERT_EQ( 3u, g.runs().size() );
+    EXPECT_EQ( 0u, g.runs()[0].from );
+    EXPECT_EQ( 12u, g.runs()[0].size );
+    EXPECT_EQ( 20u, g.runs()[1].from );
+    EXPECT_EQ( 12u, g.runs()[1].to );
+    EXPECT_EQ( 12u, g.runs()[2].from );
+    EXPECT_EQ( 14u, g.runs()[2].to );
+    EXPECT_EQ( 22u, g.size() );
+}
+
+TEST( gather, apply )
+{
+    const std::size_t input_size = 40; // e.g. ui,3d,ui
+    const std::size_t count = 100;
+    std::string input( input_size * count, 0 );
+    for( std::size_t i = 0; i < input.size(); ++i ) { input[i] = char( i * 7 ); }
+    std::vector< std::pair< std::size_t, std::size_t > > fields = { { 36, 4 }, { 4, 24 }, { 0, 1 }, { 3, 1 }, { 12, 16 }, { 4, 8 }, { 1, 2 }, { 4, 12 }, { 0, 40 } };
+    gather g;
+    std::string expected;
+    for( std::size_t i = 0; i < count; ++i ) { for( const auto& f: fields ) { expected += input.substr( i * input_size + f.first, f.second ); } }
+    for( const auto& f: fields ) { g.add( f.first, f.second ); }
+    std::string output( g.size() * count, 0 );
+    g.apply( &input[0], input_size, count, &output[0] );
+    EXPECT_EQ( expected, output );
+    gather all;
+    all.add( 0, 20 );
+    all.add( 20, 20 );
+    ASSERT_EQ( 1u, all.runs().size() );
+    output.assign( input.size(), 0 );
+    all.apply( &input[0], input_size, count, &output[0] );
+    EXPECT_EQ( input, output );
+}
+
+} } } // namespace comma { namespace csv { namespace impl {
@@ -28,8 +28,13 @@
 // IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
+#ifndef WIN32
+#include <unistd.h>
+#endif
 #include <gtest/gtest.h>
+#include <cstring>
 #include <sstream>
+#include <thread>
 #include <vector>
 #include <boost/array.hpp>
 //#include <google/profiler.h>
@@ -138,6 +143,183 @@ TEST( csv, passed_ascii )
     }
 }
 
+TEST( csv, tokenizer )
+{
+    {
+        comma::csv::impl::tokenizer t( ',' );
+        const auto& s = t.split( std::string( "a,,bc," ) );
+        ASSERT_EQ( 4, s.size() );
+        EXPECT_EQ( "a", s[0].string() );
+        EXPECT_TRUE( s[1].empty() );
+        EXPECT_EQ( "bc", s[2].string() );
+        EXPECT_TRUE( s[3].empty() );
+    }
+    {
+        comma::csv::impl::tokenizer t( ',', '"' );
+        std::vector< std::string > v;
+        t.split( "1,\"a,b\",2", v );
+        ASSERT_EQ( 3, v.size() );
+        EXPECT_EQ( "1", v[0] );
+        EXPECT_EQ( "\"a,b\"", v[1] );
+        EXPECT_EQ( "2", v[2] );
+        t.split( "3", v );
+        ASSERT_EQ( 1, v.size() );
+        EXPECT_EQ( "3", v[0] );
+    }
+}
+
+TEST( csv, ascii_input_stream_read )
+{
+    std::istringstream iss( "1,2\r\n\n3,4\n5,6,\"x,y\"" );
+    comma::csv::input_stream< test_struct > is( iss );
+    const test_struct* p = is.read();
+    ASSERT_TRUE( p );
+    EXPECT_EQ( 1, p->x );
+    EXPECT_EQ( 2, p->y );
+    EXPECT_EQ( "1,2", is.last() );
+    p = is.read();
+    ASSERT_TRUE( p );
+    EXPECT_EQ( 3, p->x );
+    EXPECT_EQ( 4, p->y );
+    EXPECT_EQ( 2, is.ascii().last().size() );
+    p = is.read();
+    ASSERT_TRUE( p );
+    EXPECT_EQ( 5, p->x );
+    ASSERT_EQ( 3, is.ascii().last().size() );
+    EXPECT_EQ( "\"x,y\"", is.ascii().last()[2] );
+    EXPECT_EQ( "5,6,\"x,y\"", is.last() );
+    EXPECT_FALSE( is.read() );
+}
+
+TEST( csv, binary_input_stream_read_many )
+{
+    std::string s;
+    for( comma::uint32 i = 0; i < 5; ++i ) { comma::uint32 v[2] = { i, i * 10 }; s.append( reinterpret_cast< const char* >( v ), sizeof( v ) ); }
+    std::istringstream iss( s );
+    comma::csv::binary_input_stream< test_struct > is( iss, "2ui" );
+    test_struct records[3];
+    ASSERT_EQ( 3, is.read_many( records, 3 ) );
+    for( unsigned int i = 0; i < 3; ++i )
+    {
+        EXPECT_EQ( i, records[i].x );
+        EXPECT_EQ( i * 10, records[i].y );
+        EXPECT_EQ( 0, std::memcmp( is.last( i ), &s[ i * 8 ], 8 ) );
+    }
+    EXPECT_EQ( is.last(), is.last( 2 ) );
+    const test_struct* p = is.read(); // read() and read_many() can be mixed
+    ASSERT_TRUE( p );
+    EXPECT_EQ( 3, p->x );
+    EXPECT_EQ( 0, is.read_many( records, 0 ) );
+    EXPECT_EQ( 0, std::memcmp( is.last(), &s[24], 8 ) ); // last record unchanged
+    ASSERT_EQ( 1, is.read_many( records, 3 ) );
+    EXPECT_EQ( 4, records[0].x );
+    EXPECT_EQ( 40, records[0].y );
+    EXPECT_EQ( 0, is.read_many( records, 3 ) );
+    std::istringstream partial( s.substr( 0, 12 ) );
+    comma::csv::binary_input_stream< test_struct > ps( partial, "2ui" );
+    EXPECT_EQ( 1, ps.read_many( records, 3 ) );
+    EXPECT_THROW( ps.read_many( records, 3 ), comma::exception );
+}
+
+#ifndef WIN32
+TEST( csv, binary_input_stream_mmap )
+{
+    std::string s;
+    for( comma::uint32 i = 0; i < 5; ++i ) { comma::uint32 v[2] = { i, i * 10 }; s.append( reinterpret_cast< const char* >( v ), sizeof( v ) ); }
+    char name[] = "/tmp/comma-stream-test-XXXXXX";
+    int fd = ::mkstemp( name );
+    ASSERT_LE( 0, fd );
+    ASSERT_EQ( ssize_t( s.size() ), ::write( fd, &s[0], s.size() ) );
+    ::lseek( fd, 8, SEEK_SET ); // start from the second record
+    int saved = ::dup( 0 );
+    ::dup2( fd, 0 ); // quick and dirty: redirect stdin to the file
+    {
+        comma::csv::options o;
+        o.format( "2ui" );
+        o.mmap = true;
+        comma::csv::binary_input_stream< test_struct > is( std::cin, o );
+        const test_struct* p = is.read();
+        ASSERT_TRUE( p );
+        EXPECT_EQ( 1, p->x );
+        EXPECT_EQ( 10, p->y );
+        EXPECT_TRUE( is.ready() );
+        test_struct records[5];
+        ASSERT_EQ( 3, is.read_many( records, 5 ) ); // rest of the batch started by read()
+        for( unsigned int i = 0; i < 3; ++i ) { EXPECT_EQ( i + 2, records[i].x ); EXPECT_EQ( 0, std::memcmp( is.last( i ), &s[ ( i + 2 ) * 8 ], 8 ) ); }
+        EXPECT_EQ( 40, ::lseek( 0, 0, SEEK_CUR ) ); // stdin moved past the records read
+        EXPECT_FALSE( is.ready() );
+        EXPECT_EQ( 0, is.read_many( records, 5 ) );
+        EXPECT_FALSE( is.read() );
+    }
+    ::dup2( saved, 0 );
+    ::close( saved );
+    ::close( fd );
+    ::unlink( name );
+    std::cin.clear();
+}
+#endif
+
+TEST( csv, binary_output_stream_buffer )
+{
+    {
+        std::ostringstream oss;
+        comma::csv::binary_output_stream< test_struct > os( oss, "2ui" );
+        os.buffer( 3 );
+        os.write( test_struct( 1, 2 ) );
+        os.write( test_struct( 3, 4 ) );
+        EXPECT_TRUE( oss.str().empty() );
+        os.write( test_struct( 5, 6 ) );
+        ASSERT_EQ( 24, oss.str().size() );
+        os.write( test_struct( 7, 8 ) );
+        EXPECT_EQ( 24, oss.str().size() );
+        os.flush();
+        ASSERT_EQ( 32, oss.str().size() );
+        comma::uint32 expected[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+        EXPECT_EQ( 0, std::memcmp( expected, &oss.str()[0], 32 ) );
+    }
+    {
+        std::ostringstream oss;
+        comma::csv::binary_output_stream< test_struct > os( oss, "2ui" );
+        os.buffer( 100, boost::posix_time::microseconds( 0 ) ); // write on every record
+        os.write( test_struct( 1, 2 ) );
+        EXPECT_EQ( 8, oss.str().size() );
+    }
+    {
+        comma::uint32 input[] = { 1, 2, 3, 4 };
+        std::istringstream iss( std::string( reinterpret_cast< const char* >( input ), sizeof( input ) ) );
+        comma::csv::options csv;
+        csv.format( "2ui" );
+        comma::csv::input_stream< test_struct > is( iss, csv );
+        std::ostringstream oss;
+        comma::csv::output_stream< test_struct > os( oss, csv );
+        os.binary().buffer( 10 );
+        while( is.read() ) { comma::csv::append( is, os, test_struct( 10, 20 ) ); }
+        EXPECT_TRUE( oss.str().empty() );
+        os.os() << "x"; // buffered records get written first
+        comma::uint32 expected[] = { 1, 2, 10, 20, 3, 4, 10, 20 };
+        ASSERT_EQ( 33, oss.str().size() );
+        EXPECT_EQ( 0, std::memcmp( expected, &oss.str()[0], 32 ) );
+        EXPECT_EQ( 'x', oss.str()[32] );
+    }
+    {
+        std::ostringstream oss;
+        comma::csv::binary_output_stream< test_struct > os( oss, "2ui" );
+        os.buffer( 100, boost::posix_time::milliseconds( 20 ) );
+        EXPECT_TRUE( os.due().is_pos_infinity() );
+        os.write( test_struct( 1, 2 ) );
+        EXPECT_EQ( 8, os.buffered() );
+        EXPECT_TRUE( os.due() > boost::posix_time::time_duration( 0, 0, 0 ) );
+        EXPECT_TRUE( os.due() <= boost::posix_time::milliseconds( 20 ) );
+        std::this_thread::sleep_for( std::chrono::milliseconds( 30 ) );
+        EXPECT_EQ( boost::posix_time::time_duration( 0, 0, 0 ), os.due() ); // overdue, but not written until the next write or flush
+        EXPECT_TRUE( oss.str().empty() );
+        os.flush();
+        EXPECT_EQ( 8, oss.str().size() );
+        EXPECT_EQ( 0, os.buffered() );
+        EXPECT_TRUE( os.due().is_pos_infinity() );
+    }
+}
+
 } } } // namespace comma { namespace csv { namespace stream_test {
 
 namespace comma { namespace csv { namespace stream_test {
@@ -20,6 +20,7 @@ template <> struct traits< comma::csv::options >
         v.apply( "precision", p.precision );
         v.apply( "quote", p.quote ? std::string( 1, *p.quote ) : std::string() );
         v.apply( "flush", p.flush );
+        v.apply( "mmap", p.mmap );
         if( p.binary() ) { v.apply( "binary", p.format().string() ); }
 
     }
@@ -40,6 +41,7 @@ template <> struct traits< comma::csv::options >
             case 2: COMMA_THROW( comma::exception, "expected a quote character, got \"" << quote << "\"" );
         }
         v.apply( "flush", p.flush );
+        v.apply( "mmap", p.mmap );
         std::string s;
         v.apply( "binary", s );
         if( s != "" ) { p.format( s ); }
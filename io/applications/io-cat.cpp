@@ -34,7 +34,13 @@
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #endif
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#endif
 
+#include <cstring>
 #include <vector>
 #include <boost/asio/ip/udp.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
@@ -56,6 +62,9 @@ read from one or a few sources, merge, and output to stdout
 
 usage: io-cat <address> [<address>] ... [<options>]
 
+in linux, sources are watched with epoll, thus the number of sources is limited only
+by the limit on open files (see ulimit -n), not by FD_SETSIZE (1024)
+
 <address>
     local:<path>: local socket
     tcp:<host>:<port>: tcp socket
@@ -69,6 +78,11 @@ usage: io-cat <address> [<address>] ... [<options>]
 options
     --exit-on-first-closed,-e: exit, if one of the streams finishes
     --flush,--unbuffered,-u: flush output
+    --no-splice: in linux, on binary input (--size or a single input) without --head or --repeat,
+                 data is passed with splice() system call without copying it to user space, if input
+                 is a pipe and output is a pipe, socket, or regular file, or if input is a socket or
+                 regular file and output is a pipe; --size and --round-robin record boundaries
+                 are preserved; use --no-splice to disable it, e.g. for debugging
     --verbose,-v: more output
 
 output order options
@@ -162,6 +176,7 @@ class stream
         virtual void remove_from( comma::io::select& select ) const { select.read().remove( fd() ); }
         virtual bool ready( comma::io::select& select ) const { return select.read().ready( fd() ); }
         virtual void update( comma::io::select& select ) const {}
+        virtual bool spliced() const { return false; } // if true, read_available() already has written data to stdout
         const std::string& address() const { return address_; }
         
     protected:
@@ -219,17 +234,42 @@ class udp_stream : public stream
         mutable boost::scoped_ptr< boost::asio::ip::udp::socket > socket_; // boost::asio::ip::udp::socket::fd() is non-const for some reason
 };
 
+#ifdef __linux__
+static bool is_pipe( int fd )
+{
+    struct stat s;
+    return ::fstat( fd, &s ) == 0 && S_ISFIFO( s.st_mode );
+}
+
+static bool can_splice_from( int fd ) // can splice to a pipe from
+{
+    struct stat s;
+    return ::fstat( fd, &s ) == 0 && ( S_ISFIFO( s.st_mode ) || S_ISSOCK( s.st_mode ) || S_ISREG( s.st_mode ) );
+}
+
+static bool can_splice_to( int fd ) // can splice from a pipe to
+{
+    struct stat s;
+    if( ::fstat( fd, &s ) != 0 ) { return false; }
+    if( S_ISFIFO( s.st_mode ) || S_ISSOCK( s.st_mode ) ) { return true; }
+    return S_ISREG( s.st_mode ) && !( ::fcntl( fd, F_GETFL ) & O_APPEND );
+}
+#endif
+
 class client_stream : public stream
 {
     public:
-        client_stream( const std::string& address, unsigned int size, bool binary ): stream( address ), size_( size ), binary_( binary ), closed_( false ) {}
+        client_stream( const std::string& address, unsigned int size, bool binary, bool splice ): stream( address ), size_( size ), binary_( binary ), closed_( false ), splice_( splice ) {}
         
         comma::io::file_descriptor fd() const { return ( *istream_ ).fd(); }
         
+        bool spliced() const { return spliced_; }
+        
         unsigned int read_available( std::vector< char >& buffer, unsigned int max_count, bool blocking )
         {
             std::size_t available = available_();
             if( !blocking && available == 0 ) { return 0; }
+            if( spliced_ ) { return splice_available_( available, buffer.size(), max_count ); }
             if( binary_ )
             {
                 unsigned int count = size_ ? available / size_ : 0;
@@ -253,7 +293,7 @@ class client_stream : public stream
         
         bool empty() const { return !connected() || closed_ || available_() == 0; }
         
-        bool eof() const { return bool( istream_ ) && ( !( *istream_ )->good() || ( *istream_ )->eof() ); }
+        bool eof() const { return eof_ || ( bool( istream_ ) && ( !( *istream_ )->good() || ( *istream_ )->eof() ) ); }
         
         void close() { closed_ = true; ( *istream_ ).close(); }
         
@@ -266,6 +306,10 @@ class client_stream : public stream
             if( istream_ ) { return; }
             auto blocking_mode = false ? comma::io::mode::non_blocking : comma::io::mode::blocking; // todo? expose on command line?
             istream_.reset( new comma::io::istream( address_, comma::io::mode::binary, blocking_mode ) );
+            #ifdef __linux__
+            spliced_ = splice_ && ( *istream_ ).fd() != comma::io::invalid_file_descriptor && can_splice_from( ( *istream_ ).fd() ) && ( is_pipe( ( *istream_ ).fd() ) || is_pipe( 1 ) );
+            if( spliced_ ) { comma::saymore() << address_ << ": passing data with splice()" << std::endl; }
+            #endif
             if( ( *istream_ )() != &std::cin ) { return; }
             std::ios_base::sync_with_stdio( false ); // unsync to make rdbuf()->in_avail() working
             std::cin.tie( NULL ); // std::cin is tied to std::cout by default
@@ -276,6 +320,54 @@ class client_stream : public stream
         unsigned int size_;
         bool binary_;
         bool closed_;
+        bool splice_;
+        bool spliced_{false};
+        bool eof_{false};
+        
+        static void wait_( int fd ) // e.g. asio sockets are non-blocking: wait on the side that is non-blocking
+        {
+            #ifdef __linux__
+            pollfd p[2] = { { fd, short( ::fcntl( fd, F_GETFL ) & O_NONBLOCK ? POLLIN : 0 ), 0 }, { 1, short( ::fcntl( 1, F_GETFL ) & O_NONBLOCK ? POLLOUT : 0 ), 0 } };
+            ::poll( p, 2, -1 );
+            #endif
+        }
+        
+        unsigned int splice_available_( std::size_t available, std::size_t buffer_size, unsigned int max_count ) // move whole records from input to stdout in kernel
+        {
+            #ifdef __linux__
+            std::size_t size;
+            if( size_ )
+            {
+                std::size_t count = available / size_;
+                if( max_count && count > max_count ) { count = max_count; }
+                if( count == 0 ) { count = 1; } // at least one packet
+                size = count * size_;
+            }
+            else
+            {
+                size = available ? std::min( available, buffer_size ) : buffer_size;
+            }
+            std::cout.flush(); // preserve order with output of streams that did not splice
+            std::size_t moved = 0;
+            while( moved < size )
+            {
+                ssize_t n = ::splice( ( *istream_ ).fd(), NULL, 1, NULL, size - moved, SPLICE_F_MOVE );
+                if( n < 0 )
+                {
+                    if( errno == EINTR ) { continue; }
+                    if( errno == EAGAIN ) { wait_( ( *istream_ ).fd() ); continue; }
+                    if( errno == EPIPE ) { std::cout.setstate( std::ios::badbit ); return moved; } // output closed
+                    COMMA_THROW( comma::exception, "io-cat: " << address_ << ": splice failed: " << std::strerror( errno ) );
+                }
+                if( n == 0 ) { eof_ = true; break; }
+                moved += n;
+                if( size_ == 0 ) { break; } // no records, output whatever is available
+            }
+            return moved;
+            #else
+            return 0;
+            #endif
+        }
         
         std::size_t available_() const // seriously quick and dirty
         {
@@ -380,13 +472,13 @@ class server_stream : public stream // todo! super-quick and dirty! get streams
         comma::io::iserver _server;
 };
 
-static stream* make_stream( const std::string& address, unsigned int size, bool binary, bool blocking )
+static stream* make_stream( const std::string& address, unsigned int size, bool binary, bool blocking, bool splice )
 {
     const std::vector< std::string >& v = comma::split( address, ':' );
     if( v[0] == "udp" ) { return new udp_stream( address ); }
     if( v[0] == "tcp" && v.size() == 2 ) { return new server_stream( address, size, binary, blocking ); } // todo: quick and dirty for now; a better check if tcp:<port>-like
     COMMA_ASSERT_BRIEF( v[0] != "zmq-local" && v[0] != "zero-local" && v[0] != "zmq-tcp" && v[0] != "zero-tcp", "zmq support not implemented" );
-    return new client_stream( address, size, binary );
+    return new client_stream( address, size, binary, splice );
 }
 
 static bool verbose;
@@ -529,7 +621,7 @@ int main( int argc, char** argv )
         connect_period = boost::posix_time::milliseconds( static_cast<unsigned int>(std::floor( connect_period_seconds * 1000 ) ));
         permissive = options.exists( "--permissive" );
         bool has_head = options.exists( "--head" );
-        const std::vector< std::string >& unnamed = options.unnamed( "--repeat-forever,--forever,--blocking,--permissive,--exit-on-first-closed,-e,--flush,--unbuffered,-u,--verbose,-v", "-.+" );
+        const std::vector< std::string >& unnamed = options.unnamed( "--repeat-forever,--forever,--blocking,--permissive,--exit-on-first-closed,-e,--flush,--unbuffered,-u,--verbose,-v,--no-splice", "-.+" );
         options.assert_mutually_exclusive( "--round-robin", "--repeat,--repeat-forever,--forever" );
         #ifdef WIN32
         if( size || ( unnamed.size() == 1 && !has_head ) ) { _setmode( _fileno( stdout ), _O_BINARY ); }
@@ -539,7 +631,12 @@ int main( int argc, char** argv )
         output = output_t( options, unnamed.size() );
         boost::ptr_vector< stream > streams;
         comma::io::select select;
-        for( unsigned int i = 0; i < unnamed.size(); ++i ) { streams.push_back( make_stream( unnamed[i], size, size > 0 || ( unnamed.size() == 1 && !has_head ), blocking ) ); }
+        bool binary = size > 0 || ( unnamed.size() == 1 && !has_head );
+        bool splice = false;
+        #ifdef __linux__
+        splice = binary && !has_head && !output && !options.exists( "--no-splice" ) && can_splice_to( 1 );
+        #endif
+        for( unsigned int i = 0; i < unnamed.size(); ++i ) { streams.push_back( make_stream( unnamed[i], size, binary, blocking, splice ) ); }
         //for( unsigned int i = 0; i < unnamed.size(); ++i ) { streams.push_back( make_stream( unnamed[i], size, size > 0 ) ); }
         comma::saymore() << "created " << unnamed.size() << " stream" << ( unnamed.size() == 1 ? "" : "s" ) << std::endl;
         const unsigned int max_count = size ? ( size > 65536u ? 1 : 65536u / size ) : 0;
@@ -573,7 +670,7 @@ int main( int argc, char** argv )
                     if( bytes_read == 0 ) { break; }
                     done = false;
                     COMMA_ASSERT_BRIEF( !( size && bytes_read % size != 0 ), "stream " << i << " (" << streams[i].address() << "): expected " << size << " byte(s), got only " << ( bytes_read % size ) );
-                    if( !_write( i, options, buffer, bytes_read ) ) { done = true; break; }
+                    if( !streams[i].spliced() && !_write( i, options, buffer, bytes_read ) ) { done = true; break; }
                     if( !std::cout.good() ) { done = true; break; }
                     if( unbuffered ) { std::cout.flush(); }
                     if( round_robin_count )
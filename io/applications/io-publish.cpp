@@ -51,6 +51,11 @@ stream options
 client options
     --exit-on-no-clients,-e: once the last client disconnects, exit
     --output-number-of-clients,--clients: output to stdout timestamped number of clients whenever it changes
+    --statistics,--stats=<seconds>: output to stderr per-client lag and drop counters for clients of
+                                    endpoints with policy (see below) every <seconds> and on exit
+                                    fields: t,endpoint,fd,buffered,buffered_bytes,max_buffered,sent,dropped,state
+                                    endpoint: index of endpoint on the command line
+                                    state: connected; overflow or error for clients disconnected since the last output
 
     attention: in the current implementation, the number of clients will be
                updated only on attempt to write a new record,
@@ -76,6 +81,10 @@ output streams: <address>[;<options>]
         tcp:<port>: e.g. tcp:1234
         udp:<port>: e.g. udp:1234 (todo)
         local:<name>: linux/unix local server socket e.g. local:./tmp/my_socket
+        shm:<name>[:<size>]: shared memory ring of <size> bytes (default: 64MB), linux only
+                             consumers (e.g. io-cat shm:<name>) read from the latest data on, each at its own pace;
+                             consumers lagging by more than the ring size skip to the latest data;
+                             only processes of the same user can read the ring
         <named pipe name>: named pipe, which will be re-opened, if client reconnects
         <filename>: a regular file
         -: stdout
@@ -85,6 +94,18 @@ output streams: <address>[;<options>]
                    if a client connects to a 'primary' stream, 'secondary' streams will be opened
                    if last client on a 'primary' stream disconnects, 'secondary' streams will be closed
                    e.g: io-publish tcp:8888 'tcp:9999;secondary'
+        policy=<policy>: tcp and local sockets only; each client gets a buffer of --buffer packets, which is
+                         written to the client with non-blocking batched writes as soon as the client is ready,
+                         also while io-publish waits for input, so that a slow client does not stall other clients
+            <policy>
+                none (default): no buffer; write to the client directly; if --no-discard, block on the client,
+                                otherwise discard packet if the client is not ready
+                drop-oldest: if client buffer full, discard the oldest buffered packet
+                drop-newest: if client buffer full, discard the new packet
+                disconnect: if client buffer full, i.e. client lags more than <buffer> packets, disconnect it
+                block: if client buffer full, wait for the client, which stalls all the other clients
+        buffer=<packets>: client buffer size for policy; default: 1024
+                   e.g: io-publish 'tcp:8888;policy=drop-oldest;buffer=100' 'tcp:9999;policy=disconnect' --stats=1
 
 examples
     cat data | io-publish tcp:1234 --size 100
@@ -180,6 +201,7 @@ int main( int ac, char** av )
         COMMA_ASSERT_BRIEF( !reconnect_on_read_timeout || read_timeout, "--reconnect-on-timeout requires --read-timeout <seconds>" );
         COMMA_ASSERT_BRIEF( !reconnect_on_read_timeout || !exec_command.empty(), "--reconnect-on-timeout requires --exec <command>" );
         COMMA_ASSERT_BRIEF( !timeout_is_error || read_timeout, "--timeout-is-error requires --read-timeout <seconds>" );
+        boost::optional< double > statistics_period = options.optional< double >( "--statistics,--stats" );
         comma::io::impl::publish p( names
                                   , options.value( "-s,--size", 0 ) * options.value( "-m,--multiplier", 1 )
                                   , !options.exists( "--no-discard" )
@@ -188,6 +210,15 @@ int main( int ac, char** av )
                                   , exit_on_no_clients || on_demand
                                   , options.value( "--cache-size,--cache", 0 )
                                   , read_timeout );
+        boost::posix_time::ptime statistics_time = boost::posix_time::microsec_clock::universal_time();
+        auto output_statistics = [&]( bool force )
+        {
+            if( !statistics_period ) { return; }
+            boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+            if( !force && ( now - statistics_time ).total_microseconds() < *statistics_period * 1000000 ) { return; }
+            p.write_statistics( std::cerr );
+            statistics_time = now;
+        };
         if( !tail.empty() )
         {
             COMMA_ASSERT_BRIEF( exec_command.empty(), "expected either --exec or --, got both" );
@@ -201,7 +232,9 @@ int main( int ac, char** av )
             std::cin.tie( NULL ); // std::cin is tied to std::cout by default
             while( std::cin.good() && !is_shutdown && !p.is_timeout() )
             {
-                if( !p.read( std::cin ) )
+                bool ok = p.read( std::cin );
+                output_statistics( false );
+                if( !ok )
                 {
                     if( exit_on_no_clients ) { break; }
                     if( read_timeout && p.is_timeout() ) { comma::say() << "timeout: received no data after " << *read_timeout << " seconds" << std::endl; break; }
@@ -223,7 +256,9 @@ int main( int ac, char** av )
                 boost::iostreams::stream< fd_t > is( fd_t( cmd.fd(), boost::iostreams::never_close_handle ) );
                 while( is.good() && !is_shutdown )
                 {
-                    if( p.read( is, cmd.fd() ) ) { continue; }
+                    bool ok = p.read( is, cmd.fd() );
+                    output_statistics( false );
+                    if( ok ) { continue; }
                     //if( exit_on_no_clients ) { break; }
                     if( read_timeout && p.is_timeout() )
                     {
@@ -237,6 +272,7 @@ int main( int ac, char** av )
             }
         }
         //ProfilerStop(); }
+        output_statistics( true );
         if( p.is_timeout() ) { return timeout_is_error ? 1 : 0; }
         if( is_shutdown ) { comma::say() << "interrupted by signal" << std::endl; }
         return 0;
@@ -35,6 +35,11 @@
 #include <cerrno>   // for errno
 #include <iostream>
 #include <csignal>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include <boost/array.hpp>
 #include <boost/optional.hpp>
 #include "../../application/command_line_options.h"
@@ -57,6 +62,9 @@ static void show_help( bool verbose = false )
         << "    --dry-run,--dry: print command that will be piped and exit, debug option" << std::endl
         << "    --append,-a: append to output file instead of overwriting" << std::endl
         << "    --unbuffered,-u: unbuffered input and output" << std::endl
+        << "    --no-splice: in linux, if stdin is a pipe and stdout is a pipe, socket or regular file, io-tee" << std::endl
+        << "                 passes data with tee() and splice() system calls without copying it to user space" << std::endl
+        << "                 (always unbuffered); use --no-splice to disable it, e.g. for debugging" << std::endl
         << "    --debug: extra debug output (not for normal use)" << std::endl
         << "    --verbose,-v: more output" << std::endl
         << std::endl
@@ -108,6 +116,54 @@ static std::string escape_quotes( const char *s )
     return result;
 }
 
+#ifdef __linux__
+static bool is_pipe( int fd )
+{
+    struct stat s;
+    return ::fstat( fd, &s ) == 0 && S_ISFIFO( s.st_mode );
+}
+
+static bool can_splice_to( int fd ) // splice from pipe works to pipes, sockets, and regular files not opened for appending
+{
+    struct stat s;
+    if( ::fstat( fd, &s ) != 0 ) { return false; }
+    if( S_ISFIFO( s.st_mode ) || S_ISSOCK( s.st_mode ) ) { return true; }
+    return S_ISREG( s.st_mode ) && !( ::fcntl( fd, F_GETFL ) & O_APPEND );
+}
+
+// duplicate stdin to command pipe with tee(), then move the same bytes to stdout with splice()
+// if stdout is gone, keep feeding the command as the buffered path does
+static bool tee_and_splice( int pipe_fd, bool debug )
+{
+    bool stdout_ok = true;
+    boost::array< char, 0xffff > discarded;
+    while( true )
+    {
+        ssize_t size = ::tee( 0, pipe_fd, 1 << 20, 0 );
+        if( size < 0 )
+        {
+            if( errno == EINTR ) { continue; }
+            std::cerr << "io-tee: error on pipe: " << std::strerror( errno ) << std::endl;
+            return false;
+        }
+        if( size == 0 ) { return true; }
+        if ( debug ) { std::cerr << "io-tee: teed " << size << " bytes to pipe" << std::endl; }
+        for( ssize_t left = size; left > 0; )
+        {
+            ssize_t n = stdout_ok ? ::splice( 0, NULL, 1, NULL, left, SPLICE_F_MOVE ) : ::read( 0, &discarded[0], std::min( left, ssize_t( discarded.size() ) ) );
+            if( n < 0 )
+            {
+                if( errno == EINTR ) { continue; }
+                if( stdout_ok ) { stdout_ok = false; continue; }
+                std::cerr << "io-tee: error on stdin: " << std::strerror( errno ) << std::endl;
+                return false;
+            }
+            left -= n;
+        }
+    }
+}
+#endif
+
 int main( int ac, char **av )
 {
     FILE *pipe = NULL;
@@ -135,7 +191,7 @@ int main( int ac, char **av )
             std::cerr << std::endl;
         }
         comma::command_line_options options( options_ac, av );
-        const std::vector< std::string >& unnamed = options.unnamed( "--unbuffered,-u,--verbose,-v,--debug,--dry-run,--dry,--append,-a", "-.*" );
+        const std::vector< std::string >& unnamed = options.unnamed( "--unbuffered,-u,--verbose,-v,--debug,--dry-run,--dry,--append,-a,--no-splice", "-.*" );
         if( unnamed.empty() ) { std::cerr << "io-tee: please specify output file name" << std::endl; return 1; }
         if( unnamed.size() > 1 ) { std::cerr << "io-tee: expected one output filename, got: " << comma::join( unnamed, ' ' ) << std::endl; return 1; }
         std::string outfile = unnamed[0];
@@ -156,6 +212,15 @@ int main( int ac, char **av )
         std::cout.flush();
         pipe = ::popen( &command[0], "w" );
         if( pipe == NULL ) { std::cerr << "io-tee: failed to open pipe; command: " << command << std::endl; return 1; }
+        bool zero_copy = false;
+        #ifdef __linux__
+        zero_copy = !options.exists( "--no-splice" ) && is_pipe( 0 ) && can_splice_to( 1 );
+        if( zero_copy )
+        {
+            if( verbose ) { std::cerr << "io-tee: stdin is a pipe; passing data with tee() and splice()" << std::endl; }
+            if( !tee_and_splice( fileno( pipe ), debug ) ) { ::pclose( pipe ); return 1; }
+        }
+        #endif
         boost::array< char, 0xffff > buffer;
         if ( debug ) { std::cerr << "io-tee: created buffer" << std::endl; }
         comma::io::select stdin_select;
@@ -168,7 +233,7 @@ int main( int ac, char **av )
             std::ios_base::sync_with_stdio( false ); // unsync to make rdbuf()->in_avail() working
             std::cin.tie( NULL ); // std::cin is tied to std::cout by default
         }
-        while( std::cin.good() )
+        while( !zero_copy && std::cin.good() )
         {
             if ( debug ) { std::cerr << "io-tee: loop" << std::endl; }
             std::size_t bytes_to_read = buffer.size();
@@ -33,6 +33,13 @@
 #ifndef WIN32
 #include <stdlib.h>
 #endif
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <cstring>
+#endif
 #include <iostream>
 #include <sstream>
 #include <type_traits>
@@ -72,6 +79,10 @@ attention! it is possible to receive several packets udp packets in a single
 
 options
     --ascii; output timestamp as ascii; default: 64-bit binary
+    --batch=<n>; default=64; linux only: receive up to <n> packets per system call (recvmmsg)
+    --busy-poll=<microseconds>; linux only: busy poll socket for given time on receive (SO_BUSY_POLL),
+                                which trades cpu for lower latency; values above net.core.busy_poll
+                                require CAP_NET_ADMIN
     --cache-size,--cache=<n>; default=0; number of cached records; if a new client connects, the
                                          the cached records will be sent to it once connected
     --delimiter=<delimiter>: if ascii and --timestamp, use this delimiter; default: ','
@@ -84,12 +95,20 @@ options
             size: data size in bytes
             data: udp packet data
     --flush; flush stdout after each packet
+    --rcvbuf=<bytes>; socket receive buffer size (SO_RCVBUF); large buffer helps to absorb bursts
+                      at high packet rates; capped by net.core.rmem_max
     --reuse-addr,--reuseaddr: reuse udp address/port
     --size=<size>; default=16384; hint of maximum buffer size in bytes, if using timestamped
                                   fixed-width data, use --size=<fixed-width-size>, otherwise
                                   multiple packets may be read from the UDP socket at once
-    --timestamp: deprecated, use --fields; output packet timestamp; currently just system
-                 time as UTC; if binary, little endian uint64
+    --time-source=<source>; default=kernel on linux, system otherwise; source of t field
+        <source>
+            hardware: network card receive time (SO_TIMESTAMPING), if the card and driver support it
+                      and hardware timestamping is enabled on the interface (e.g. hwstamp_ctl -r 1),
+                      otherwise kernel receive time; linux only
+            kernel: kernel receive time (SO_TIMESTAMPNS); linux only
+            system: system time when udp-client got the packet
+    --timestamp: deprecated, use --fields; output packet timestamp as UTC; if binary, little endian uint64
 
 output streams: <address>
     <address>
@@ -108,6 +127,8 @@ examples
         udp-client 12435 --fields=t,data > timestamped.bin
         udp-client 12435 --fields=t,size,data > timestamp.size.bin
         udp-client 12435 --fields=t,size,data --ascii > timestamp.size.csv
+    high packet rate, e.g. lidar
+        udp-client 2368 --fields=t,size,data --size=1206 --rcvbuf=16777216 --batch=256 > lidar.bin
     re-publishing
         udp-client 12435 tcp::4567 
         udp-client 12435 tcp::4567 tcp::7890 
@@ -116,6 +137,99 @@ examples
     exit( 0 );
 }
 
+#ifdef __linux__
+struct time_source { enum values { system, kernel, hardware }; };
+
+static time_source::values time_source_from_string( const std::string& s )
+{
+    if( s == "system" ) { return time_source::system; }
+    if( s == "kernel" ) { return time_source::kernel; }
+    if( s == "hardware" ) { return time_source::hardware; }
+    COMMA_THROW( comma::exception, "expected time source: system, kernel, or hardware; got: '" << s << "'" );
+}
+
+static void set_option( int fd, int level, int name, int value, const std::string& what )
+{
+    COMMA_ASSERT_BRIEF( ::setsockopt( fd, level, name, &value, sizeof( value ) ) == 0, "failed to set " << what << " to " << value << ": " << std::strerror( errno ) );
+}
+
+// receive up to a batch of packets per system call, each into its own slot with header space of given size before packet data
+class receiver
+{
+    public:
+        receiver( int fd, unsigned int header_size, unsigned int max_size, unsigned int batch, time_source::values source )
+            : fd_( fd )
+            , header_size_( header_size )
+            , slot_size_( header_size + max_size )
+            , source_( source )
+            , buffer_( std::size_t( slot_size_ ) * batch )
+            , control_( control_size_ * batch )
+            , messages_( batch )
+            , iovecs_( batch )
+        {
+            if( source_ == time_source::kernel ) { set_option( fd_, SOL_SOCKET, SO_TIMESTAMPNS, 1, "SO_TIMESTAMPNS" ); }
+            if( source_ == time_source::hardware ) { set_option( fd_, SOL_SOCKET, SO_TIMESTAMPING, SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE, "SO_TIMESTAMPING" ); }
+            for( unsigned int i = 0; i < batch; ++i )
+            {
+                iovecs_[i].iov_base = &buffer_[ std::size_t( slot_size_ ) * i + header_size_ ];
+                iovecs_[i].iov_len = max_size;
+                std::memset( &messages_[i], 0, sizeof( mmsghdr ) );
+                messages_[i].msg_hdr.msg_iov = &iovecs_[i];
+                messages_[i].msg_hdr.msg_iovlen = 1;
+            }
+        }
+
+        /// block until at least one packet, then take whatever else is already there, up to batch size
+        /// @return number of packets received, -1 on error
+        int receive()
+        {
+            for( unsigned int i = 0; i < messages_.size(); ++i ) // kernel overwrites control length
+            {
+                messages_[i].msg_hdr.msg_control = source_ == time_source::system ? nullptr : &control_[ control_size_ * i ];
+                messages_[i].msg_hdr.msg_controllen = source_ == time_source::system ? 0 : control_size_;
+            }
+            int n = ::recvmmsg( fd_, &messages_[0], messages_.size(), MSG_WAITFORONE, nullptr );
+            if( n > 0 && source_ == time_source::system ) { now_ = boost::posix_time::microsec_clock::universal_time(); }
+            return n;
+        }
+
+        /// @return slot with header space followed by packet data
+        char* packet( unsigned int i ) { return &buffer_[ std::size_t( slot_size_ ) * i ]; }
+
+        std::uint32_t size( unsigned int i ) const { return messages_[i].msg_len; }
+
+        boost::posix_time::ptime time( unsigned int i ) const
+        {
+            if( source_ == time_source::system ) { return now_; }
+            const msghdr& h = messages_[i].msg_hdr;
+            for( const cmsghdr* c = CMSG_FIRSTHDR( &h ); c; c = CMSG_NXTHDR( const_cast< msghdr* >( &h ), const_cast< cmsghdr* >( c ) ) )
+            {
+                if( c->cmsg_level != SOL_SOCKET ) { continue; }
+                if( c->cmsg_type == SCM_TIMESTAMPNS ) { return time_( *reinterpret_cast< const timespec* >( CMSG_DATA( c ) ) ); }
+                if( c->cmsg_type == SCM_TIMESTAMPING )
+                {
+                    const scm_timestamping& t = *reinterpret_cast< const scm_timestamping* >( CMSG_DATA( c ) );
+                    return time_( t.ts[2].tv_sec || t.ts[2].tv_nsec ? t.ts[2] : t.ts[0] ); // raw hardware time, if any, otherwise software
+                }
+            }
+            return boost::posix_time::microsec_clock::universal_time(); // quick and dirty: kernel did not timestamp the packet
+        }
+
+    private:
+        enum { control_size_ = CMSG_SPACE( sizeof( scm_timestamping ) ) };
+        int fd_;
+        unsigned int header_size_;
+        unsigned int slot_size_;
+        time_source::values source_;
+        std::vector< char > buffer_;
+        std::vector< char > control_;
+        std::vector< mmsghdr > messages_;
+        std::vector< iovec > iovecs_;
+        boost::posix_time::ptime now_;
+        static boost::posix_time::ptime time_( const timespec& t ) { return boost::posix_time::from_time_t( t.tv_sec ) + boost::posix_time::microseconds( t.tv_nsec / 1000 ); }
+};
+#endif // #ifdef __linux__
+
 int main( int argc, char** argv )
 {
     try
@@ -148,7 +262,6 @@ int main( int argc, char** argv )
         bool has_data = csv.has_field( "data" );
         static_assert( sizeof( boost::posix_time::ptime ) == 8 ); // quick and dirty
         unsigned max_size = options.value( "--size", 16384 );
-        std::vector< char > buffer( max_size + 12 ); // quick and dirty
         #if BOOST_VERSION >= 106600
             boost::asio::io_context service;
         #else
@@ -164,6 +277,22 @@ int main( int argc, char** argv )
             socket.set_option( boost::asio::ip::udp::socket::reuse_address( true ), error );
             COMMA_ASSERT_BRIEF( !bool( error ), "failed to set reuse address option on port " << port );
         }
+        if( options.exists( "--rcvbuf" ) )
+        {
+            int rcvbuf = options.value< int >( "--rcvbuf" );
+            socket.set_option( boost::asio::socket_base::receive_buffer_size( rcvbuf ), error );
+            COMMA_ASSERT_BRIEF( !bool( error ), "failed to set receive buffer size to " << rcvbuf << " on port " << port );
+            boost::asio::socket_base::receive_buffer_size actual;
+            socket.get_option( actual );
+            #ifdef __linux__
+            if( actual.value() < 2L * rcvbuf ) { comma::say() << "warning: --rcvbuf: requested " << rcvbuf << " bytes, kernel reports " << actual.value() << " (doubled for bookkeeping); increase net.core.rmem_max" << std::endl; } // linux doubles requested size, unless capped
+            #endif
+        }
+        #ifdef __linux__
+        if( options.exists( "--busy-poll" ) ) { set_option( socket.native_handle(), SOL_SOCKET, SO_BUSY_POLL, options.value< int >( "--busy-poll" ), "SO_BUSY_POLL" ); }
+        #else
+        COMMA_ASSERT_BRIEF( !options.exists( "--busy-poll,--batch,--time-source" ), "--busy-poll, --batch, --time-source: implemented on linux only" );
+        #endif
         socket.bind( boost::asio::ip::udp::endpoint( boost::asio::ip::udp::v4(), port ), error );
         COMMA_ASSERT_BRIEF( !bool( error ), "failed to bind port " << port );
         #ifdef WIN32
@@ -178,33 +307,48 @@ int main( int argc, char** argv )
                                   , false
                                   , options.value( "--cache-size,--cache", 0 ) );
         comma::signal_flag is_shutdown;
-        if( binary )
+        unsigned int offset = binary ? ( has_time ? 8 : 0 ) + ( has_size ? 4 : 0 ) : 0; // hyper-quick and dirty for now
+        auto output = [&]( char* packet, std::uint32_t size, const boost::posix_time::ptime& t ) // packet: offset bytes for header, followed by data
         {
-            unsigned int offset = ( has_time ? 8 : 0 ) + ( has_size ? 4 : 0 ); // hyper-quick and dirty for now
-            while( !is_shutdown )
+            if( binary )
             {
-                std::uint32_t size = socket.receive( boost::asio::buffer( &buffer[offset], max_size ), 0, error );
-                if( error || size == 0 ) { break; } // todo? throw on error?
-                if( has_time ) { comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::time >::to_bin( boost::posix_time::microsec_clock::universal_time(), &buffer[0] ); }
-                if( has_size ) { ::memcpy( &buffer[ has_time ? 8 : 0 ], reinterpret_cast< const char* >( &size ), 4 ); }
-                p.write( &buffer[0], offset + ( has_data ? size : 0 ) );
+                if( has_time ) { comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::time >::to_bin( t, packet ); }
+                if( has_size ) { ::memcpy( packet + ( has_time ? 8 : 0 ), reinterpret_cast< const char* >( &size ), 4 ); }
+                p.write( packet, offset + ( has_data ? size : 0 ) );
+                return;
             }
-        }
-        else
-        {
             std::string delimiter;
-            while( !is_shutdown )
+            std::ostringstream oss;
+            if( has_time ) { oss << boost::posix_time::to_iso_string( t ); delimiter = csv.delimiter; }
+            if( has_size ) { oss << delimiter << size; delimiter = csv.delimiter; }
+            if( has_data ) { oss << delimiter; oss.write( packet, size ); if( endl ) { oss << std::endl; } }
+            const std::string& s = oss.str();
+            p.write( &s[0], s.size() );
+        };
+        #ifdef __linux__
+        unsigned int batch = options.value( "--batch", 64 );
+        COMMA_ASSERT_BRIEF( batch > 0, "expected positive --batch, got 0" );
+        receiver r( socket.native_handle(), offset, max_size, batch, time_source_from_string( options.value< std::string >( "--time-source", "kernel" ) ) );
+        while( !is_shutdown )
+        {
+            int n = r.receive();
+            if( n < 0 && errno == EINTR ) { continue; }
+            if( n <= 0 ) { break; } // todo? throw on error?
+            for( int i = 0; i < n; ++i )
             {
-                std::size_t size = socket.receive( boost::asio::buffer( &buffer[0], max_size ), 0, error );
-                if( error || size == 0 ) { break; } // todo? throw on error?
-                std::ostringstream oss;
-                if( has_time ) { oss << boost::posix_time::to_iso_string( boost::posix_time::microsec_clock::universal_time() ); delimiter = csv.delimiter; }
-                if( has_size ) { oss << delimiter << size; delimiter = csv.delimiter; }
-                if( has_data ) { oss << delimiter; oss.write( &buffer[0], size ); if( endl ) { oss << std::endl; } }
-                const std::string& s = oss.str();
-                p.write( &s[0], s.size() );
+                if( r.size( i ) == 0 ) { return 0; }
+                output( r.packet( i ), r.size( i ), r.time( i ) );
             }
         }
+        #else
+        std::vector< char > buffer( offset + max_size );
+        while( !is_shutdown )
+        {
+            std::uint32_t size = socket.receive( boost::asio::buffer( &buffer[offset], max_size ), 0, error );
+            if( error || size == 0 ) { break; } // todo? throw on error?
+            output( &buffer[0], size, boost::posix_time::microsec_clock::universal_time() );
+        }
+        #endif
         return 0;
     }
     catch( std::exception& ex ) { comma::say() << ex.what() << std::endl; }
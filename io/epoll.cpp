@@ -0,0 +1,83 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include "../base/exception.h"
+#include "../base/last_error.h"
+#include "epoll.h"
+
+namespace comma { namespace io {
+
+epoll::epoll() : fd_( ::epoll_create1( EPOLL_CLOEXEC ) ), size_( 0 )
+{
+    if( fd_ < 0 ) { last_error::to_exception( "epoll_create1() failed" ); }
+}
+
+epoll::~epoll() { ::close( fd_ ); }
+
+void epoll::add( file_descriptor fd, const callback& c, unsigned int events )
+{
+    COMMA_ASSERT( fd >= 0, "epoll: expected valid descriptor, got " << fd );
+    COMMA_ASSERT( events & ( read | write ), "epoll: descriptor " << fd << ": expected read or write events" );
+    struct epoll_event e;
+    e.events = ( events & read ? EPOLLIN | EPOLLRDHUP : 0 ) | ( events & write ? EPOLLOUT : 0 ) | ( events & edge_triggered ? EPOLLET : 0 );
+    e.data.fd = fd;
+    bool added = has( fd );
+    if( ::epoll_ctl( fd_, added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &e ) < 0 ) { COMMA_THROW( comma::exception, "epoll: failed to add descriptor " << fd << ": " << last_error::to_string() ); }
+    if( entries_.size() <= std::size_t( fd ) ) { entries_.resize( fd + 1 ); }
+    entries_[fd].reset( new entry{ c, events } ); // new entry, since callback being called may replace itself
+    if( !added ) { ++size_; }
+}
+
+void epoll::remove( file_descriptor fd )
+{
+    if( !has( fd ) ) { return; }
+    struct epoll_event e; // for kernels before 2.6.9
+    ::epoll_ctl( fd_, EPOLL_CTL_DEL, fd, &e ); // may fail, if already closed, which is fine
+    entries_[fd].reset();
+    --size_;
+}
+
+bool epoll::has( file_descriptor fd ) const { return fd >= 0 && std::size_t( fd ) < entries_.size() && entries_[fd]; }
+
+std::size_t epoll::wait_( int timeout_milliseconds )
+{
+    if( size_ == 0 ) { return 0; }
+    std::size_t size = std::min( size_, std::size_t( 4096 ) );
+    if( events_.size() < size * sizeof( struct epoll_event ) ) { events_.resize( size * sizeof( struct epoll_event ) ); }
+    struct epoll_event* events = reinterpret_cast< struct epoll_event* >( &events_[0] );
+    int r = ::epoll_wait( fd_, events, size, timeout_milliseconds );
+    if( r < 0 )
+    {
+        if( errno != EINTR ) { last_error::to_exception( "epoll_wait() failed" ); } // do no throw if interrupted by signal
+        return 0;
+    }
+    std::size_t count = 0;
+    for( int i = 0; i < r; ++i )
+    {
+        file_descriptor fd = events[i].data.fd;
+        if( !has( fd ) ) { continue; } // removed by a callback called before
+        std::shared_ptr< entry > e = entries_[fd]; // keep entry alive, even if callback removes it
+        unsigned int ready = ( events[i].events & ( EPOLLIN | EPOLLRDHUP ) ? read : 0 ) | ( events[i].events & EPOLLOUT ? write : 0 );
+        if( events[i].events & ( EPOLLERR | EPOLLHUP ) ) { ready |= e->events & ( read | write ); }
+        e->c( fd, ready & e->events );
+        ++count;
+    }
+    return count;
+}
+
+std::size_t epoll::wait() { return wait_( -1 ); }
+
+std::size_t epoll::wait( boost::posix_time::time_duration timeout )
+{
+    boost::int64_t microseconds = timeout.total_microseconds();
+    return wait_( microseconds <= 0 ? 0 : int( std::min( ( microseconds + 999 ) / 1000, boost::int64_t( 0x7fffffff ) ) ) ); // round up to avoid spinning on short timeouts
+}
+
+} } // namespace comma { namespace io {
+
+#endif // #ifdef __linux__
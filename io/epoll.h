@@ -0,0 +1,72 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#pragma once
+
+#ifdef __linux__
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/noncopyable.hpp>
+#include "file_descriptor.h"
+
+namespace comma { namespace io {
+
+/// readiness-callback event loop on epoll (linux only)
+///
+/// unlike io::select, a callback is called for each ready descriptor, thus nothing
+/// needs to be scanned after wait; with edge-triggered descriptors, the callback is
+/// called once per change of readiness, i.e. it is expected to read or write until
+/// the descriptor would block (EAGAIN) and the descriptor should be non-blocking
+///
+/// callbacks may add or remove descriptors, including their own
+class epoll : public boost::noncopyable
+{
+    public:
+        enum events { read = 1, write = 2, edge_triggered = 4 };
+
+        /// callback called with the descriptor and ready events (read, write or both); on error or hang-up, it is called as ready for all events it was added for
+        typedef std::function< void( file_descriptor fd, unsigned int events ) > callback;
+
+        epoll();
+
+        ~epoll();
+
+        /// add descriptor or replace callback and events, if already added
+        /// @param events combination of read, write and edge_triggered
+        void add( file_descriptor fd, const callback& c, unsigned int events = read );
+
+        /// remove descriptor; remove it before closing
+        void remove( file_descriptor fd );
+
+        /// return true, if descriptor added
+        bool has( file_descriptor fd ) const;
+
+        /// return number of descriptors
+        std::size_t size() const { return size_; }
+
+        /// blocking wait, call callbacks of ready descriptors, return number of callbacks called
+        std::size_t wait();
+
+        /// wait with timeout, call callbacks of ready descriptors, return number of callbacks called
+        std::size_t wait( boost::posix_time::time_duration timeout );
+
+        /// same as wait( 0 )
+        std::size_t check() { return wait( boost::posix_time::time_duration() ); }
+
+        /// return epoll descriptor, e.g. to wait for it in io::select or another epoll
+        file_descriptor fd() const { return fd_; }
+
+    private:
+        struct entry { callback c; unsigned int events; };
+        file_descriptor fd_;
+        std::vector< std::shared_ptr< entry > > entries_; // indexed by descriptor
+        std::size_t size_;
+        std::vector< char > events_; // quick and dirty: buffer for epoll_event array, since sys/epoll.h is not included in header
+        std::size_t wait_( int timeout_milliseconds );
+};
+
+} } // namespace comma { namespace io {
+
+#endif // #ifdef __linux__
@@ -2,6 +2,11 @@
 // Copyright (c) 2020 Vsevolod Vlaskine
 // All rights reserved.
 
+#include <limits.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <cstring>
 #include "../../name_value/map.h"
 #include "publish.h"
 
@@ -23,6 +28,97 @@ template <> struct server_traits< io::oserver > // quick and dirty
     template < typename T > static void flush( T& s ) { s.flush(); }
 };
 
+policy::values policy::from_string( const std::string& s )
+{
+    if( s.empty() || s == "none" ) { return none; }
+    if( s == "drop-oldest" ) { return drop_oldest; }
+    if( s == "drop-newest" ) { return drop_newest; }
+    if( s == "disconnect" ) { return disconnect; }
+    if( s == "block" ) { return block; }
+    COMMA_THROW( comma::exception, "expected policy: none, drop-oldest, drop-newest, disconnect, or block; got: '" << s << "'" );
+}
+
+client::client( io::file_descriptor fd, std::size_t capacity ) : fd_( fd ), packets_( capacity < 2 ? 2 : capacity ) {}
+
+void client::push( const std::string& s )
+{
+    COMMA_ASSERT( !full(), "client " << fd_ << ": buffer full" );
+    at_( size_ ).assign( s ); // reuses string capacity
+    ++size_;
+    bytes_ += s.size();
+    if( size_ > statistics_.max_size ) { statistics_.max_size = size_; }
+}
+
+void client::pop_oldest()
+{
+    if( empty() ) { return; }
+    if( offset_ > 0 ) // oldest packet partially written, drop the next one to keep packets whole
+    {
+        if( size_ == 1 ) { return; }
+        std::swap( at_( 0 ), at_( 1 ) );
+    }
+    bytes_ -= at_( 0 ).size();
+    begin_ = ( begin_ + 1 ) % packets_.size();
+    --size_;
+    ++statistics_.dropped;
+}
+
+bool client::drain()
+{
+    static const std::size_t max_iov = IOV_MAX;
+    iovec iov[ max_iov ];
+    while( !empty() )
+    {
+        std::size_t n = std::min( size_, max_iov );
+        for( std::size_t i = 0; i < n; ++i )
+        {
+            std::string& p = at_( i );
+            iov[i].iov_base = &p[0];
+            iov[i].iov_len = p.size();
+        }
+        iov[0].iov_base = &at_( 0 )[ offset_ ];
+        iov[0].iov_len -= offset_;
+        msghdr m;
+        std::memset( &m, 0, sizeof( m ) );
+        m.msg_iov = iov;
+        m.msg_iovlen = n;
+        ssize_t written = ::sendmsg( fd_, &m, MSG_DONTWAIT | MSG_NOSIGNAL );
+        if( written < 0 )
+        {
+            if( errno == EINTR ) { continue; }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        std::size_t w = written;
+        bool partial = false;
+        while( w > 0 )
+        {
+            std::size_t left = at_( 0 ).size() - offset_;
+            if( w < left ) { offset_ += w; partial = true; break; }
+            w -= left;
+            bytes_ -= at_( 0 ).size();
+            offset_ = 0;
+            begin_ = ( begin_ + 1 ) % packets_.size();
+            --size_;
+            ++statistics_.sent;
+        }
+        if( partial || ( n < max_iov && !empty() ) ) { return true; } // socket buffer full
+    }
+    return true;
+}
+
+bool client::wait() const
+{
+    pollfd p;
+    p.fd = fd_;
+    p.events = POLLOUT;
+    while( true )
+    {
+        int r = ::poll( &p, 1, -1 );
+        if( r > 0 ) { return !( p.revents & ( POLLERR | POLLHUP | POLLNVAL ) ); }
+        if( r < 0 && errno != EINTR ) { return false; }
+    }
+}
+
 template < typename Server >
 multiserver< Server >::multiserver( const std::vector< std::string >& endpoints
                                   , unsigned int packet_size
@@ -42,13 +138,19 @@ multiserver< Server >::multiserver( const std::vector< std::string >& endpoints
     , sizes_( endpoints.size(), 0 )
     , num_clients_( 0 )
     , is_shutdown_( false )
+    , clients_( endpoints.size() )
+    , has_clients_buffers_( false )
 {
     bool has_primary_stream = false;
     for( unsigned int i = 0; i < endpoints.size(); ++i )
     {
         comma::name_value::map m( endpoints[i], "address", ';', '=' );
         bool secondary = !m.exists( "primary" ) && m.exists( "secondary" );
-        endpoints_.push_back( endpoint( m.value< std::string >( "address" ), secondary ) ); // todo? quick and dirty; better usage semantics?
+        const std::string& address = m.value< std::string >( "address" );
+        policy::values p = policy::from_string( m.value< std::string >( "policy", "" ) );
+        if( p != policy::none && address.substr( 0, 4 ) != "tcp:" && address.substr( 0, 6 ) != "local:" ) { COMMA_THROW( comma::exception, "'" << endpoints[i] << "': policy is supported only for tcp and local sockets" ); }
+        endpoints_.push_back( endpoint( address, secondary, p, m.value< std::size_t >( "buffer", 1024 ) ) ); // todo? quick and dirty; better usage semantics?
+        if( p != policy::none ) { has_clients_buffers_ = true; }
         if( !secondary ) { has_primary_stream = true; }
     }
     COMMA_ASSERT_BRIEF( has_primary_stream, "please specify at least one primary stream" );
@@ -80,6 +182,7 @@ void multiserver< Server >::disconnect_all()
 {
     transaction_t t( servers_ );
     for( auto& p: *t ) { if( p ) { p->disconnect_all(); } }
+    for( auto& c: clients_ ) { c.clear(); }
     handle_sizes_( t ); // quick and dirty
 }
 
@@ -137,7 +240,15 @@ void multiserver< Server >::accept_()
             if( ( *t )[i] && select.read().ready( ( *t )[i]->acceptor_file_descriptor() ) )
             {
                 const auto& streams = ( *t )[i]->accept();
-                if( !cache_.empty() )
+                if( endpoints_[i].policy != policy::none )
+                {
+                    for( auto& s: streams )
+                    {
+                        client& c = clients_[i][ s->fd() ] = client( s->fd(), endpoints_[i].buffer_size ); // overwrites stale client, if file descriptor reused
+                        for( auto it = cache_.begin() + ( cache_.size() > endpoints_[i].buffer_size ? cache_.size() - endpoints_[i].buffer_size : 0 ); it != cache_.end(); ++it ) { c.push( *it ); }
+                    }
+                }
+                else if( !cache_.empty() )
                 {
                     for( auto& s: streams )
                     {
@@ -164,6 +275,7 @@ void multiserver< Server >::accept_()
                 if( !endpoints_[i].secondary || !( *t )[i] ) { continue; }
                 select.read().remove( ( *t )[i]->acceptor_file_descriptor() );
                 ( *t )[i].reset();
+                clients_[i].clear();
             }
         }
     }
@@ -196,10 +308,124 @@ bool publish::write( const std::string& s )
         cache_.push_back( s );
         if( cache_.size() > cache_size_ ) { cache_.pop_front(); }
     }
-    for( auto& p: *t ) { if( p ) { p->write( &s[0], s.size(), false ); } } // for( std::size_t i = 0; i < t->size(); ++i ) { if( ( *t )[i] ) { ( *t )[i]->write( &buffer_[0], buffer_.size(), false ); } }
+    for( std::size_t i = 0; i < t->size(); ++i )
+    {
+        if( !( *t )[i] ) { continue; }
+        if( endpoints_[i].policy == policy::none ) { ( *t )[i]->write( &s[0], s.size(), false ); }
+        else { _write( i, s ); }
+    }
     return handle_sizes_( t );
 }
 
+void publish::_disconnect( std::size_t i, std::map< io::file_descriptor, client >::iterator it, const std::string& reason )
+{
+    transaction_t t( servers_ ); // recursive mutex: ok to lock again
+    ( *t )[i]->disconnect( it->first );
+    _disconnected.push_back( disconnected_t( i, it->second, reason ) ); // keep counters till the next write_statistics()
+    clients_[i].erase( it );
+}
+
+void publish::_write( std::size_t i, const std::string& s )
+{
+    for( auto it = clients_[i].begin(); it != clients_[i].end(); )
+    {
+        auto c = it++;
+        client& d = c->second;
+        if( d.full() && !d.drain() ) { _disconnect( i, c, "error" ); continue; }
+        if( d.full() )
+        {
+            switch( endpoints_[i].policy )
+            {
+                case policy::drop_oldest:
+                    d.pop_oldest();
+                    break;
+                case policy::drop_newest:
+                    d.drop();
+                    continue;
+                case policy::disconnect:
+                    _disconnect( i, c, "overflow" );
+                    continue;
+                case policy::block:
+                    while( d.full() && d.wait() && d.drain() );
+                    break;
+                case policy::none:
+                    break;
+            }
+            if( d.full() ) { _disconnect( i, c, "error" ); continue; }
+        }
+        d.push( s );
+        if( !d.drain() ) { _disconnect( i, c, "error" ); }
+    }
+}
+
+bool publish::_wait( io::file_descriptor fd ) // quick and dirty: poll rather than select, since a client may get closed by the acceptor thread while waiting
+{
+    boost::posix_time::ptime deadline;
+    if( _timeout ) { deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds( static_cast< long >( *_timeout * 1000000 ) ); }
+    std::vector< pollfd > fds;
+    while( true )
+    {
+        fds.resize( 1 );
+        fds[0].fd = fd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        {
+            transaction_t t( servers_ );
+            for( const auto& e: clients_ )
+            {
+                for( const auto& c: e )
+                {
+                    if( c.second.empty() ) { continue; }
+                    pollfd p;
+                    p.fd = c.first;
+                    p.events = POLLOUT;
+                    p.revents = 0;
+                    fds.push_back( p );
+                }
+            }
+        }
+        int timeout = -1;
+        if( _timeout )
+        {
+            long remaining = ( deadline - boost::posix_time::microsec_clock::universal_time() ).total_milliseconds();
+            timeout = remaining > 0 ? int( remaining ) : 0;
+        }
+        int r = ::poll( &fds[0], fds.size(), timeout );
+        if( r < 0 ) { return true; } // e.g. interrupted by signal: let read() handle it
+        if( fds[0].revents ) { return true; }
+        if( r == 0 ) { return false; }
+        transaction_t t( servers_ );
+        for( std::size_t i = 0; i < clients_.size(); ++i )
+        {
+            for( auto it = clients_[i].begin(); it != clients_[i].end(); )
+            {
+                auto c = it++;
+                if( !c->second.empty() && !c->second.drain() ) { _disconnect( i, c, "error" ); }
+            }
+        }
+        handle_sizes_( t );
+    }
+}
+
+void publish::write_statistics( std::ostream& os )
+{
+    transaction_t t( servers_ );
+    const std::string& time = boost::posix_time::to_iso_string( boost::posix_time::microsec_clock::universal_time() );
+    for( std::size_t i = 0; i < clients_.size(); ++i )
+    {
+        for( const auto& c: clients_[i] )
+        {
+            const client::statistics_t& s = c.second.statistics();
+            os << time << ',' << i << ',' << c.first << ',' << c.second.size() << ',' << c.second.bytes() << ',' << s.max_size << ',' << s.sent << ',' << s.dropped << ",connected" << std::endl;
+        }
+    }
+    for( const auto& d: _disconnected )
+    {
+        os << time << ',' << d.endpoint << ',' << d.fd << ',' << d.size << ',' << d.bytes << ',' << d.statistics.max_size << ',' << d.statistics.sent << ',' << d.statistics.dropped << ',' << d.reason << std::endl;
+    }
+    _disconnected.clear();
+}
+
 bool publish::write( const char* buf, unsigned int size )
 {
     return write( std::string( buf, size ) ); // todo: quick and dirty, watch performance
@@ -213,7 +439,12 @@ static bool _enough( std::istream& is, unsigned int size )
 
 bool publish::read( std::istream& is, io::file_descriptor fd )
 {
-    if( _timeout )
+    if( has_clients_buffers_ ) // drain client buffers while waiting for input
+    {
+        _is_timeout = false;
+        if( !_enough( is, packet_size_ ) && !is.eof() && !_wait( fd ) ) { _is_timeout = !_enough( is, packet_size_ ); if( _is_timeout ) { return false; } }
+    }
+    else if( _timeout )
     {
         _is_timeout = false;
         if( !_enough( is, packet_size_ ) && !is.eof() )
@@ -9,6 +9,7 @@
 #include <sys/wait.h>
 #include <unistd.h>
 #include <deque>
+#include <map>
 #include <memory>
 #include <boost/bind/bind.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -17,6 +18,7 @@
 #include <boost/optional.hpp>
 #include <boost/thread.hpp>
 #include "../../base/none.h"
+#include "../../base/types.h"
 #include "../../io/file_descriptor.h"
 #include "../../io/select.h"
 #include "../../io/server.h"
@@ -25,6 +27,72 @@
 
 namespace comma { namespace io { namespace impl {
 
+/// what to do, when a client does not keep up and its buffer is full
+struct policy
+{
+    enum values { none        // legacy: write to the client stream directly, discard or block depending on --no-discard
+                , drop_oldest // discard the oldest buffered packet
+                , drop_newest // discard the new packet
+                , disconnect  // disconnect the client
+                , block };    // wait until the client drains some of its buffer, which stalls all the other clients
+
+    static values from_string( const std::string& s );
+};
+
+/// outgoing buffer of a socket client: bounded ring of packets,
+/// written with non-blocking batched scatter-gather writes
+class client
+{
+    public:
+        struct statistics_t
+        {
+            comma::uint64 sent{0}; // number of fully sent packets
+            comma::uint64 dropped{0};
+            std::size_t max_size{0}; // maximum number of packets in the buffer so far
+        };
+
+        client( io::file_descriptor fd = io::invalid_file_descriptor, std::size_t capacity = 2 );
+
+        /// append packet, the buffer should not be full
+        void push( const std::string& s );
+
+        /// drop the oldest packet, which is not being written already
+        void pop_oldest();
+
+        /// count dropped packet
+        void drop() { ++statistics_.dropped; }
+
+        /// write as much as possible without blocking, return false on error
+        bool drain();
+
+        /// block until the client is ready for writing, return false on error
+        bool wait() const;
+
+        io::file_descriptor fd() const { return fd_; }
+
+        bool empty() const { return size_ == 0; }
+
+        bool full() const { return size_ == packets_.size(); }
+
+        /// number of buffered packets, i.e. client lag
+        std::size_t size() const { return size_; }
+
+        /// number of buffered bytes
+        std::size_t bytes() const { return bytes_ - offset_; }
+
+        const statistics_t& statistics() const { return statistics_; }
+
+    private:
+        io::file_descriptor fd_;
+        std::vector< std::string > packets_; // ring; strings are reused to avoid reallocation
+        std::size_t begin_{0};
+        std::size_t size_{0};
+        std::size_t offset_{0}; // number of already written bytes of the oldest packet
+        std::size_t bytes_{0};
+        statistics_t statistics_;
+        std::string& at_( std::size_t i ) { return packets_[ ( begin_ + i ) % packets_.size() ]; }
+};
+
 template < typename Server >
 class multiserver
 {
@@ -37,7 +105,9 @@ class multiserver
         {
             std::string address;
             bool secondary;
-            endpoint( const std::string& address = "", bool secondary = false ): address( address ), secondary( secondary ) {}
+            impl::policy::values policy;
+            std::size_t buffer_size;
+            endpoint( const std::string& address = "", bool secondary = false, impl::policy::values policy = impl::policy::none, std::size_t buffer_size = 0 ): address( address ), secondary( secondary ), policy( policy ), buffer_size( buffer_size ) {}
         };
         
         multiserver( const std::vector< std::string >& endpoints
@@ -71,6 +141,8 @@ class multiserver
         std::unique_ptr< boost::thread > acceptor_thread_;
         bool is_shutdown_;
         std::deque< std::string > cache_;
+        std::vector< std::map< io::file_descriptor, client > > clients_; // per endpoint; only for endpoints with policy other than none
+        bool has_clients_buffers_;
 
         bool is_binary_() const { return packet_size_ > 0; }
         bool handle_sizes_( transaction_t& t ); // todo? why pass transaction? it doen not seem going out of scope at the point of call; remove?
@@ -97,11 +169,30 @@ class publish : public multiserver< comma::io::oserver >
 
         bool is_timeout() const { return _is_timeout; }
 
+        /// output per-client lag and drop counters, one line per client:
+        /// <time>,<endpoint index>,<fd>,<buffered packets>,<buffered bytes>,<max buffered packets>,<sent packets>,<dropped packets>,<state>
+        /// where state: connected; or for clients disconnected since the last call: overflow (policy=disconnect), error (e.g. client gone)
+        void write_statistics( std::ostream& os );
+
     protected:
         comma::io::select _select;
         boost::optional< double > _timeout;
         io::file_descriptor _fd{0};
         bool _is_timeout{false};
+        struct disconnected_t
+        {
+            std::size_t endpoint;
+            io::file_descriptor fd;
+            std::size_t size;
+            std::size_t bytes;
+            client::statistics_t statistics;
+            std::string reason;
+            disconnected_t( std::size_t endpoint, const client& c, const std::string& reason ): endpoint( endpoint ), fd( c.fd() ), size( c.size() ), bytes( c.bytes() ), statistics( c.statistics() ), reason( reason ) {}
+        };
+        std::vector< disconnected_t > _disconnected;
+        void _write( std::size_t i, const std::string& s );
+        void _disconnect( std::size_t i, std::map< io::file_descriptor, client >::iterator it, const std::string& reason );
+        bool _wait( io::file_descriptor fd );
 };
 
 class receive : public multiserver< comma::io::iserver >
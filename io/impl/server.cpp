@@ -227,6 +227,15 @@ template < typename Stream > server< Stream >::server( const std::string& name,
     {
         _acceptor.reset( new zero_acceptor_< Stream >( name, mode ) );
     }
+#ifdef __linux__
+    else if( v[0] == "shm" ) // single stream; consumers attach to the shared memory ring on their own
+    {
+        Stream* s = new Stream( name, mode );
+        streams_.insert( std::unique_ptr< Stream >( s ) );
+        if( stream_traits< Stream >::is_input_stream ) { select_.read().add( s->fd() ); }
+        if( stream_traits< Stream >::is_output_stream ) { select_.write().add( s->fd() ); }
+    }
+#endif
     else
     {
         if( name == "-" )
@@ -262,6 +271,11 @@ template < typename Stream > void server< Stream >::disconnect_all()
     while( streams_.begin() != streams_.end() ) { _remove( streams_.begin() ); }
 }
 
+template < typename Stream > void server< Stream >::disconnect( io::file_descriptor fd )
+{
+    for( auto it = streams_.begin(); it != streams_.end(); ++it ) { if( ( *it )->fd() == fd ) { _remove( it ); return; } }
+}
+
 template < typename Stream > std::vector< Stream* > server< Stream >::accept()
 {
     std::vector< Stream* > streams;
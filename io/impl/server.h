@@ -49,6 +49,8 @@ class server
         
         void disconnect_all();
 
+        void disconnect( io::file_descriptor fd );
+
         std::size_t size() const;
 
         std::vector< Stream* > accept(); // quick and dirty; return naked pointers for now
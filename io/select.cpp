@@ -33,14 +33,161 @@
 #ifndef WIN32
 #include <cerrno>
 #endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
 
+#include <algorithm>
 #include <string>
 #include "../base/exception.h"
 #include "../base/last_error.h"
 #include "select.h"
 
 namespace comma { namespace io {
-    
+
+#ifdef __linux__
+
+select::select() : epoll_fd_( -1 ) {}
+
+select::select( const select& rhs ) : epoll_fd_( -1 ) { operator=( rhs ); }
+
+select& select::operator=( const select& rhs ) // quick and dirty: copy descriptors, but not the epoll instance
+{
+    if( this == &rhs ) { return *this; }
+    if( epoll_fd_ >= 0 ) { ::close( epoll_fd_ ); epoll_fd_ = -1; }
+    registered_.clear();
+    unpollable_.clear();
+    descriptors* to[] = { &read_descriptors_, &write_descriptors_, &except_descriptors_ };
+    const descriptors* from[] = { &rhs.read_descriptors_, &rhs.write_descriptors_, &rhs.except_descriptors_ };
+    for( unsigned int i = 0; i < 3; ++i )
+    {
+        to[i]->clear();
+        for( auto fd: from[i]->descriptors_ ) { to[i]->add( fd ); }
+    }
+    return *this;
+}
+
+select::~select() { if( epoll_fd_ >= 0 ) { ::close( epoll_fd_ ); } }
+
+void select::descriptors::set_ready_( file_descriptor fd )
+{
+    if( ready_.size() <= std::size_t( fd ) ) { ready_.resize( fd + 1, 0 ); }
+    if( ready_[fd] ) { return; }
+    ready_[fd] = 1;
+    ready_list_.push_back( fd );
+}
+
+void select::descriptors::reset_ready_()
+{
+    for( auto fd: ready_list_ ) { if( std::size_t( fd ) < ready_.size() ) { ready_[fd] = 0; } }
+    ready_list_.clear();
+}
+
+select::descriptors::descriptors() {}
+
+void select::descriptors::clear()
+{
+    changed_.insert( changed_.end(), descriptors_.begin(), descriptors_.end() );
+    removed_.insert( removed_.end(), descriptors_.begin(), descriptors_.end() );
+    descriptors_.clear();
+    reset_ready_();
+}
+
+void select::sync_()
+{
+    if( epoll_fd_ < 0 )
+    {
+        epoll_fd_ = ::epoll_create1( EPOLL_CLOEXEC );
+        if( epoll_fd_ < 0 ) { last_error::to_exception( "epoll_create1() failed" ); }
+    }
+    descriptors* all[] = { &read_descriptors_, &write_descriptors_, &except_descriptors_ };
+    std::set< file_descriptor > changed;
+    std::set< file_descriptor > removed;
+    for( descriptors* d: all )
+    {
+        changed.insert( d->changed_.begin(), d->changed_.end() );
+        removed.insert( d->removed_.begin(), d->removed_.end() );
+        d->changed_.clear();
+        d->removed_.clear();
+    }
+    // every change goes to the kernel, even if registered events look the same, since descriptor
+    // may have been closed and its number reused by a new file, which epoll does not know about
+    for( auto fd: changed )
+    {
+        unsigned int events = ( read_descriptors_.descriptors_.count( fd ) ? EPOLLIN : 0 )
+                            | ( write_descriptors_.descriptors_.count( fd ) ? EPOLLOUT : 0 )
+                            | ( except_descriptors_.descriptors_.count( fd ) ? EPOLLPRI : 0 );
+        unpollable_.erase( fd ); // new file with the same number may be pollable
+        if( registered_.size() <= std::size_t( fd ) ) { registered_.resize( fd + 1, 0 ); }
+        struct epoll_event e;
+        e.events = events;
+        e.data.fd = fd;
+        if( events == 0 || removed.count( fd ) ) { ::epoll_ctl( epoll_fd_, EPOLL_CTL_DEL, fd, &e ); registered_[fd] = 0; } // may fail, if already closed, which is fine
+        if( events == 0 ) { continue; }
+        int r = ::epoll_ctl( epoll_fd_, registered_[fd] == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &e );
+        if( r < 0 && errno == EEXIST ) { r = ::epoll_ctl( epoll_fd_, EPOLL_CTL_MOD, fd, &e ); }
+        else if( r < 0 && errno == ENOENT ) { r = ::epoll_ctl( epoll_fd_, EPOLL_CTL_ADD, fd, &e ); } // descriptor closed and reopened
+        if( r < 0 && errno == EPERM ) { unpollable_.insert( fd ); registered_[fd] = 0; continue; } // e.g. regular file
+        if( r < 0 ) { last_error::to_exception( "epoll_ctl() failed" ); }
+        registered_[fd] = events;
+    }
+}
+
+std::size_t select::wait_( int timeout_milliseconds )
+{
+    read_descriptors_.reset_ready_();
+    write_descriptors_.reset_ready_();
+    except_descriptors_.reset_ready_();
+    if( read_descriptors_.descriptors_.empty() && write_descriptors_.descriptors_.empty() && except_descriptors_.descriptors_.empty() ) { return 0; } // same as select() wrapper
+    sync_();
+    std::size_t count = 0;
+    for( auto fd: unpollable_ )
+    {
+        if( read_descriptors_.descriptors_.count( fd ) ) { read_descriptors_.set_ready_( fd ); ++count; }
+        if( write_descriptors_.descriptors_.count( fd ) ) { write_descriptors_.set_ready_( fd ); ++count; }
+    }
+    if( count > 0 ) { timeout_milliseconds = 0; }
+    std::size_t size = std::min( std::max( registered_.size(), std::size_t( 1 ) ), std::size_t( 4096 ) ); // the rest will be ready on the next wait, since level-triggered
+    if( events_.size() < size * sizeof( struct epoll_event ) ) { events_.resize( size * sizeof( struct epoll_event ) ); }
+    struct epoll_event* events = reinterpret_cast< struct epoll_event* >( &events_[0] );
+    int r = ::epoll_wait( epoll_fd_, events, size, timeout_milliseconds );
+    if( r < 0 )
+    {
+        if( errno != EINTR ) { last_error::to_exception( "epoll_wait() failed" ); } // do no throw if interrupted by signal
+        return count;
+    }
+    for( int i = 0; i < r; ++i )
+    {
+        file_descriptor fd = events[i].data.fd;
+        unsigned int e = events[i].events;
+        if( ( e & ( EPOLLIN | EPOLLHUP | EPOLLERR ) ) && read_descriptors_.descriptors_.count( fd ) ) { read_descriptors_.set_ready_( fd ); ++count; }
+        if( ( e & ( EPOLLOUT | EPOLLHUP | EPOLLERR ) ) && write_descriptors_.descriptors_.count( fd ) ) { write_descriptors_.set_ready_( fd ); ++count; }
+        if( ( e & EPOLLPRI ) && except_descriptors_.descriptors_.count( fd ) ) { except_descriptors_.set_ready_( fd ); ++count; }
+    }
+    return count;
+}
+
+std::size_t select::wait() { return wait_( -1 ); }
+
+static int milliseconds( boost::int64_t microseconds ) { return microseconds <= 0 ? 0 : int( std::min( ( microseconds + 999 ) / 1000, boost::int64_t( 0x7fffffff ) ) ); } // round up to avoid spinning on short timeouts
+
+std::size_t select::wait( unsigned int timeout_seconds, unsigned int timeout_nanoseconds ) { return wait_( milliseconds( boost::int64_t( timeout_seconds ) * 1000000 + timeout_nanoseconds / 1000 ) ); }
+
+std::size_t select::wait( boost::posix_time::time_duration timeout ) { return wait_( milliseconds( timeout.total_microseconds() ) ); }
+
+std::size_t select::check() { return wait_( 0 ); }
+
+#else // #ifdef __linux__
+
+select::select() {}
+
+select::select( const select& rhs ) : read_descriptors_( rhs.read_descriptors_ ), write_descriptors_( rhs.write_descriptors_ ), except_descriptors_( rhs.except_descriptors_ ) {}
+
+select& select::operator=( const select& rhs ) { read_descriptors_ = rhs.read_descriptors_; write_descriptors_ = rhs.write_descriptors_; except_descriptors_ = rhs.except_descriptors_; return *this; }
+
+select::~select() {}
+
 static std::size_t select_impl_( int nfds, fd_set* fdr, fd_set* fdw, fd_set* fde, struct timeval* t )
 {
     if( fdr == NULL && fdw == NULL && fde == NULL ) { return 0; } // good semantics?
@@ -123,4 +270,6 @@ fd_set* select::descriptors::reset_fds_()
     return &fd_set_;
 }
 
+#endif // #ifdef __linux__
+
 } } // namespace comma { namespace io {
@@ -41,6 +41,7 @@
 
 #include <cassert>
 #include <set>
+#include <vector>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/unordered_set.hpp>
 #include "../base/exception.h"
@@ -53,6 +54,13 @@ namespace comma { namespace io {
 /// only on sockets, not on files (because select() in Winsock
 /// works only for sockets.
 ///
+/// in linux, it is implemented with epoll (level-triggered, i.e. with the same
+/// semantics as select()): there is no FD_SETSIZE limit on descriptors; descriptors
+/// are registered with the kernel only when added or removed, thus wait() costs
+/// in the number of ready descriptors rather than in the number of all descriptors;
+/// regular files, which epoll does not support, are always ready, as with select();
+/// a descriptor closed and reopened with the same number is picked up on its next add()
+///
 /// @todo implement POSIX select() behaviour for Windows
 ///
 /// @todo clean up: add WSAStartup for Windows (move WSAStartup to a proper
@@ -64,13 +72,24 @@ namespace comma { namespace io {
 class select
 {
     public:
+        select();
+
+        select( const select& rhs );
+
+        select& operator=( const select& rhs );
+
+        ~select();
+
         /// blocking wait, if OK, returns what select() returned, otherwise throws
         std::size_t wait();
 
         /// wait with timeout, if OK, returns what select() returned, otherwise throws
+        /// @note in linux, timeout resolution is 1 millisecond: non-zero timeouts are rounded
+        ///       up to whole milliseconds, e.g. 100 microseconds wait for 1 millisecond
         std::size_t wait( unsigned int timeout_seconds, unsigned int timeout_nanoseconds = 0 );
 
         /// wait with timeout, if OK, returns what select() returned, otherwise throws
+        /// @note in linux, timeout is rounded up to whole milliseconds, see above
         std::size_t wait( boost::posix_time::time_duration timeout );
 
         /// same as wait( 0 )
@@ -103,9 +122,18 @@ class select
 
             private:
                 friend class select;
-                ::fd_set* reset_fds_();
                 std::set< file_descriptor > descriptors_; //boost::unordered_set< file_descriptor > descriptors_;
+                #ifdef __linux__
+                std::vector< char > ready_; // indexed by descriptor
+                std::vector< file_descriptor > ready_list_; // descriptors ready after the last wait
+                std::vector< file_descriptor > changed_; // descriptors added or removed since the last wait
+                std::vector< file_descriptor > removed_; // descriptors removed since the last wait
+                void set_ready_( file_descriptor fd );
+                void reset_ready_();
+                #else
+                ::fd_set* reset_fds_();
                 ::fd_set fd_set_;
+                #endif
         };
 
         /// return read descriptors
@@ -124,12 +152,43 @@ class select
         descriptors read_descriptors_;
         descriptors write_descriptors_;
         descriptors except_descriptors_;
+        #ifdef __linux__
+        int epoll_fd_;
+        std::vector< unsigned int > registered_; // epoll events registered for descriptor, indexed by descriptor
+        std::set< file_descriptor > unpollable_; // e.g. regular files: always ready
+        std::vector< char > events_; // quick and dirty: buffer for epoll_event array, since sys/epoll.h is not included in header
+        void sync_();
+        std::size_t wait_( int timeout_milliseconds );
+        #endif
 };
 
+#ifdef __linux__
+
+inline void select::descriptors::add( file_descriptor fd ) // always recorded, since descriptor may have been closed and reopened with the same number
+{
+    if( fd == invalid_file_descriptor ) { return; }
+    descriptors_.insert( fd );
+    changed_.push_back( fd );
+}
+
+inline void select::descriptors::remove( file_descriptor fd )
+{
+    if( fd == invalid_file_descriptor || descriptors_.erase( fd ) == 0 ) { return; }
+    changed_.push_back( fd );
+    removed_.push_back( fd );
+    if( std::size_t( fd ) < ready_.size() ) { ready_[fd] = 0; }
+}
+
+inline bool select::descriptors::ready( file_descriptor fd ) const { return fd >= 0 && std::size_t( fd ) < ready_.size() && ready_[fd]; }
+
+#else
+
 inline void select::descriptors::add( file_descriptor fd ) { if( fd != invalid_file_descriptor ) { descriptors_.insert( fd ); } }
 
 inline void select::descriptors::remove( file_descriptor fd ) { if( fd != invalid_file_descriptor ) { descriptors_.erase( fd ); } }
 
 inline bool select::descriptors::ready( file_descriptor fd ) const { return descriptors_.find( fd ) != descriptors_.end() && FD_ISSET( fd, const_cast< fd_set* >( &fd_set_ ) ) != 0; }
 
+#endif // #ifdef __linux__
+
 } } // namespace comma { namespace io {
@@ -44,6 +44,8 @@ template < typename Stream > void server< Stream >::close() { pimpl_->close(); }
 
 template < typename Stream > void server< Stream >::disconnect_all() { pimpl_->disconnect_all(); }
 
+template < typename Stream > void server< Stream >::disconnect( file_descriptor fd ) { pimpl_->disconnect( fd ); }
+
 template < typename Stream > std::size_t server< Stream >::size() const { return pimpl_->size(); }
 
 template < typename Stream > file_descriptor server< Stream >::acceptor_file_descriptor() const { return pimpl_->_acceptor ? pimpl_->acceptor().fd() : comma::io::invalid_file_descriptor; }
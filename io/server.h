@@ -39,6 +39,9 @@ class server
         /// disconnect all existing clients
         void disconnect_all();
 
+        /// disconnect client with given file descriptor, if any
+        void disconnect( file_descriptor fd );
+
         /// return current number of connected clients
         std::size_t size() const;
 
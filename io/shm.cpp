@@ -0,0 +1,328 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include "../base/exception.h"
+#include "../base/last_error.h"
+#include "shm.h"
+
+namespace comma { namespace io { namespace shm {
+
+static const std::uint32_t magic = 0x636d6d61; // "cmma"
+static const std::uint32_t version = 3;
+static const std::size_t data_offset = 4096; // header page
+
+struct ring::header
+{
+    std::atomic< std::uint32_t > magic; // set last, when the ring is ready
+    std::uint32_t version;
+    std::uint64_t size;
+    alignas( 64 ) std::atomic< std::uint64_t > head; // published write position, bytes since the start
+    alignas( 64 ) std::atomic< std::uint32_t > sequence; // futex word, incremented on each commit
+    std::atomic< std::uint32_t > waiters[2]; // number of consumers blocked on the futex by generation
+    std::atomic< std::uint32_t > generation; // switched by producer, see ring::wake_()
+    std::atomic< std::uint32_t > closed; // producer has gone
+    std::int32_t pid; // producer process id
+    std::uint64_t pid_namespace; // producer pid namespace inode, since pid is meaningless in another namespace
+};
+
+static_assert( sizeof( ring::header ) <= data_offset, "shm ring header does not fit the header page" );
+
+static std::string path_( const std::string& name )
+{
+    if( name.empty() || name.find( '/' ) != std::string::npos ) { COMMA_THROW( comma::exception, "shm: expected ring name without slashes, got: '" << name << "'" ); }
+    return "/" + name;
+}
+
+static std::uint64_t pid_namespace_()
+{
+    struct stat st;
+    return ::stat( "/proc/self/ns/pid", &st ) == 0 ? st.st_ino : 0;
+}
+
+static int futex_( std::atomic< std::uint32_t >* word, int op, std::uint32_t value, const timespec* timeout = nullptr )
+{
+    return ::syscall( SYS_futex, reinterpret_cast< std::uint32_t* >( word ), op, value, timeout, nullptr, 0 ); // not FUTEX_PRIVATE_FLAG: shared between processes
+}
+
+ring::ring( const std::string& name, bool producer )
+    : name_( name )
+    , producer_( producer )
+    , fd_( io::invalid_file_descriptor )
+    , header_( nullptr )
+    , data_( nullptr )
+    , size_( 0 )
+    , mapped_( 0 )
+    , cursor_( 0 )
+    , lost_( 0 )
+    , event_fd_( io::invalid_file_descriptor )
+    , consumed_( 0 )
+    , dead_( false )
+    , stop_( false )
+    , armed_( false )
+    , switched_( std::chrono::steady_clock::now() )
+{
+}
+
+ring* ring::create( const std::string& name, std::size_t size, unsigned int mode )
+{
+    const std::string& path = path_( name );
+    std::size_t s = 65536;
+    while( s < size ) { s <<= 1; }
+    std::unique_ptr< ring > r( new ring( name, true ) );
+    ::shm_unlink( &path[0] ); // existing consumers keep the old mapping
+    r->fd_ = ::shm_open( &path[0], O_CREAT | O_EXCL | O_RDWR, mode );
+    if( r->fd_ < 0 ) { COMMA_THROW( comma::exception, "shm: failed to create '" << name << "': " << last_error::to_string() ); }
+    r->mapped_ = data_offset + s;
+    if( ::ftruncate( r->fd_, r->mapped_ ) != 0 ) { COMMA_THROW( comma::exception, "shm: failed to resize '" << name << "' to " << r->mapped_ << " bytes: " << last_error::to_string() ); }
+    void* p = ::mmap( nullptr, r->mapped_, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd_, 0 );
+    if( p == MAP_FAILED ) { r->mapped_ = 0; COMMA_THROW( comma::exception, "shm: failed to map '" << name << "': " << last_error::to_string() ); }
+    r->header_ = new ( p ) header; // memory is zeroed by ftruncate
+    r->header_->version = version;
+    r->header_->size = s;
+    r->header_->pid = ::getpid();
+    r->header_->pid_namespace = pid_namespace_();
+    r->data_ = static_cast< char* >( p ) + data_offset;
+    r->size_ = s;
+    r->header_->magic.store( magic, std::memory_order_release );
+    return r.release();
+}
+
+ring* ring::open( const std::string& name )
+{
+    const std::string& path = path_( name );
+    std::unique_ptr< ring > r( new ring( name, false ) );
+    r->fd_ = ::shm_open( &path[0], O_RDWR, 0 ); // read-write, since consumers register as futex waiters
+    if( r->fd_ < 0 ) { COMMA_THROW( comma::exception, "shm: failed to open '" << name << "': " << last_error::to_string() ); }
+    struct stat st;
+    if( ::fstat( r->fd_, &st ) != 0 || std::size_t( st.st_size ) <= data_offset ) { COMMA_THROW( comma::exception, "shm: '" << name << "' is not a ring or not ready yet" ); }
+    r->mapped_ = st.st_size;
+    void* p = ::mmap( nullptr, r->mapped_, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd_, 0 );
+    if( p == MAP_FAILED ) { r->mapped_ = 0; COMMA_THROW( comma::exception, "shm: failed to map '" << name << "': " << last_error::to_string() ); }
+    r->header_ = static_cast< header* >( p );
+    if( r->header_->magic.load( std::memory_order_acquire ) != magic ) { COMMA_THROW( comma::exception, "shm: '" << name << "' is not a ring or not ready yet" ); }
+    if( r->header_->version != version ) { COMMA_THROW( comma::exception, "shm: '" << name << "': expected version " << version << ", got " << r->header_->version ); }
+    if( data_offset + r->header_->size != r->mapped_ ) { COMMA_THROW( comma::exception, "shm: '" << name << "': expected size " << ( r->mapped_ - data_offset ) << ", got " << r->header_->size ); }
+    r->data_ = static_cast< char* >( p ) + data_offset;
+    r->size_ = r->header_->size;
+    r->cursor_ = r->header_->head.load( std::memory_order_acquire );
+    r->consumed_ = r->cursor_;
+    r->event_fd_ = ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    if( r->event_fd_ < 0 ) { COMMA_THROW( comma::exception, "shm: '" << name << "': failed to create eventfd: " << last_error::to_string() ); }
+    r->notifier_ = std::thread( &ring::notify_, r.get() );
+    return r.release();
+}
+
+ring::~ring()
+{
+    if( notifier_.joinable() )
+    {
+        stop_ = true;
+        { std::lock_guard< std::mutex > lock( mutex_ ); }
+        disarmed_.notify_all();
+        header_->sequence.fetch_add( 1 ); // harmless for other consumers: they re-check and wait again
+        futex_( &header_->sequence, FUTEX_WAKE, INT32_MAX );
+        notifier_.join();
+    }
+    if( event_fd_ >= 0 ) { ::close( event_fd_ ); }
+    if( header_ && producer_ )
+    {
+        header_->closed.store( 1 );
+        header_->sequence.fetch_add( 1 );
+        wake_();
+    }
+    if( producer_ && fd_ >= 0 ) { ::shm_unlink( &path_( name_ )[0] ); }
+    if( mapped_ > 0 ) { ::munmap( header_, mapped_ ); }
+    if( fd_ >= 0 ) { ::close( fd_ ); }
+}
+
+char* ring::reserve( std::size_t& size )
+{
+    std::size_t offset = cursor_ & ( size_ - 1 );
+    size = std::min( size_ - offset, max_chunk() );
+    return data_ + offset;
+}
+
+void ring::commit( std::size_t size )
+{
+    if( size == 0 ) { return; }
+    cursor_ += size;
+    header_->head.store( cursor_, std::memory_order_release );
+    header_->sequence.fetch_add( 1 ); // seq_cst: pairs with waiters increment in wait_()
+    wake_();
+}
+
+void ring::wake_()
+{
+    if( header_->waiters[0].load() == 0 && header_->waiters[1].load() == 0 ) { return; }
+    futex_( &header_->sequence, FUTEX_WAKE, INT32_MAX );
+    auto now = std::chrono::steady_clock::now();
+    if( now - switched_ < std::chrono::seconds( 2 ) ) { return; }
+    switched_ = now;
+    std::uint32_t generation = header_->generation.load() + 1;
+    header_->waiters[ generation & 1 ].store( 0 ); // consumers of generation before last are done waiting, unless crashed
+    header_->generation.store( generation );
+}
+
+std::uint64_t ring::available() const
+{
+    std::uint64_t head = header_->head.load( std::memory_order_acquire );
+    return head > cursor_ ? head - cursor_ : 0;
+}
+
+bool ring::closed() const { return header_->closed.load() || dead_.load(); }
+
+void ring::check_producer_()
+{
+    if( header_->pid <= 0 || header_->pid_namespace != pid_namespace_() ) { return; }
+    if( ::kill( header_->pid, 0 ) != 0 && errno == ESRCH ) { dead_ = true; }
+}
+
+bool ring::wait_( std::uint64_t cursor )
+{
+    auto& waiters = header_->waiters[ header_->generation.load() & 1 ];
+    waiters.fetch_add( 1 );
+    std::uint32_t sequence = header_->sequence.load();
+    bool ok = header_->head.load() == cursor && !closed() && !stop_;
+    if( ok )
+    {
+        timespec timeout{ 1, 0 }; // wake up once in a while to check whether producer is still there
+        if( futex_( &header_->sequence, FUTEX_WAIT, sequence, &timeout ) != 0 && errno == ETIMEDOUT ) { check_producer_(); }
+    }
+    waiters.fetch_sub( 1 );
+    return ok;
+}
+
+bool ring::arm_()
+{
+    if( armed_ ) { return true; }
+    if( header_->head.load( std::memory_order_acquire ) == consumed_.load() && !closed() ) { return false; }
+    std::uint64_t one = 1;
+    if( ::write( event_fd_, &one, sizeof( one ) ) != sizeof( one ) ) { return false; } // quick and dirty
+    armed_ = true;
+    return true;
+}
+
+void ring::disarm_()
+{
+    std::lock_guard< std::mutex > lock( mutex_ );
+    if( !armed_ || header_->head.load( std::memory_order_acquire ) != cursor_ || closed() ) { return; }
+    std::uint64_t value;
+    if( ::read( event_fd_, &value, sizeof( value ) ) != sizeof( value ) ) { return; }
+    armed_ = false;
+    disarmed_.notify_all();
+}
+
+void ring::notify_() // while consumer has unread data, wait for it to catch up; otherwise, wait for producer
+{
+    while( !stop_ )
+    {
+        {
+            std::unique_lock< std::mutex > lock( mutex_ );
+            if( arm_() ) { disarmed_.wait_for( lock, std::chrono::seconds( 1 ), [&]() { return !armed_ || stop_; } ); continue; }
+        }
+        wait_( consumed_.load() );
+    }
+}
+
+std::size_t ring::read( char* buf, std::size_t size )
+{
+    if( size == 0 ) { return 0; }
+    while( true )
+    {
+        bool gone = closed();
+        std::uint64_t head = header_->head.load( std::memory_order_acquire );
+        if( cursor_ + size_ < head + max_chunk() ) { lost_ += head - cursor_; cursor_ = head; } // overrun: skip to the latest data
+        if( head == cursor_ )
+        {
+            if( gone ) { return 0; }
+            wait_( cursor_ );
+            continue;
+        }
+        std::size_t n = std::min( std::uint64_t( size ), head - cursor_ );
+        std::size_t offset = cursor_ & ( size_ - 1 );
+        std::size_t first = std::min( n, size_ - offset );
+        std::memcpy( buf, data_ + offset, first );
+        if( first < n ) { std::memcpy( buf + first, data_, n - first ); }
+        std::atomic_thread_fence( std::memory_order_acquire );
+        head = header_->head.load( std::memory_order_relaxed );
+        if( cursor_ + size_ < head + max_chunk() ) { lost_ += head - cursor_; cursor_ = head; continue; } // overwritten while copying
+        cursor_ += n;
+        consumed_ = cursor_;
+        if( event_fd_ >= 0 ) { disarm_(); }
+        return n;
+    }
+}
+
+void ostreambuf::reserve_()
+{
+    std::size_t size;
+    char* p = ring_->reserve( size );
+    setp( p, p + size );
+}
+
+ostreambuf::int_type ostreambuf::overflow( int_type c )
+{
+    sync();
+    if( traits_type::eq_int_type( c, traits_type::eof() ) ) { return traits_type::not_eof( c ); }
+    *pptr() = traits_type::to_char_type( c );
+    pbump( 1 );
+    return c;
+}
+
+int ostreambuf::sync()
+{
+    ring_->commit( pptr() - pbase() );
+    reserve_();
+    return 0;
+}
+
+istreambuf::int_type istreambuf::underflow()
+{
+    if( gptr() < egptr() ) { return traits_type::to_int_type( *gptr() ); }
+    std::size_t n = ring_->read( &buffer_[0], buffer_.size() );
+    if( n == 0 ) { return traits_type::eof(); }
+    setg( &buffer_[0], &buffer_[0], &buffer_[0] + n );
+    return traits_type::to_int_type( *gptr() );
+}
+
+std::streamsize istreambuf::showmanyc()
+{
+    return ring_->available();
+}
+
+std::streamsize istreambuf::xsgetn( char* s, std::streamsize n )
+{
+    std::streamsize count = std::min( n, std::streamsize( egptr() - gptr() ) );
+    std::memcpy( s, gptr(), count );
+    gbump( count );
+    while( n - count >= std::streamsize( buffer_.size() ) )
+    {
+        std::size_t r = ring_->read( s + count, n - count );
+        if( r == 0 ) { return count; }
+        count += r;
+    }
+    return count < n ? count + std::streambuf::xsgetn( s + count, n - count ) : count;
+}
+
+istream::istream( const std::string& name ) : std::istream( nullptr ), ring_( ring::open( name ) ), buf_( ring_.get() ) { init( &buf_ ); }
+
+ostream::ostream( const std::string& name, std::size_t size ) : std::ostream( nullptr ), ring_( ring::create( name, size ) ), buf_( ring_.get() ) { init( &buf_ ); }
+
+} } } // namespace comma { namespace io { namespace shm {
+
+#endif // #ifdef __linux__
@@ -0,0 +1,184 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#pragma once
+
+#ifdef __linux__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "file_descriptor.h"
+
+namespace comma { namespace io { namespace shm {
+
+/// single-producer multi-consumer byte ring in posix shared memory (linux only)
+///
+/// the producer never waits for consumers: it writes at its cursor and publishes
+/// written data by advancing the cursor; each consumer keeps its own read cursor,
+/// thus consumers do not affect the producer or each other
+///
+/// a consumer lagging by more than the ring size is overrun: it skips to the latest
+/// data and counts skipped bytes; the latest data starts at a packet boundary, if the
+/// producer flushes after each packet (as e.g. io-publish does by default)
+///
+/// consumers block on a futex in shared memory; the producer wakes them only if
+/// there are waiting consumers, i.e. no system calls on the producer side otherwise
+///
+/// consumers wait for a second at most and register as waiters in one of two slots
+/// by generation; the producer switches generation every two seconds and resets the
+/// slot it switches to, thus if a consumer crashes while waiting, the producer wakes
+/// no-one on each commit for a few seconds at most rather than forever
+///
+/// consumer fd() is an eventfd, readable while there is unread data or the producer
+/// has gone, thus consumers can be used in select() along with sockets and pipes;
+/// a helper thread per consumer waits on the futex on its behalf, only while the
+/// consumer is caught up with the producer
+///
+/// the producer has gone, if it closed the ring or its process does not exist
+/// any more (checked once a second while waiting), e.g. if it crashed; the process
+/// is checked only if the consumer is in the same pid namespace as the producer
+class ring : public boost::noncopyable
+{
+    public:
+        struct header;
+
+        /// producer: create ring, replacing existing ring of the same name, if any
+        /// @param name ring name without leading slash, e.g. "my-sensor"
+        /// @param size data size in bytes, rounded up to power of two
+        /// @param mode permissions of shared memory segment as in shm_open(), subject to umask;
+        ///             consumers need read-write access, e.g. use 0660 to share ring with group
+        static ring* create( const std::string& name, std::size_t size, unsigned int mode = 0600 );
+
+        /// consumer: attach to existing ring; read from the latest data on
+        static ring* open( const std::string& name );
+
+        ~ring();
+
+        /// producer: contiguous space to write into, no more than max_chunk() bytes
+        char* reserve( std::size_t& size );
+
+        /// producer: publish size bytes written into reserved space, wake waiting consumers
+        void commit( std::size_t size );
+
+        /// consumer: copy up to size bytes of published data to buf; block, if no data
+        /// @return number of bytes read; 0 on end of stream, i.e. producer closed
+        std::size_t read( char* buf, std::size_t size );
+
+        /// consumer: number of published bytes not read yet
+        std::uint64_t available() const;
+
+        /// consumer: number of bytes skipped due to overruns
+        std::uint64_t lost() const { return lost_; }
+
+        /// consumer: true, if producer closed the ring or its process is gone
+        bool closed() const;
+
+        /// ring data size in bytes
+        std::size_t size() const { return size_; }
+
+        /// producer writes in chunks of at most this size; consumers must stay this far from being overrun
+        std::size_t max_chunk() const { return size_ / 8; }
+
+        /// consumer: eventfd to use in select, ready while there is unread data or producer has gone
+        /// producer: shared memory file descriptor
+        io::file_descriptor fd() const { return producer_ ? fd_ : event_fd_; }
+
+        const std::string& name() const { return name_; }
+
+    private:
+        ring( const std::string& name, bool producer );
+        std::string name_;
+        bool producer_;
+        io::file_descriptor fd_;
+        header* header_;
+        char* data_;
+        std::size_t size_;
+        std::size_t mapped_;
+        std::uint64_t cursor_; // producer: not yet published write position; consumer: read position
+        std::uint64_t lost_;
+        io::file_descriptor event_fd_; // consumer only
+        std::atomic< std::uint64_t > consumed_; // consumer read position, as seen by the notifier
+        std::atomic< bool > dead_; // producer process gone without closing the ring
+        std::atomic< bool > stop_;
+        bool armed_; // event_fd_ is readable
+        std::mutex mutex_;
+        std::condition_variable disarmed_;
+        std::thread notifier_;
+        std::chrono::steady_clock::time_point switched_; // producer only: last generation switch
+        bool wait_( std::uint64_t cursor );
+        void check_producer_();
+        void notify_();
+        bool arm_();
+        void disarm_();
+        void wake_();
+};
+
+/// output stream buffer writing straight into the ring
+class ostreambuf : public std::streambuf, public boost::noncopyable
+{
+    public:
+        ostreambuf( ring* r ): ring_( r ) {}
+        ~ostreambuf() { sync(); }
+
+    protected:
+        int_type overflow( int_type c );
+        int sync();
+
+    private:
+        ring* ring_;
+        void reserve_();
+};
+
+/// input stream buffer reading from the ring
+class istreambuf : public std::streambuf, public boost::noncopyable
+{
+    public:
+        istreambuf( ring* r, std::size_t buffer_size = 65536 ): ring_( r ), buffer_( buffer_size ) {}
+
+    protected:
+        int_type underflow();
+        std::streamsize showmanyc();
+        std::streamsize xsgetn( char* s, std::streamsize n ); // large reads go straight from the ring to s
+
+    private:
+        ring* ring_;
+        std::vector< char > buffer_;
+};
+
+/// input stream on shm::ring consumer; owns the ring
+class istream : public std::istream
+{
+    public:
+        istream( const std::string& name );
+        const shm::ring& ring() const { return *ring_; }
+
+    private:
+        std::unique_ptr< shm::ring > ring_;
+        istreambuf buf_;
+};
+
+/// output stream on shm::ring producer; owns the ring; the ring is removed on destruction
+class ostream : public std::ostream
+{
+    public:
+        ostream( const std::string& name, std::size_t size );
+        ~ostream() { buf_.pubsync(); }
+        const shm::ring& ring() const { return *ring_; }
+
+    private:
+        std::unique_ptr< shm::ring > ring_;
+        ostreambuf buf_;
+};
+
+} } } // namespace comma { namespace io { namespace shm {
+
+#endif // #ifdef __linux__
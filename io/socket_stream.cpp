@@ -0,0 +1,238 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#ifndef WIN32
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <sstream>
+#include "../base/exception.h"
+#include "../base/last_error.h"
+#include "../name_value/map.h"
+#include "socket_stream.h"
+
+namespace comma { namespace io {
+
+socket_options::socket_options() : nodelay( false ), sndbuf( 0 ), rcvbuf( 0 ), busy_poll( 0 ), timeout( 0 ), buffer_size( 65536 ) {}
+
+socket_options socket_options::from_string( const std::string& options )
+{
+    socket_options o;
+    if( options.empty() ) { return o; }
+    comma::name_value::map m( options, ';', '=' );
+    static const std::set< std::string > keys = { "buffer", "busy-poll", "nodelay", "rcvbuf", "sndbuf", "timeout" };
+    for( const auto& v: m.get() ) { if( keys.find( v.first ) == keys.end() ) { COMMA_THROW( comma::exception, "socket options: expected one of: buffer, busy-poll, nodelay, rcvbuf, sndbuf, timeout; got '" << v.first << "' in '" << options << "'" ); } }
+    o.nodelay = m.exists( "nodelay" );
+    o.sndbuf = m.value< unsigned int >( "sndbuf", 0 );
+    o.rcvbuf = m.value< unsigned int >( "rcvbuf", 0 );
+    o.busy_poll = m.value< unsigned int >( "busy-poll", 0 );
+    o.timeout = m.value< double >( "timeout", 0 );
+    o.buffer_size = m.value< std::size_t >( "buffer", o.buffer_size );
+    if( o.buffer_size == 0 ) { COMMA_THROW( comma::exception, "socket options: expected positive buffer size, got 0 in '" << options << "'" ); }
+    if( o.timeout < 0 ) { COMMA_THROW( comma::exception, "socket options: expected non-negative timeout, got " << o.timeout << " in '" << options << "'" ); }
+    return o;
+}
+
+std::string socket_options::usage( unsigned int indent )
+{
+    std::string i( indent, ' ' );
+    std::ostringstream oss;
+    oss << i << "socket options, e.g. tcp:localhost:12345;nodelay;rcvbuf=4194304;timeout=2.5" << std::endl;
+    oss << i << "    buffer=<bytes>       : stream buffer size in each direction; default: 65536" << std::endl;
+    oss << i << "    busy-poll=<us>       : busy poll socket on receive for given microseconds (linux only)" << std::endl;
+    oss << i << "    nodelay              : tcp only: send small packets immediately (TCP_NODELAY)" << std::endl;
+    oss << i << "    rcvbuf=<bytes>       : socket receive buffer size (SO_RCVBUF); default: system default" << std::endl;
+    oss << i << "    sndbuf=<bytes>       : socket send buffer size (SO_SNDBUF); default: system default" << std::endl;
+    oss << i << "    timeout=<seconds>    : connect timeout; default: no timeout" << std::endl;
+    return oss.str();
+}
+
+static void set_option_( io::file_descriptor fd, int level, int name, int value, const char* what )
+{
+    if( ::setsockopt( fd, level, name, &value, sizeof( value ) ) == 0 ) { return; }
+    std::string error = last_error::to_string();
+    ::close( fd );
+    COMMA_THROW( comma::exception, "failed to set socket option " << what << " to " << value << ": " << error );
+}
+
+static io::file_descriptor connect_( int domain, const sockaddr* address, socklen_t size, const socket_options& options, std::string& error )
+{
+    io::file_descriptor fd = ::socket( domain, SOCK_STREAM, 0 );
+    if( fd < 0 ) { error = last_error::to_string(); return io::invalid_file_descriptor; }
+    ::fcntl( fd, F_SETFD, FD_CLOEXEC );
+    // set before connect, since receive buffer size affects tcp window scale negotiated on connect
+    if( options.nodelay && domain != AF_UNIX ) { set_option_( fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY" ); }
+    if( options.sndbuf > 0 ) { set_option_( fd, SOL_SOCKET, SO_SNDBUF, options.sndbuf, "SO_SNDBUF" ); }
+    if( options.rcvbuf > 0 ) { set_option_( fd, SOL_SOCKET, SO_RCVBUF, options.rcvbuf, "SO_RCVBUF" ); }
+    #ifdef SO_BUSY_POLL
+    if( options.busy_poll > 0 ) { set_option_( fd, SOL_SOCKET, SO_BUSY_POLL, options.busy_poll, "SO_BUSY_POLL" ); }
+    #else
+    if( options.busy_poll > 0 ) { ::close( fd ); COMMA_THROW( comma::exception, "busy-poll: not supported on this platform" ); }
+    #endif
+    #ifdef SO_NOSIGPIPE
+    set_option_( fd, SOL_SOCKET, SO_NOSIGPIPE, 1, "SO_NOSIGPIPE" );
+    #endif
+    int flags = ::fcntl( fd, F_GETFL, 0 );
+    ::fcntl( fd, F_SETFL, flags | O_NONBLOCK ); // non-blocking connect to be able to time out
+    int r = ::connect( fd, address, size );
+    if( r != 0 && errno == EINPROGRESS )
+    {
+        pollfd p;
+        p.fd = fd;
+        p.events = POLLOUT;
+        int n;
+        int timeout = options.timeout > 0 ? std::max( int( std::ceil( options.timeout * 1000 ) ), 1 ) : -1; // round up to whole milliseconds, since poll( ..., 0 ) would not wait at all
+        while( ( n = ::poll( &p, 1, timeout ) ) < 0 && errno == EINTR ); // quick and dirty: on signal, restart with full timeout
+        if( n == 0 ) { error = "connect timed out after " + std::to_string( options.timeout ) + " seconds"; ::close( fd ); return io::invalid_file_descriptor; }
+        int e = 0;
+        socklen_t length = sizeof( e );
+        if( n < 0 || ::getsockopt( fd, SOL_SOCKET, SO_ERROR, &e, &length ) != 0 ) { e = errno; }
+        if( e != 0 ) { error = std::strerror( e ); ::close( fd ); return io::invalid_file_descriptor; }
+        r = 0;
+    }
+    if( r != 0 ) { error = last_error::to_string(); ::close( fd ); return io::invalid_file_descriptor; }
+    ::fcntl( fd, F_SETFL, flags ); // blocking from now on, as with any other stream
+    return fd;
+}
+
+io::file_descriptor socket_streambuf::connect_tcp( const std::string& address, const std::string& port, const socket_options& options )
+{
+    addrinfo hints;
+    std::memset( &hints, 0, sizeof( hints ) );
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    int r = ::getaddrinfo( address.c_str(), port.c_str(), &hints, &addresses );
+    if( r != 0 ) { COMMA_THROW( comma::exception, "failed to resolve tcp:" << address << ":" << port << ": " << ::gai_strerror( r ) ); }
+    std::unique_ptr< addrinfo, decltype( &::freeaddrinfo ) > guard( addresses, &::freeaddrinfo ); // connect_() may throw on setting socket options
+    std::string error = "no addresses";
+    io::file_descriptor fd = io::invalid_file_descriptor;
+    for( addrinfo* a = addresses; a && fd == io::invalid_file_descriptor; a = a->ai_next ) { fd = connect_( a->ai_family, a->ai_addr, a->ai_addrlen, options, error ); }
+    if( fd == io::invalid_file_descriptor ) { COMMA_THROW( comma::exception, "failed to connect to tcp:" << address << ":" << port << ": " << error ); }
+    return fd;
+}
+
+io::file_descriptor socket_streambuf::connect_local( const std::string& path, const socket_options& options )
+{
+    sockaddr_un a;
+    std::memset( &a, 0, sizeof( a ) );
+    a.sun_family = AF_UNIX;
+    if( path.empty() || path.size() >= sizeof( a.sun_path ) ) { COMMA_THROW( comma::exception, "expected local socket path of 1 to " << ( sizeof( a.sun_path ) - 1 ) << " characters, got: '" << path << "'" ); }
+    std::memcpy( a.sun_path, &path[0], path.size() );
+    std::string error;
+    io::file_descriptor fd = connect_( AF_UNIX, reinterpret_cast< const sockaddr* >( &a ), sizeof( a ), options, error );
+    if( fd == io::invalid_file_descriptor ) { COMMA_THROW( comma::exception, "failed to connect to local:" << path << ": " << error ); }
+    return fd;
+}
+
+socket_streambuf::socket_streambuf( io::file_descriptor fd, std::size_t buffer_size ) : fd_( fd ), in_( buffer_size ), out_( buffer_size )
+{
+    setg( &in_[0], &in_[0], &in_[0] );
+    setp( &out_[0], &out_[0] + out_.size() );
+}
+
+socket_streambuf::~socket_streambuf() { close(); }
+
+void socket_streambuf::close()
+{
+    if( fd_ == io::invalid_file_descriptor ) { return; }
+    flush_();
+    ::close( fd_ );
+    fd_ = io::invalid_file_descriptor;
+}
+
+bool socket_streambuf::write_( const char* s, std::size_t n )
+{
+    #ifdef MSG_NOSIGNAL
+    static const int flags = MSG_NOSIGNAL; // a closed peer is reported as failed write rather than by SIGPIPE
+    #else
+    static const int flags = 0;
+    #endif
+    while( n > 0 )
+    {
+        ssize_t r = ::send( fd_, s, n, flags );
+        if( r < 0 ) { if( errno == EINTR ) { continue; } return false; }
+        s += r;
+        n -= r;
+    }
+    return true;
+}
+
+bool socket_streambuf::flush_()
+{
+    if( fd_ == io::invalid_file_descriptor ) { return false; }
+    bool ok = write_( pbase(), pptr() - pbase() );
+    setp( &out_[0], &out_[0] + out_.size() );
+    return ok;
+}
+
+socket_streambuf::int_type socket_streambuf::underflow()
+{
+    if( gptr() < egptr() ) { return traits_type::to_int_type( *gptr() ); }
+    if( fd_ == io::invalid_file_descriptor ) { return traits_type::eof(); }
+    ssize_t n;
+    while( ( n = ::recv( fd_, &in_[0], in_.size(), 0 ) ) < 0 && errno == EINTR );
+    if( n <= 0 ) { return traits_type::eof(); }
+    setg( &in_[0], &in_[0], &in_[0] + n );
+    return traits_type::to_int_type( *gptr() );
+}
+
+socket_streambuf::int_type socket_streambuf::overflow( int_type c )
+{
+    if( !flush_() ) { return traits_type::eof(); }
+    if( traits_type::eq_int_type( c, traits_type::eof() ) ) { return traits_type::not_eof( c ); }
+    *pptr() = traits_type::to_char_type( c );
+    pbump( 1 );
+    return c;
+}
+
+int socket_streambuf::sync() { return flush_() ? 0 : -1; }
+
+std::streamsize socket_streambuf::showmanyc()
+{
+    int count = 0;
+    return fd_ != io::invalid_file_descriptor && ::ioctl( fd_, FIONREAD, &count ) == 0 ? std::max( count, 0 ) : 0;
+}
+
+std::streamsize socket_streambuf::xsgetn( char* s, std::streamsize n )
+{
+    std::streamsize count = std::min( n, std::streamsize( egptr() - gptr() ) );
+    std::memcpy( s, gptr(), count );
+    gbump( count );
+    while( fd_ != io::invalid_file_descriptor && n - count >= std::streamsize( in_.size() ) )
+    {
+        ssize_t r = ::recv( fd_, s + count, n - count, 0 );
+        if( r < 0 && errno == EINTR ) { continue; }
+        if( r <= 0 ) { return count; }
+        count += r;
+    }
+    return count < n ? count + std::streambuf::xsgetn( s + count, n - count ) : count;
+}
+
+std::streamsize socket_streambuf::xsputn( const char* s, std::streamsize n )
+{
+    if( n < std::streamsize( out_.size() ) ) { return std::streambuf::xsputn( s, n ); }
+    return flush_() && write_( s, n ) ? n : 0;
+}
+
+socket_stream::socket_stream( io::file_descriptor fd, std::size_t buffer_size ) : std::iostream( nullptr ), buf_( fd, buffer_size ) { init( &buf_ ); }
+
+socket_stream::~socket_stream() { buf_.close(); }
+
+void socket_stream::close() { buf_.close(); }
+
+} } // namespace comma { namespace io {
+
+#endif // #ifndef WIN32
@@ -0,0 +1,87 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#pragma once
+
+#ifndef WIN32
+
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "file_descriptor.h"
+
+namespace comma { namespace io {
+
+/// client socket parameters, specified after the address in stream name,
+/// e.g. "tcp:localhost:12345;nodelay;rcvbuf=4194304;timeout=2.5"
+struct socket_options
+{
+    bool nodelay; // tcp only: disable nagle algorithm
+    unsigned int sndbuf; // socket send buffer size, bytes; 0: system default
+    unsigned int rcvbuf; // socket receive buffer size, bytes; 0: system default
+    unsigned int busy_poll; // linux only: busy poll on receive, microseconds; 0: off
+    double timeout; // connect timeout, seconds; 0: no timeout
+    std::size_t buffer_size; // stream buffer size in each direction, bytes
+
+    socket_options();
+
+    /// @param options semicolon-separated options, e.g. "nodelay;rcvbuf=4194304"
+    static socket_options from_string( const std::string& options );
+
+    static std::string usage( unsigned int indent = 0 );
+};
+
+/// stream buffer on a connected socket
+/// @note reads return whatever has been received so far, i.e. the buffer size bounds
+///       the amount read per system call rather than forcing to wait for more data
+/// @note reads and writes larger than the buffer bypass it
+class socket_streambuf : public std::streambuf, public boost::noncopyable
+{
+    public:
+        /// @param fd connected socket, owned by the streambuf from now on
+        socket_streambuf( io::file_descriptor fd, std::size_t buffer_size );
+        ~socket_streambuf();
+        io::file_descriptor fd() const { return fd_; }
+        void close();
+
+        /// connect to tcp:<address>:<port> and apply options
+        /// @return connected socket
+        static io::file_descriptor connect_tcp( const std::string& address, const std::string& port, const socket_options& options );
+
+        /// connect to local socket and apply options
+        /// @return connected socket
+        static io::file_descriptor connect_local( const std::string& path, const socket_options& options );
+
+    protected:
+        int_type underflow();
+        int_type overflow( int_type c );
+        int sync();
+        std::streamsize showmanyc();
+        std::streamsize xsgetn( char* s, std::streamsize n );
+        std::streamsize xsputn( const char* s, std::streamsize n );
+
+    private:
+        io::file_descriptor fd_;
+        std::vector< char > in_;
+        std::vector< char > out_;
+        bool flush_();
+        bool write_( const char* s, std::size_t n );
+};
+
+/// bidirectional stream on a connected socket; owns the socket
+class socket_stream : public std::iostream
+{
+    public:
+        socket_stream( io::file_descriptor fd, std::size_t buffer_size );
+        ~socket_stream();
+        io::file_descriptor fd() const { return buf_.fd(); }
+        void close();
+
+    private:
+        socket_streambuf buf_;
+};
+
+} } // namespace comma { namespace io {
+
+#endif // #ifndef WIN32
@@ -28,6 +28,8 @@
 #include "impl/filesystem.h"
 #include "file_descriptor.h"
 #include "select.h"
+#include "shm.h"
+#include "socket_stream.h"
 #include "stream.h"
 
 #ifdef USE_ZEROMQ
@@ -117,6 +119,47 @@ template <> struct traits < std::iostream >
     #endif
 };
 
+#ifdef __linux__
+template < typename S > struct shm_traits;
+
+template <> struct shm_traits < std::istream >
+{
+    static std::istream* make( const std::vector< std::string >& v, io::file_descriptor& fd )
+    {
+        if( v.size() != 2 ) { COMMA_THROW( comma::exception, "expected shm:<name>, got \"" << comma::join( v, ':' ) << "\"" ); }
+        shm::istream* s = new shm::istream( v[1] );
+        fd = s->ring().fd();
+        return s;
+    }
+};
+
+template <> struct shm_traits < std::ostream >
+{
+    static std::ostream* make( const std::vector< std::string >& v, io::file_descriptor& fd )
+    {
+        if( v.size() != 2 && v.size() != 3 ) { COMMA_THROW( comma::exception, "expected shm:<name>[:<size>], got \"" << comma::join( v, ':' ) << "\"" ); }
+        shm::ostream* s = new shm::ostream( v[1], v.size() == 3 ? boost::lexical_cast< std::size_t >( v[2] ) : 64 * 1024 * 1024 );
+        fd = s->ring().fd();
+        return s;
+    }
+};
+
+template <> struct shm_traits < std::iostream >
+{
+    static std::iostream* make( const std::vector< std::string >& v, io::file_descriptor& ) { COMMA_THROW( comma::exception, "shm: bidirectional stream not supported; got \"" << comma::join( v, ':' ) << "\"" ); }
+};
+#endif
+
+#ifndef WIN32
+/// split e.g. "tcp:localhost:12345;nodelay;rcvbuf=4194304" into address fields and options
+static std::vector< std::string > split_socket_name( const std::string& name, std::string& options )
+{
+    std::string::size_type p = name.find( ';' );
+    options = p == std::string::npos ? std::string() : name.substr( p + 1 );
+    return comma::split( name.substr( 0, p ), ':' );
+}
+#endif
+
 template < typename S > void close_file_stream( typename traits< S >::file_stream* s, int fd )
 {
     if( s ) { s->close(); }
@@ -198,6 +241,10 @@ template < typename S > std::size_t stream< S >::available_on_file_descriptor()
 #ifdef WIN32
     COMMA_THROW( comma::exception, "not implemented" );
 #else
+    #ifdef __linux__
+    if( const shm::istream* s = dynamic_cast< const shm::istream* >( stream_ ) ) { return s->ring().available(); } // fd is eventfd, no FIONREAD
+    if( dynamic_cast< const shm::ostream* >( stream_ ) ) { return 0; }
+    #endif
     int error = ::ioctl( fd_, FIONREAD, &count );
     if( error != 0 ) { COMMA_THROW( comma::exception, "ioctl failed with error code: \"" << error << "\"" ); }
 #endif
@@ -217,6 +264,7 @@ template < typename S > stream< S >::stream( const std::string& name, mode::valu
     std::vector< std::string > v = comma::split( name, ':' );
     if( v[0] == "tcp" )
     {
+#ifdef WIN32
         if( v.size() != 3 ) { COMMA_THROW( comma::exception, "expected tcp:<address>:<port>, got \"" << name << "\"" ); }
 #if (BOOST_VERSION >= 106600)
         boost::asio::io_context service;
@@ -229,13 +277,22 @@ template < typename S > stream< S >::stream( const std::string& name, mode::valu
         boost::asio::ip::tcp::iostream* s = new boost::asio::ip::tcp::iostream( it->endpoint() );
         if( !*s ) { delete s; COMMA_THROW( comma::exception, "failed to connect to " << name << ( blocking_ ? " (todo: implement blocking mode)" : "" ) ); }
         close_ = boost::bind( &boost::asio::ip::tcp::iostream::close, s );
-        // todo: make unidirectional
 #if (BOOST_VERSION >= 106600)
         fd_ = s->rdbuf()->native_handle();
 #else
         fd_ = s->rdbuf()->native();
 #endif
         stream_ = s;
+#else // #ifdef WIN32
+        std::string options;
+        const std::vector< std::string >& a = impl::split_socket_name( name, options );
+        if( a.size() != 3 ) { COMMA_THROW( comma::exception, "expected tcp:<address>:<port>[;<options>], got \"" << name << "\"" ); }
+        const socket_options& o = socket_options::from_string( options );
+        socket_stream* s = new socket_stream( socket_streambuf::connect_tcp( a[1], a[2], o ), o.buffer_size );
+        close_ = boost::bind( &socket_stream::close, s );
+        fd_ = s->fd(); // todo: make unidirectional
+        stream_ = s;
+#endif // #ifdef WIN32
     }
     else if( v[0] == "udp" )
     {
@@ -278,16 +335,20 @@ template < typename S > stream< S >::stream( const std::string& name, mode::valu
 #ifndef WIN32
     else if( v[0] == "local" )
     {
-        boost::asio::local::stream_protocol::iostream* ls = new boost::asio::local::stream_protocol::iostream( boost::asio::local::stream_protocol::endpoint( v[1] ) );
-        if( !( *ls ) ) { COMMA_THROW( comma::exception, "failed to open " << name_ << ( blocking_ ? " (todo: implement blocking)" : "" ) ); }
-        close_ = boost::bind( &boost::asio::local::stream_protocol::iostream::close, ls );
-        // todo: make unidirectional
-#if (BOOST_VERSION >= 106600)
-        fd_ = ls->rdbuf()->native_handle();
-#else
-        fd_ = ls->rdbuf()->native();
+        std::string options;
+        const std::vector< std::string >& a = impl::split_socket_name( name, options );
+        if( a.size() != 2 ) { COMMA_THROW( comma::exception, "expected local:<path>[;<options>], got \"" << name << "\"" ); }
+        const socket_options& o = socket_options::from_string( options );
+        socket_stream* s = new socket_stream( socket_streambuf::connect_local( a[1], o ), o.buffer_size );
+        close_ = boost::bind( &socket_stream::close, s );
+        fd_ = s->fd(); // todo: make unidirectional
+        stream_ = s;
+    }
 #endif
-        stream_ = ls;
+#ifdef __linux__
+    else if( v[0] == "shm" )
+    {
+        stream_ = impl::shm_traits< S >::make( v, fd_ );
     }
 #endif
 #ifdef USE_ZEROMQ
@@ -359,10 +420,15 @@ static std::string usage( const std::string& what, const std::string& dash, unsi
     oss << i << "<" << what << ">" << std::endl;
     if( verbose )
     {
-        oss << i << "    '-'                  : " << dash << std::endl;
-        oss << i << "    <path>               : path to input file or named pipe" << std::endl;
-        oss << i << "    local:<path>         : local linux socket" << std::endl;
-        oss << i << "    tcp:<address>:<port> : tcp socket" << std::endl;
+        oss << i << "    '-'                              : " << dash << std::endl;
+        oss << i << "    <path>                           : path to input file or named pipe" << std::endl;
+        oss << i << "    local:<path>[;<options>]         : local linux socket" << std::endl;
+        oss << i << "    tcp:<address>:<port>[;<options>] : tcp socket" << std::endl;
+        oss << i << "    shm:<name>[:<size>]              : shared memory ring (linux only); output creates it of <size> bytes" << std::endl;
+        oss << i << "                                       (default: 64MB); input reads from the latest data on" << std::endl;
+        #ifndef WIN32
+        oss << socket_options::usage( indent + 4 );
+        #endif
     }
     else
     {
@@ -26,9 +26,11 @@ struct mode
 /// constructs standard stream from name and owns it:
 ///     filename: file stream
 ///     -: std::cin or std::cout
-///     tcp:address:port: tcp client socket stream
+///     tcp:address:port[;options]: tcp client socket stream
+///     local:path[;options]: local socket client stream
+///         options: socket options, e.g. nodelay;rcvbuf=4194304;timeout=2.5, see socket_options
+///     shm:name[:size]: shared memory ring (linux only)
 ///     @todo udp:address:port: udp socket stream
-///     @todo linux socket name: linux socket client stream
 ///     @todo serial device name: serial stream
 /// see unit test for usage
 template < typename S >
@@ -0,0 +1,203 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <cstdio>
+#include <vector>
+#include <gtest/gtest.h>
+#include "../epoll.h"
+#include "../select.h"
+
+namespace comma { namespace io { namespace test {
+
+struct pipes
+{
+    std::vector< int > in;
+    std::vector< int > out;
+    pipes( unsigned int size, bool nonblocking = false )
+    {
+        for( unsigned int i = 0; i < size; ++i )
+        {
+            int p[2];
+            if( ::pipe( p ) != 0 ) { break; }
+            if( nonblocking ) { ::fcntl( p[0], F_SETFL, ::fcntl( p[0], F_GETFL ) | O_NONBLOCK ); }
+            in.push_back( p[0] );
+            out.push_back( p[1] );
+        }
+    }
+    ~pipes() { for( auto fd: in ) { ::close( fd ); } for( auto fd: out ) { ::close( fd ); } }
+};
+
+static unsigned int raise_file_limit( unsigned int size )
+{
+    struct rlimit r;
+    ::getrlimit( RLIMIT_NOFILE, &r );
+    if( r.rlim_cur < size ) { r.rlim_cur = std::min( rlim_t( size ), r.rlim_max ); ::setrlimit( RLIMIT_NOFILE, &r ); }
+    return r.rlim_cur;
+}
+
+TEST( select, basics )
+{
+    pipes p( 3 );
+    ASSERT_EQ( 3u, p.in.size() );
+    io::select select;
+    EXPECT_EQ( 0u, select.check() );
+    for( auto fd: p.in ) { select.read().add( fd ); }
+    EXPECT_EQ( 0u, select.check() );
+    EXPECT_FALSE( select.read().ready( p.in[1] ) );
+    EXPECT_EQ( 1, ::write( p.out[1], "x", 1 ) );
+    EXPECT_EQ( 1u, select.wait( boost::posix_time::seconds( 1 ) ) );
+    EXPECT_TRUE( select.read().ready( p.in[1] ) );
+    EXPECT_FALSE( select.read().ready( p.in[0] ) );
+    EXPECT_EQ( 1u, select.check() ); // level-triggered: still ready, since not read
+    select.read().remove( p.in[1] );
+    EXPECT_FALSE( select.read().ready( p.in[1] ) );
+    EXPECT_EQ( 0u, select.check() );
+    select.read().add( p.in[1] );
+    EXPECT_EQ( 1u, select.check() );
+    char c;
+    EXPECT_EQ( 1, ::read( p.in[1], &c, 1 ) );
+    EXPECT_EQ( 0u, select.check() );
+    select.write().add( p.out[2] );
+    EXPECT_EQ( 1u, select.check() );
+    EXPECT_TRUE( select.write().ready( p.out[2] ) );
+    io::select copy( select );
+    EXPECT_EQ( 1u, copy.check() );
+    EXPECT_TRUE( copy.write().ready( p.out[2] ) );
+    select.read().clear();
+    select.write().clear();
+    EXPECT_EQ( 0u, select.check() );
+}
+
+TEST( select, regular_file )
+{
+    char name[] = "select_test.XXXXXX";
+    int fd = ::mkstemp( name );
+    ASSERT_GE( fd, 0 );
+    ::unlink( name );
+    pipes p( 1 );
+    io::select select;
+    select.read().add( fd );
+    select.read().add( p.in[0] );
+    EXPECT_EQ( 1u, select.wait() ); // regular file always ready, as with select()
+    EXPECT_TRUE( select.read().ready( fd ) );
+    EXPECT_FALSE( select.read().ready( p.in[0] ) );
+    select.read().remove( fd );
+    EXPECT_EQ( 0u, select.check() );
+    ::close( fd );
+}
+
+TEST( select, reopen_after_remove )
+{
+    int p[2];
+    ASSERT_EQ( 0, ::pipe( p ) );
+    io::select select;
+    select.read().add( p[0] );
+    EXPECT_EQ( 0u, select.check() );
+    select.read().remove( p[0] );
+    ::close( p[0] );
+    ::close( p[1] );
+    pipes q( 1 ); // reuses the lowest descriptor numbers just closed
+    ASSERT_EQ( p[0], q.in[0] );
+    select.read().add( q.in[0] ); // removed and added again before the next wait
+    EXPECT_EQ( 1, ::write( q.out[0], "x", 1 ) );
+    EXPECT_EQ( 1u, select.wait( boost::posix_time::seconds( 1 ) ) );
+    EXPECT_TRUE( select.read().ready( q.in[0] ) );
+}
+
+TEST( select, reopen_without_remove )
+{
+    int p[2];
+    ASSERT_EQ( 0, ::pipe( p ) );
+    io::select select;
+    select.read().add( p[0] );
+    EXPECT_EQ( 0u, select.check() );
+    ::close( p[0] ); // closed without remove
+    ::close( p[1] );
+    pipes q( 1 );
+    ASSERT_EQ( p[0], q.in[0] );
+    select.read().add( q.in[0] ); // already in the set under the same number
+    EXPECT_EQ( 1, ::write( q.out[0], "x", 1 ) );
+    EXPECT_EQ( 1u, select.wait( boost::posix_time::seconds( 1 ) ) );
+    EXPECT_TRUE( select.read().ready( q.in[0] ) );
+    char name[] = "select_test.XXXXXX"; // reopened as regular file, and then as pipe again
+    select.read().remove( q.in[0] );
+    ::close( q.in[0] );
+    int fd = ::mkstemp( name );
+    ASSERT_EQ( q.in[0], fd );
+    ::unlink( name );
+    select.read().add( fd );
+    EXPECT_EQ( 1u, select.check() );
+    ::close( fd );
+    ASSERT_EQ( 0, ::pipe( p ) );
+    ASSERT_EQ( fd, p[0] );
+    q.in[0] = p[0];
+    select.read().add( p[0] );
+    EXPECT_EQ( 0u, select.check() );
+    ::close( p[1] );
+}
+
+TEST( select, many )
+{
+    const unsigned int size = 1500; // more than FD_SETSIZE
+    if( raise_file_limit( size * 2 + 64 ) < size * 2 + 64 ) { std::cerr << "select.many: too low limit on number of open files; skipped" << std::endl; return; }
+    pipes p( size );
+    ASSERT_EQ( size, p.in.size() );
+    io::select select;
+    for( auto fd: p.in ) { select.read().add( fd ); }
+    EXPECT_EQ( 0u, select.check() );
+    for( unsigned int i = 0; i < size; i += 100 ) { EXPECT_EQ( 1, ::write( p.out[i], "x", 1 ) ); }
+    EXPECT_EQ( 15u, select.wait( boost::posix_time::seconds( 1 ) ) );
+    for( unsigned int i = 0; i < size; ++i ) { EXPECT_EQ( i % 100 == 0, select.read().ready( p.in[i] ) ); }
+}
+
+TEST( epoll, callbacks )
+{
+    pipes p( 2, true );
+    io::epoll epoll;
+    std::vector< unsigned int > counts( 2, 0 );
+    for( unsigned int i = 0; i < 2; ++i ) { epoll.add( p.in[i], [&,i]( file_descriptor, unsigned int events ) { if( events & io::epoll::read ) { ++counts[i]; } } ); }
+    EXPECT_EQ( 2u, epoll.size() );
+    EXPECT_EQ( 0u, epoll.check() );
+    EXPECT_EQ( 1, ::write( p.out[0], "x", 1 ) );
+    EXPECT_EQ( 1u, epoll.wait( boost::posix_time::seconds( 1 ) ) );
+    EXPECT_EQ( 1u, epoll.check() ); // level-triggered: called again, since not read
+    EXPECT_EQ( 2u, counts[0] );
+    EXPECT_EQ( 0u, counts[1] );
+    epoll.remove( p.in[0] );
+    EXPECT_EQ( 0u, epoll.check() );
+    EXPECT_EQ( 1u, epoll.size() );
+}
+
+TEST( epoll, edge_triggered )
+{
+    pipes p( 1, true );
+    io::epoll epoll;
+    std::string received;
+    unsigned int calls = 0;
+    epoll.add( p.in[0], [&]( file_descriptor fd, unsigned int ) { ++calls; char buf[2]; for( int r; ( r = ::read( fd, buf, 2 ) ) > 0; ) { received.append( buf, r ); } }, io::epoll::read | io::epoll::edge_triggered );
+    EXPECT_EQ( 5, ::write( p.out[0], "hello", 5 ) );
+    EXPECT_EQ( 1u, epoll.wait( boost::posix_time::seconds( 1 ) ) );
+    EXPECT_EQ( "hello", received );
+    EXPECT_EQ( 0u, epoll.check() ); // edge-triggered: no new data, no call
+    EXPECT_EQ( 1u, calls );
+    EXPECT_EQ( 1, ::write( p.out[0], "!", 1 ) );
+    EXPECT_EQ( 1u, epoll.check() );
+    EXPECT_EQ( "hello!", received );
+}
+
+TEST( epoll, remove_in_callback )
+{
+    pipes p( 2, true );
+    io::epoll epoll;
+    unsigned int calls = 0;
+    for( unsigned int i = 0; i < 2; ++i ) { epoll.add( p.in[i], [&]( file_descriptor, unsigned int ) { ++calls; epoll.remove( p.in[0] ); epoll.remove( p.in[1] ); } ); }
+    EXPECT_EQ( 1, ::write( p.out[0], "x", 1 ) );
+    EXPECT_EQ( 1, ::write( p.out[1], "x", 1 ) );
+    EXPECT_EQ( 1u, epoll.wait( boost::posix_time::seconds( 1 ) ) );
+    EXPECT_EQ( 1u, calls );
+    EXPECT_EQ( 0u, epoll.size() );
+}
+
+} } } // namespace comma { namespace io { namespace test {
@@ -0,0 +1,196 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#ifdef __linux__
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "../../base/exception.h"
+#include "../select.h"
+#include "../shm.h"
+#include "../stream.h"
+
+namespace comma { namespace io { namespace test {
+
+static std::string name_( const std::string& what ) { return "comma-test-shm-" + what + "-" + std::to_string( ::getpid() ); }
+
+static void write_( shm::ring& r, const char* buf, std::size_t size )
+{
+    while( size > 0 )
+    {
+        std::size_t n;
+        char* p = r.reserve( n );
+        n = std::min( n, size );
+        std::memcpy( p, buf, n );
+        r.commit( n );
+        buf += n;
+        size -= n;
+    }
+}
+
+TEST( shm, basics )
+{
+    std::unique_ptr< shm::ring > producer( shm::ring::create( name_( "basics" ), 1000 ) );
+    EXPECT_EQ( 65536u, producer->size() );
+    struct stat st;
+    ASSERT_EQ( 0, ::fstat( producer->fd(), &st ) );
+    EXPECT_EQ( 0600u, st.st_mode & 0777 ); // not accessible to other users by default
+    std::unique_ptr< shm::ring > consumer( shm::ring::open( name_( "basics" ) ) );
+    EXPECT_EQ( 0u, consumer->available() );
+    write_( *producer, "hello", 5 );
+    EXPECT_EQ( 5u, consumer->available() );
+    std::unique_ptr< shm::ring > late( shm::ring::open( name_( "basics" ) ) ); // reads from the latest data on
+    EXPECT_EQ( 0u, late->available() );
+    char buf[16];
+    EXPECT_EQ( 5u, consumer->read( buf, sizeof( buf ) ) );
+    EXPECT_EQ( "hello", std::string( buf, 5 ) );
+    producer.reset();
+    EXPECT_EQ( 0u, consumer->read( buf, sizeof( buf ) ) ); // producer closed
+    EXPECT_THROW( shm::ring::open( name_( "basics" ) ), comma::exception ); // producer removed the ring
+}
+
+TEST( shm, wrap_and_wakeup )
+{
+    std::unique_ptr< shm::ring > producer( shm::ring::create( name_( "wrap" ), 65536 ) );
+    std::vector< std::unique_ptr< shm::ring > > consumers;
+    for( unsigned int i = 0; i < 3; ++i ) { consumers.emplace_back( shm::ring::open( name_( "wrap" ) ) ); }
+    const unsigned int size = 1000000; // many times the ring size
+    std::vector< std::vector< char > > received( consumers.size() );
+    std::vector< std::thread > threads;
+    for( unsigned int i = 0; i < consumers.size(); ++i )
+    {
+        threads.emplace_back( [&,i]()
+        {
+            char buf[1000];
+            for( std::size_t n = consumers[i]->read( buf, sizeof( buf ) ); n > 0; n = consumers[i]->read( buf, sizeof( buf ) ) ) { received[i].insert( received[i].end(), buf, buf + n ); }
+        } );
+    }
+    for( unsigned int i = 0; i < size; i += 100 ) // slow enough for consumers to keep up
+    {
+        char buf[100];
+        for( unsigned int j = 0; j < 100; ++j ) { buf[j] = char( ( i + j ) % 251 ); }
+        write_( *producer, buf, 100 );
+        if( i % 10000 == 0 ) { ::usleep( 1000 ); }
+    }
+    producer.reset();
+    for( auto& t: threads ) { t.join(); }
+    for( unsigned int i = 0; i < consumers.size(); ++i )
+    {
+        EXPECT_EQ( 0u, consumers[i]->lost() );
+        ASSERT_EQ( size, received[i].size() );
+        bool ok = true;
+        for( unsigned int j = 0; j < size && ok; ++j ) { ok = received[i][j] == char( j % 251 ); }
+        EXPECT_TRUE( ok );
+    }
+}
+
+TEST( shm, overrun )
+{
+    std::unique_ptr< shm::ring > producer( shm::ring::create( name_( "overrun" ), 65536 ) );
+    std::unique_ptr< shm::ring > consumer( shm::ring::open( name_( "overrun" ) ) );
+    std::vector< char > data( 100000, 'x' );
+    write_( *producer, &data[0], data.size() );
+    write_( *producer, "abc", 3 );
+    std::thread writer( [&]() { ::usleep( 100000 ); write_( *producer, "def", 3 ); } );
+    char buf[200000];
+    EXPECT_EQ( 3u, consumer->read( buf, sizeof( buf ) ) ); // skips to the latest data, then waits for new data
+    writer.join();
+    EXPECT_EQ( 100003u, consumer->lost() );
+    EXPECT_EQ( "def", std::string( buf, 3 ) );
+}
+
+TEST( shm, select )
+{
+    std::unique_ptr< shm::ring > producer( shm::ring::create( name_( "select" ), 65536 ) );
+    std::unique_ptr< shm::ring > consumer( shm::ring::open( name_( "select" ) ) );
+    io::select select;
+    select.read().add( consumer->fd() );
+    EXPECT_EQ( 0u, select.wait( boost::posix_time::milliseconds( 100 ) ) ); // nothing to read: not ready
+    write_( *producer, "hello", 5 );
+    EXPECT_EQ( 1u, select.wait( boost::posix_time::seconds( 1 ) ) );
+    EXPECT_EQ( 1u, select.check() ); // level-triggered: still ready, since not read
+    char buf[16];
+    EXPECT_EQ( 2u, consumer->read( buf, 2 ) );
+    EXPECT_EQ( 1u, select.check() ); // still has unread data
+    EXPECT_EQ( 3u, consumer->read( buf, sizeof( buf ) ) );
+    EXPECT_EQ( 0u, select.check() ); // caught up
+    write_( *producer, "world", 5 );
+    EXPECT_EQ( 1u, select.wait( boost::posix_time::seconds( 1 ) ) );
+    EXPECT_EQ( 5u, consumer->read( buf, sizeof( buf ) ) );
+    EXPECT_EQ( 0u, select.check() );
+    producer.reset();
+    EXPECT_EQ( 1u, select.wait( boost::posix_time::seconds( 1 ) ) ); // closed: ready to read end of stream
+    EXPECT_TRUE( consumer->closed() );
+    EXPECT_EQ( 0u, consumer->read( buf, sizeof( buf ) ) );
+}
+
+TEST( shm, dead_producer )
+{
+    const std::string& name = name_( "dead" );
+    int p[2];
+    ASSERT_EQ( 0, ::pipe( p ) );
+    pid_t pid = ::fork();
+    ASSERT_GE( pid, 0 );
+    if( pid == 0 ) // child: create ring and exit without closing it, as if crashed
+    {
+        shm::ring* r = shm::ring::create( name, 65536 );
+        write_( *r, "x", 1 );
+        char c = 0;
+        if( ::write( p[1], &c, 1 ) != 1 ) { ::_exit( 1 ); }
+        if( ::read( p[0], &c, 1 ) != 1 ) { ::_exit( 1 ); }
+        ::_exit( 0 );
+    }
+    char c = 0;
+    ASSERT_EQ( 1, ::read( p[0], &c, 1 ) );
+    std::unique_ptr< shm::ring > consumer( shm::ring::open( name ) );
+    ASSERT_EQ( 1, ::write( p[1], &c, 1 ) );
+    ::waitpid( pid, nullptr, 0 );
+    ::close( p[0] );
+    ::close( p[1] );
+    EXPECT_FALSE( consumer->closed() );
+    io::select select;
+    select.read().add( consumer->fd() );
+    EXPECT_EQ( 1u, select.wait( boost::posix_time::seconds( 3 ) ) ); // noticed within about a second
+    EXPECT_TRUE( consumer->closed() );
+    char buf[16];
+    EXPECT_EQ( 0u, consumer->read( buf, sizeof( buf ) ) );
+    consumer.reset();
+    ::shm_unlink( &( "/" + name )[0] );
+}
+
+TEST( shm, streams )
+{
+    const std::string name = "shm:" + name_( "streams" );
+    std::unique_ptr< io::ostream > os( new io::ostream( name + ":100000", io::mode::binary ) );
+    io::istream is( name, io::mode::binary );
+    EXPECT_NE( io::invalid_file_descriptor, is.fd() );
+    ( **os ) << "hello\nworld\n";
+    ( *os )->flush();
+    std::string line;
+    std::getline( *is, line );
+    EXPECT_EQ( "hello", line );
+    std::getline( *is, line );
+    EXPECT_EQ( "world", line );
+    std::vector< char > data( 300000 ); // large read straight from the ring
+    std::thread writer( [&]() { for( std::size_t i = 0; i < data.size(); i += 1000 ) { std::string s( 1000, char( 'a' + ( i / 1000 ) % 26 ) ); ( **os ).write( &s[0], s.size() ); ( *os )->flush(); ::usleep( 100 ); } } );
+    is->read( &data[0], data.size() );
+    writer.join();
+    EXPECT_EQ( std::streamsize( data.size() ), is->gcount() );
+    EXPECT_EQ( 'a', data[0] );
+    EXPECT_EQ( 'b', data[1000] );
+    EXPECT_EQ( 'a' + 299 % 26, data[299999] );
+    os.reset();
+    is->peek();
+    EXPECT_TRUE( is->eof() );
+}
+
+} } } // namespace comma { namespace io { namespace test {
+
+#endif // #ifdef __linux__
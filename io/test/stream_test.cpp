@@ -2,14 +2,24 @@
 
 #include <cstdio>
 #include <fstream>
+#ifndef WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
 #include <gtest/gtest.h>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/local/stream_protocol.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+#include "../../base/exception.h"
 #include "../impl/filesystem.h"
 #include "../load.h" // just to make sure it compiles
 #include "../select.h"
 #include "../stream.h"
+#ifndef WIN32
+#include "../socket_stream.h"
+#endif
 
 TEST( io, file_stream )
 {
@@ -138,41 +148,46 @@ TEST( io, std_stream )
 
 TEST( io, tcp_stream )
 {
-//     boost::asio::io_service service;
-//     boost::asio::ip::tcp::resolver resolver( service );
-//     //boost::asio::ip::tcp::resolver::query query( "localhost" );
-//     boost::asio::ip::tcp::resolver::query query( "localhost", "80" );
-//     boost::asio::ip::tcp::resolver::iterator it = resolver.resolve( query );
-//     std::cerr << "---> address=" << it->endpoint().address() << std::endl;
-//     std::cerr << "---> port=" << it->endpoint().port() << std::endl;
-//     //boost::asio::ip::tcp::endpoint endpoint( it, 12345 );
-//     boost::asio::ip::tcp::socket socket( service );
-//     //socket.connect( endpoint );
-//     std::cerr << "---> socket.is_open()=" << socket.is_open() << std::endl;
-
-//     // asio tcp server sample code
-//     boost::asio::io_service service;
-//     boost::asio::ip::tcp::endpoint endpoint( boost::asio::ip::tcp::v4(), 12345 );
-//     boost::asio::ip::tcp::acceptor acceptor( service, endpoint );
-//     boost::asio::ip::tcp::iostream stream;
-//     std::cerr << "testTcpstream(): accepting..." << std::endl;
-//     acceptor.accept( *stream.rdbuf() );
-//     std::cerr << "testTcpstream(): accepted" << std::endl;
-//     std::string line;
-//     
-//     int fd = stream.rdbuf()->native();
-//     std::cerr << "testTcpstream(): fd = " << fd << std::endl;
-//     comma::io::select select;
-//     select.read().add( fd );
-//     while( !stream.eof() )
-//     {
-//         std::cerr << "testTcpstream(): selecting..." << std::endl;
-//         select.wait();
-//         std::cerr << "testTcpstream(): select returned" << std::endl;
-//         if( !select.read().ready( fd ) ) { break; }
-//         std::getline( stream, line );
-//         std::cerr << "testTcpstream(): just read \"" << line << "\"" << std::endl;
-//     }
+    #ifndef WIN32
+    boost::asio::io_service service;
+    boost::asio::ip::tcp::acceptor acceptor( service, boost::asio::ip::tcp::endpoint( boost::asio::ip::address_v4::loopback(), 0 ) );
+    const std::string port = boost::lexical_cast< std::string >( acceptor.local_endpoint().port() );
+    {
+        comma::io::iostream client( "tcp:localhost:" + port + ";nodelay;rcvbuf=1048576;buffer=1024;timeout=1" );
+        boost::asio::ip::tcp::iostream server;
+        acceptor.accept( *server.rdbuf() );
+        int value = 0;
+        socklen_t size = sizeof( value );
+        EXPECT_EQ( 0, ::getsockopt( client.fd(), IPPROTO_TCP, TCP_NODELAY, &value, &size ) );
+        EXPECT_NE( 0, value );
+        const std::string large( 100000, 'x' ); // larger than stream buffer
+        *client << "hello" << std::endl << large << std::endl;
+        std::string line;
+        std::getline( server, line );
+        EXPECT_EQ( "hello", line );
+        std::getline( server, line );
+        EXPECT_EQ( large, line );
+        server << "world" << std::endl << large << std::flush;
+        std::getline( *client, line );
+        EXPECT_EQ( "world", line );
+        std::string received( large.size(), '\0' );
+        client->read( &received[0], received.size() );
+        EXPECT_EQ( large, received );
+        server.close();
+        client->peek();
+        EXPECT_TRUE( client->eof() );
+    }
+    comma::io::istream( "tcp:localhost:" + port + ";timeout=0.0001" ); // sub-millisecond timeout still waits for connection
+    EXPECT_THROW( comma::io::istream( "tcp:localhost:" + port + ";nodelya" ), comma::exception ); // unknown option
+    EXPECT_THROW( comma::io::socket_options::from_string( "nodelay;timeout=1;blah=2" ), comma::exception );
+    acceptor.close();
+    EXPECT_THROW( comma::io::istream( "tcp:localhost:" + port ), comma::exception );
+    EXPECT_THROW( comma::io::istream( "tcp:localhost:" + port + ";buffer=0" ), comma::exception );
+    EXPECT_THROW( comma::io::istream( "tcp:localhost" ), comma::exception );
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    EXPECT_THROW( comma::io::istream( "tcp:10.255.255.1:12345;timeout=0.2" ), comma::exception ); // non-routable: either times out or fails right away
+    EXPECT_LT( ( boost::posix_time::microsec_clock::universal_time() - start ).total_milliseconds(), 2000 );
+    #endif
 }
 
 TEST( io, local_stream )
@@ -194,6 +209,24 @@ TEST( io, local_stream )
         EXPECT_TRUE( !comma::filesystem::is_regular_file( "./test.localsocket" ) );
         comma::filesystem::remove( "./test.localsocket" );
     }
+    {
+        comma::filesystem::remove( "./test.localsocket" );
+        boost::asio::io_service service;
+        boost::asio::local::stream_protocol::acceptor acceptor( service, boost::asio::local::stream_protocol::endpoint( "test.localsocket" ) );
+        comma::io::ostream client( "local:./test.localsocket;buffer=16;sndbuf=65536" );
+        boost::asio::local::stream_protocol::iostream server;
+        acceptor.accept( *server.rdbuf() );
+        *client << "hello, world" << std::endl << "bye" << std::endl; // longer than stream buffer
+        std::string line;
+        std::getline( server, line );
+        EXPECT_EQ( "hello, world", line );
+        std::getline( server, line );
+        EXPECT_EQ( "bye", line );
+        client.close();
+        acceptor.close();
+        EXPECT_THROW( comma::io::ostream( "local:./test.localsocket" ), comma::exception );
+        comma::filesystem::remove( "./test.localsocket" );
+    }
     {
         comma::filesystem::remove( "./test.file" );
         comma::io::ostream ostream( "./test.file" );
@@ -0,0 +1,166 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "../base/exception.h"
+#include "../base/types.h"
+
+namespace comma { namespace math {
+
+/// streaming quantile sketch with bounded memory (KLL sketch, Karnin, Lang, Liberty, 2016)
+///
+/// values are kept in levels of compactors: a value at level i stands for 2^i input values;
+/// when a level is full, it is sorted and every other value is promoted to the next level
+///
+/// the compaction is deterministic (alternating odd and even values), thus the same input
+/// gives the same result, and any returned quantile is one of the input values
+///
+/// memory is O( k log( n / k ) ); rank error is roughly 1.7 / k of the number of values,
+/// e.g. about 1% for the default k = 200
+///
+/// sketches are mergeable: merging sketches of two inputs gives a sketch of the same
+/// accuracy as if the inputs were pushed into one sketch
+template < typename T, typename Less = std::less< T > >
+class quantile_sketch
+{
+    public:
+        typedef T value_type;
+
+        quantile_sketch( unsigned int k = 200 );
+
+        /// add value
+        void push( const T& t );
+
+        /// merge other sketch into this one
+        quantile_sketch& operator+=( const quantile_sketch& rhs );
+
+        /// return number of pushed values
+        comma::uint64 count() const { return count_; }
+
+        /// return true, if no values pushed
+        bool empty() const { return count_ == 0; }
+
+        /// return number of values kept in sketch
+        std::size_t size() const;
+
+        /// return number of levels
+        std::size_t levels() const { return levels_.size(); }
+
+        /// return number of values kept at given level, each standing for 2^level input values
+        std::size_t size( std::size_t level ) const { return level < levels_.size() ? levels_[level].size() : 0; }
+
+        /// return capacity of given level for the current number of levels: a level is compacted, once it reaches its capacity
+        std::size_t capacity( std::size_t level ) const { return capacity_( level ); }
+
+        /// return value of given 1-based rank, i.e. the value of the rank-th element in sorted input, approximately
+        T at_rank( comma::uint64 rank ) const;
+
+        /// return nearest-rank quantile for fraction in [0, 1]
+        T quantile( double fraction ) const;
+
+        /// clear sketch
+        void clear() { levels_.clear(); offsets_.clear(); count_ = 0; dirty_ = true; }
+
+    private:
+        unsigned int k_;
+        comma::uint64 count_{0};
+        std::vector< std::vector< T > > levels_;
+        std::vector< bool > offsets_; // compaction offsets alternating at each level
+        mutable std::vector< std::pair< T, comma::uint64 > > sorted_; // values with weights sorted for rank queries
+        mutable bool dirty_{true};
+        std::size_t capacity_( std::size_t level ) const;
+        void compress_();
+        void sort_() const;
+};
+
+template < typename T, typename Less >
+inline quantile_sketch< T, Less >::quantile_sketch( unsigned int k ) : k_( k < 8 ? 8 : k ) {}
+
+template < typename T, typename Less >
+inline std::size_t quantile_sketch< T, Less >::capacity_( std::size_t level ) const
+{
+    std::size_t depth = levels_.size() - level - 1; // top level has the largest capacity
+    return std::max( std::size_t( 2 ), std::size_t( std::ceil( k_ * std::pow( 2. / 3, depth ) ) ) );
+}
+
+template < typename T, typename Less >
+inline std::size_t quantile_sketch< T, Less >::size() const
+{
+    std::size_t s = 0;
+    for( const auto& l: levels_ ) { s += l.size(); }
+    return s;
+}
+
+template < typename T, typename Less >
+inline void quantile_sketch< T, Less >::push( const T& t )
+{
+    if( levels_.empty() ) { levels_.resize( 1 ); offsets_.resize( 1, false ); }
+    levels_[0].push_back( t );
+    ++count_;
+    dirty_ = true;
+    if( levels_[0].size() >= capacity_( 0 ) ) { compress_(); }
+}
+
+template < typename T, typename Less >
+inline quantile_sketch< T, Less >& quantile_sketch< T, Less >::operator+=( const quantile_sketch< T, Less >& rhs )
+{
+    if( rhs.levels_.size() > levels_.size() ) { levels_.resize( rhs.levels_.size() ); offsets_.resize( rhs.levels_.size(), false ); }
+    for( std::size_t i = 0; i < rhs.levels_.size(); ++i ) { levels_[i].insert( levels_[i].end(), rhs.levels_[i].begin(), rhs.levels_[i].end() ); }
+    count_ += rhs.count_;
+    dirty_ = true;
+    compress_();
+    return *this;
+}
+
+template < typename T, typename Less >
+inline void quantile_sketch< T, Less >::compress_()
+{
+    for( std::size_t i = 0; i < levels_.size(); ++i )
+    {
+        if( levels_[i].size() < capacity_( i ) ) { continue; }
+        bool grown = i + 1 == levels_.size();
+        if( grown ) { levels_.resize( i + 2 ); offsets_.resize( i + 2, false ); }
+        std::vector< T >& level = levels_[i];
+        std::sort( level.begin(), level.end(), Less() );
+        std::size_t size = level.size() - level.size() % 2; // odd value stays at this level
+        std::vector< T >& next = levels_[ i + 1 ];
+        for( std::size_t j = offsets_[i] ? 1 : 0; j < size; j += 2 ) { next.push_back( level[j] ); }
+        offsets_[i] = !offsets_[i];
+        level.erase( level.begin(), level.begin() + size );
+        if( grown ) { i = std::size_t( -1 ); } // capacities of lower levels shrank with the new level: compact them again
+    }
+}
+
+template < typename T, typename Less >
+inline void quantile_sketch< T, Less >::sort_() const
+{
+    if( !dirty_ ) { return; }
+    sorted_.clear();
+    for( std::size_t i = 0; i < levels_.size(); ++i ) { for( const auto& t: levels_[i] ) { sorted_.push_back( std::make_pair( t, comma::uint64( 1 ) << i ) ); } }
+    std::stable_sort( sorted_.begin(), sorted_.end(), []( const std::pair< T, comma::uint64 >& lhs, const std::pair< T, comma::uint64 >& rhs ) { return Less()( lhs.first, rhs.first ); } );
+    dirty_ = false;
+}
+
+template < typename T, typename Less >
+inline T quantile_sketch< T, Less >::at_rank( comma::uint64 rank ) const
+{
+    if( count_ == 0 ) { COMMA_THROW( comma::exception, "quantile sketch: no values provided yet" ); }
+    sort_();
+    comma::uint64 sum = 0; // compaction keeps total weight equal to count
+    for( const auto& s: sorted_ ) { sum += s.second; if( sum >= rank ) { return s.first; } }
+    return sorted_.back().first;
+}
+
+template < typename T, typename Less >
+inline T quantile_sketch< T, Less >::quantile( double fraction ) const
+{
+    comma::uint64 rank = fraction <= 0 ? 1 : comma::uint64( std::ceil( count_ * fraction ) );
+    return at_rank( std::max( comma::uint64( 1 ), std::min( rank, count_ ) ) );
+}
+
+} } // namespace comma { namespace math {
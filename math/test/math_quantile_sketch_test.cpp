@@ -0,0 +1,77 @@
+// Copyright (c) 2024 Mission Systems Pty Ltd
+
+#include <cmath>
+#include <gtest/gtest.h>
+#include "../quantile_sketch.h"
+
+namespace comma { namespace math {
+
+TEST( quantile_sketch, exact_while_small )
+{
+    quantile_sketch< int > s( 200 );
+    for( int i = 100; i > 0; --i ) { s.push( i ); }
+    EXPECT_EQ( 100u, s.count() );
+    EXPECT_EQ( 1, s.quantile( 0 ) );
+    EXPECT_EQ( 50, s.quantile( 0.5 ) );
+    EXPECT_EQ( 90, s.quantile( 0.9 ) );
+    EXPECT_EQ( 100, s.quantile( 1 ) );
+    EXPECT_EQ( 37, s.at_rank( 37 ) );
+}
+
+TEST( quantile_sketch, bounded )
+{
+    quantile_sketch< int > s( 200 );
+    const int size = 1000000;
+    for( comma::int64 i = 0; i < size; ++i ) { s.push( int( ( i * 7919 ) % size ) ); } // permutation of 0..size-1
+    EXPECT_LT( s.size(), 1000u );
+    for( double p: { 0.01, 0.1, 0.5, 0.9, 0.99 } ) { EXPECT_NEAR( p * size, s.quantile( p ), size * 0.02 ); }
+}
+
+static void expect_within_capacity( const quantile_sketch< int >& s )
+{
+    std::size_t capacity = 0;
+    for( std::size_t i = 0; i < s.levels(); ++i ) { ASSERT_LT( s.size( i ), s.capacity( i ) ) << "level " << i << " of " << s.levels(); capacity += s.capacity( i ) - 1; }
+    ASSERT_LE( s.size(), capacity );
+}
+
+TEST( quantile_sketch, size_bound )
+{
+    for( unsigned int k: { 8, 50, 200 } )
+    {
+        quantile_sketch< int > s( k );
+        for( int i = 0; i < 100000; ++i ) { s.push( i ); expect_within_capacity( s ); }
+        quantile_sketch< int > t( k );
+        for( int i = 0; i < 200; ++i ) // merging sketches of different sizes adds levels in the middle of compaction
+        {
+            quantile_sketch< int > u( k );
+            for( int j = 0; j < 1 + ( i * 7919 ) % 5000; ++j ) { u.push( j ); }
+            t += u;
+            expect_within_capacity( t );
+        }
+    }
+}
+
+TEST( quantile_sketch, merge )
+{
+    quantile_sketch< double > a( 100 );
+    quantile_sketch< double > b( 100 );
+    quantile_sketch< double > c( 100 );
+    for( int i = 0; i < 100000; ++i ) { ( i % 2 ? a : b ).push( i ); c.push( i ); }
+    a += b;
+    EXPECT_EQ( c.count(), a.count() );
+    for( double p: { 0.1, 0.5, 0.99 } ) { EXPECT_NEAR( c.quantile( p ), a.quantile( p ), 100000 * 0.04 ); }
+    quantile_sketch< double > d( 100 );
+    d += a;
+    EXPECT_EQ( a.quantile( 0.5 ), d.quantile( 0.5 ) );
+}
+
+TEST( quantile_sketch, deterministic )
+{
+    quantile_sketch< int > a( 50 );
+    quantile_sketch< int > b( 50 );
+    for( int i = 0; i < 10000; ++i ) { a.push( i % 977 ); b.push( i % 977 ); }
+    EXPECT_EQ( a.quantile( 0.3 ), b.quantile( 0.3 ) );
+    EXPECT_THROW( quantile_sketch< int >().quantile( 0.5 ), comma::exception );
+}
+
+} } // namespace comma { namespace math {